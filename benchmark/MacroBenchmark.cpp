@@ -0,0 +1,338 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// End-to-end benchmark of PluginMastodon against MockMastodonServer. Posts a batch of actions
+// across several links, then repeatedly adds statuses to the links' hashtags and measures how
+// long a wildcard fetch takes to deliver them. Results are printed as a JSON object.
+//
+// Usage: macroBenchmark [--name=value ...], see Settings for the names and defaults.
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LinkAddress.h"
+#include "MockMastodonServer.h"
+#include "MockTransportSdk.h"
+#include "PluginMastodon.h"
+#include "base64.h"
+
+struct Settings {
+    int links = 4;
+    int posts = 200;
+    int textBytes = 256;         // Size of the content of each post before base64 encoding
+    int imageBytes = 0;          // Attach an image of this size to every post, 0 for text only
+    int imagesPerPost = 1;       // Images attached to each post when imageBytes is set
+    int fetchRounds = 20;
+    int statusesPerRound = 5;    // Statuses added to each hashtag before each fetch
+    int activeLinks = -1;        // Links whose hashtags receive statuses, -1 for all of them
+    int roundIntervalMs = 0;     // Pause before each round, e.g. to let idle links back off
+    int latencyMs = 20;          // Server response latency
+    int rateLimit = 0;           // Requests per window per endpoint class, 0 for unlimited
+    int rateWindowSeconds = 300;
+    int pageSize = 40;           // Most statuses per timeline page
+    int mediaProcessingMs = 0;   // Time the server takes to process an upload
+    int workerThreads = 4;
+    int accounts = 1;            // Accounts on the server that links are spread across
+    int batchWindowMs = 0;       // Window in which text posts on a link share a status
+    int maxCharacters = 500;     // Longest status the server accepts
+    int spool = 0;               // 1 to spool enqueued content to a temporary directory
+    int adaptivePollMs = 0;      // Minimum adaptive polling interval, 0 to fetch by action
+    int adaptivePollMaxMs = 0;   // Maximum adaptive polling interval, 0 for the default
+    int timelineValidators = 256; // Timeline URLs polled conditionally, 0 to poll unconditionally
+    int timeoutSeconds = 300;    // Give up waiting for a phase after this long
+};
+
+static Settings parseSettings(int argc, char **argv) {
+    Settings settings;
+    std::map<std::string, int *> fields = {
+        {"links", &settings.links},
+        {"posts", &settings.posts},
+        {"text-bytes", &settings.textBytes},
+        {"image-bytes", &settings.imageBytes},
+        {"images-per-post", &settings.imagesPerPost},
+        {"fetch-rounds", &settings.fetchRounds},
+        {"statuses-per-round", &settings.statusesPerRound},
+        {"active-links", &settings.activeLinks},
+        {"round-interval-ms", &settings.roundIntervalMs},
+        {"latency-ms", &settings.latencyMs},
+        {"rate-limit", &settings.rateLimit},
+        {"rate-window-seconds", &settings.rateWindowSeconds},
+        {"page-size", &settings.pageSize},
+        {"media-processing-ms", &settings.mediaProcessingMs},
+        {"worker-threads", &settings.workerThreads},
+        {"accounts", &settings.accounts},
+        {"batch-window-ms", &settings.batchWindowMs},
+        {"max-characters", &settings.maxCharacters},
+        {"spool", &settings.spool},
+        {"adaptive-poll-ms", &settings.adaptivePollMs},
+        {"adaptive-poll-max-ms", &settings.adaptivePollMaxMs},
+        {"timeline-validators", &settings.timelineValidators},
+        {"timeout-seconds", &settings.timeoutSeconds},
+    };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t equals = arg.find('=');
+        auto field = arg.rfind("--", 0) == 0 && equals != std::string::npos ?
+                         fields.find(arg.substr(2, equals - 2)) : fields.end();
+        if (field == fields.end()) {
+            throw std::invalid_argument("unknown argument: " + arg);
+        }
+        *field->second = std::stoi(arg.substr(equals + 1));
+    }
+    return settings;
+}
+
+static std::vector<uint8_t> randomBytes(std::mt19937 &random, int size) {
+    std::vector<uint8_t> bytes(static_cast<size_t>(size));
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+// Peak and current resident set size in kB, from /proc/self/status
+static nlohmann::json memoryUsage() {
+    nlohmann::json memory;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            memory["peakRssKb"] = std::stol(line.substr(6));
+        } else if (line.rfind("VmRSS:", 0) == 0) {
+            memory["rssKb"] = std::stol(line.substr(6));
+        }
+    }
+    if (!memory.contains("peakRssKb")) {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        memory["peakRssKb"] = usage.ru_maxrss;
+    }
+    return memory;
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+    return values[index];
+}
+
+// Waits until no new items have been received for a while, for fetches of unknown size
+static void waitForQuiet(MockTransportSdk &sdk, std::chrono::milliseconds quiet) {
+    std::size_t last = sdk.getReceived();
+    while (true) {
+        std::this_thread::sleep_for(quiet);
+        std::size_t now = sdk.getReceived();
+        if (now == last) {
+            return;
+        }
+        last = now;
+    }
+}
+
+int main(int argc, char **argv) {
+    Settings settings = parseSettings(argc, argv);
+    const std::chrono::seconds timeout(settings.timeoutSeconds);
+    std::mt19937 random(1);
+
+    MockMastodonServer::Options serverOptions;
+    serverOptions.latency = std::chrono::milliseconds(settings.latencyMs);
+    serverOptions.rateLimit = settings.rateLimit;
+    serverOptions.rateWindow = std::chrono::seconds(settings.rateWindowSeconds);
+    serverOptions.maxPageSize = settings.pageSize;
+    serverOptions.mediaProcessing = std::chrono::milliseconds(settings.mediaProcessingMs);
+    serverOptions.maxCharacters = settings.maxCharacters;
+    MockMastodonServer server(serverOptions);
+
+    nlohmann::json options = {
+        {"workerThreads", settings.workerThreads},
+        {"metricsIntervalSeconds", 0},
+        {"retryInitialDelayMs", 100},
+        {"postBatchWindowMs", settings.batchWindowMs},
+        {"timelineValidatorEntries", settings.timelineValidators},
+    };
+    const std::string spoolDirectory =
+        (std::filesystem::temp_directory_path() / ("macroBenchmark-spool-" + std::to_string(getpid()))).string();
+    if (settings.spool) {
+        options["spoolDirectory"] = spoolDirectory;
+    }
+    if (settings.adaptivePollMs > 0) {
+        options["adaptivePolling"] = true;
+        options["pollMinIntervalMs"] = settings.adaptivePollMs;
+        options["pollRequestsPerMinute"] = 0;
+        if (settings.adaptivePollMaxMs > 0) {
+            options["pollMaxIntervalMs"] = settings.adaptivePollMaxMs;
+        }
+    }
+    for (int i = 1; i < settings.accounts; ++i) {
+        options["accounts"].push_back({{"server", server.getUrl()}, {"accessToken", "benchmark-" + std::to_string(i)}});
+    }
+    MockTransportSdk sdk({
+        {"mastodonServer", server.getUrl()},
+        {"accessToken", "benchmark"},
+        {"mastodonOptions", options.dump()},
+    });
+    PluginMastodon plugin(&sdk);
+    sdk.answerUserInput(plugin);
+
+    std::vector<LinkID> linkIds;
+    std::vector<std::string> hashtags;
+    RaceHandle nextHandle = 1000;
+    for (int i = 0; i < settings.links; ++i) {
+        LinkID linkId = "benchmark-link-" + std::to_string(i);
+        plugin.createLink(nextHandle++, linkId);
+        LinkAddress address = nlohmann::json::parse(plugin.getLinkProperties(linkId).linkAddress);
+        linkIds.push_back(linkId);
+        hashtags.push_back(address.hashtag);
+    }
+
+    // Post phase: every action is enqueued and started at once, like a burst of messages
+    uint64_t nextActionId = 1;
+    const std::string contentType = settings.imageBytes > 0 ? "mixed" : "text";
+    auto postStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < settings.posts; ++i) {
+        Action action;
+        action.actionId = nextActionId++;
+        action.json = nlohmann::json{{"linkId", linkIds[i % linkIds.size()]},
+                                     {"type", "post"},
+                                     {"contentType", contentType},
+                                     {"images", settings.imagesPerPost}}.dump();
+        for (auto &params : plugin.getActionParams(action)) {
+            std::vector<uint8_t> content;
+            if (params.type == "image/jpeg") {
+                content = randomBytes(random, settings.imageBytes);
+            } else {
+                std::string text = base64::encode(randomBytes(random, settings.textBytes));
+                content.assign(text.begin(), text.end());
+            }
+            plugin.enqueueContent(params, action, content);
+        }
+        plugin.doAction({nextHandle++}, action);
+    }
+    bool postsDone = sdk.waitForPackages(static_cast<size_t>(settings.posts), timeout);
+    double postSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - postStart).count();
+
+    // Catch up on the statuses posted above so that each round only receives its own
+    Action warmup;
+    warmup.actionId = nextActionId++;
+    warmup.json = nlohmann::json{{"linkId", "*"}, {"type", "fetch"}}.dump();
+    plugin.doAction({}, warmup);
+    waitForQuiet(sdk, std::chrono::milliseconds(std::max(500, settings.latencyMs * 20)));
+
+    // Fetch phase: time from adding statuses until a wildcard fetch, or the adaptive poller,
+    // has delivered all of them
+    std::vector<double> fetchLatencies;
+    bool fetchesDone = true;
+    int fetchActions = 0;
+    const std::chrono::milliseconds refetchAfter(std::max(1000, settings.latencyMs * 50));
+    const std::size_t activeLinks = settings.activeLinks < 0 ?
+                                        hashtags.size() :
+                                        std::min(hashtags.size(), static_cast<std::size_t>(settings.activeLinks));
+    const uint64_t fetchPhaseStartRequests = server.getRequestCount();
+    const uint64_t fetchPhaseStartBytes = server.getBodyBytes();
+    for (int round = 0; round < settings.fetchRounds && fetchesDone; ++round) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(settings.roundIntervalMs));
+        for (std::size_t link = 0; link < activeLinks; ++link) {
+            for (int i = 0; i < settings.statusesPerRound; ++i) {
+                server.addStatus(base64::encode(randomBytes(random, settings.textBytes)), hashtags[link]);
+            }
+        }
+        std::size_t expected = sdk.getReceived() + activeLinks * settings.statusesPerRound;
+
+        // A fetch stops at the first short page, so when the server caps pages below the
+        // client's limit the remaining statuses only arrive with further fetches
+        auto fetchStart = std::chrono::steady_clock::now();
+        auto deadline = fetchStart + timeout;
+        if (settings.adaptivePollMs > 0) {
+            fetchesDone = sdk.waitForReceived(expected, timeout);
+        } else {
+            do {
+                Action fetch;
+                fetch.actionId = nextActionId++;
+                fetch.json = nlohmann::json{{"linkId", "*"}, {"type", "fetch"}}.dump();
+                plugin.doAction({}, fetch);
+                ++fetchActions;
+                fetchesDone = sdk.waitForReceived(expected, refetchAfter);
+            } while (!fetchesDone && std::chrono::steady_clock::now() < deadline);
+        }
+        fetchLatencies.push_back(std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - fetchStart).count());
+    }
+    const uint64_t fetchPhaseRequests = server.getRequestCount() - fetchPhaseStartRequests;
+    const uint64_t fetchPhaseBytes = server.getBodyBytes() - fetchPhaseStartBytes;
+
+    nlohmann::json report = {
+        {"settings", {
+            {"links", settings.links},
+            {"posts", settings.posts},
+            {"textBytes", settings.textBytes},
+            {"imageBytes", settings.imageBytes},
+            {"imagesPerPost", settings.imagesPerPost},
+            {"latencyMs", settings.latencyMs},
+            {"rateLimit", settings.rateLimit},
+            {"rateWindowSeconds", settings.rateWindowSeconds},
+            {"pageSize", settings.pageSize},
+            {"workerThreads", settings.workerThreads},
+            {"accounts", settings.accounts},
+            {"batchWindowMs", settings.batchWindowMs},
+            {"maxCharacters", settings.maxCharacters},
+            {"spool", settings.spool != 0},
+            {"activeLinks", activeLinks},
+            {"roundIntervalMs", settings.roundIntervalMs},
+            {"adaptivePollMs", settings.adaptivePollMs},
+            {"adaptivePollMaxMs", settings.adaptivePollMaxMs},
+            {"timelineValidators", settings.timelineValidators},
+        }},
+        {"post", {
+            {"completed", postsDone},
+            {"sent", sdk.getPackagesSent()},
+            {"failed", sdk.getPackagesFailed()},
+            {"seconds", postSeconds},
+            {"postsPerSecond", postSeconds > 0 ? sdk.getPackagesSent() / postSeconds : 0.0},
+        }},
+        {"fetch", {
+            {"completed", fetchesDone},
+            {"rounds", fetchLatencies.size()},
+            {"fetchActions", fetchActions},
+            {"serverRequests", fetchPhaseRequests},
+            {"serverBodyBytes", fetchPhaseBytes},
+            {"p50Ms", percentile(fetchLatencies, 0.5)},
+            {"p90Ms", percentile(fetchLatencies, 0.9)},
+            {"p99Ms", percentile(fetchLatencies, 0.99)},
+            {"maxMs", percentile(fetchLatencies, 1.0)},
+        }},
+        {"serverRequests", server.getRequestCount()},
+        {"linkMtu", plugin.getLinkProperties(linkIds.front()).mtu},
+        {"memory", memoryUsage()},
+    };
+    std::cout << report.dump(2) << std::endl;
+    std::filesystem::remove_all(spoolDirectory);
+    return postsDone && fetchesDone ? 0 : 1;
+}
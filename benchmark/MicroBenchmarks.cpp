@@ -0,0 +1,221 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// Microbenchmarks for the CPU-bound parts of the transport: Base64, status HTML to text,
+// timeline JSON parsing and the hash queue used to drop our own messages.
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ActionTable.h"
+#include "HtmlText.h"
+#include "MessageHashQueue.h"
+#include "StatusJson.h"
+#include "base64.h"
+
+static std::vector<std::uint8_t> randomBytes(std::size_t size) {
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<std::uint8_t> bytes(size);
+    for (auto &value : bytes) {
+        value = static_cast<std::uint8_t>(byte(random));
+    }
+    return bytes;
+}
+
+// Status content the way Mastodon renders a post of Base64 text and a hashtag
+static std::string statusHtml(std::size_t textBytes) {
+    std::vector<std::uint8_t> bytes = randomBytes(textBytes);
+    return "<p>" + base64::encode(RawData(bytes.begin(), bytes.end())) +
+           " <a href=\"https://mastodon.example/tags/race\" class=\"mention hashtag\" rel=\"tag\">"
+           "#<span>race</span></a> &amp; more</p>";
+}
+
+// A timeline page with the fields a real instance returns around the ones we read
+static std::string timelineJson(int statuses, std::size_t textBytes) {
+    std::string html = statusHtml(textBytes);
+    std::string escaped;
+    for (char c : html) {
+        if (c == '"') {
+            escaped += "\\\"";
+        } else {
+            escaped += c;
+        }
+    }
+    std::string json = "[";
+    for (int i = 0; i < statuses; ++i) {
+        std::string id = std::to_string(110000000000000000ULL + static_cast<unsigned>(i));
+        json += (i == 0 ? "" : ",");
+        json += "{\"id\":\"" + id + "\",\"created_at\":\"2023-11-01T12:00:00.000Z\",\"in_reply_to_id\":null,"
+                "\"sensitive\":false,\"spoiler_text\":\"\",\"visibility\":\"public\",\"language\":\"en\","
+                "\"uri\":\"https://mastodon.example/users/race/statuses/" + id + "\","
+                "\"replies_count\":0,\"reblogs_count\":0,\"favourites_count\":0,\"edited_at\":null,"
+                "\"content\":\"" + escaped + "\",\"reblog\":null,"
+                "\"account\":{\"id\":\"1\",\"username\":\"race\",\"acct\":\"race\",\"display_name\":\"\","
+                "\"locked\":false,\"bot\":false,\"note\":\"<p></p>\",\"followers_count\":12,"
+                "\"emojis\":[],\"fields\":[]},"
+                "\"media_attachments\":[{\"id\":\"" + id + "\",\"type\":\"image\","
+                "\"url\":\"https://mastodon.example/files/" + id + ".png\",\"preview_url\":null,"
+                "\"meta\":{\"original\":{\"width\":64,\"height\":64}},\"description\":null}],"
+                "\"mentions\":[],\"tags\":[{\"name\":\"race\",\"url\":\"https://mastodon.example/tags/race\"}],"
+                "\"emojis\":[],\"card\":null,\"poll\":null}";
+    }
+    return json + "]";
+}
+
+static void BM_Base64Encode(benchmark::State &state) {
+    std::vector<std::uint8_t> data = randomBytes(static_cast<std::size_t>(state.range(0)));
+    std::string out(base64::encodedLength(data.size()), '\0');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(base64::encode(data.data(), data.size(), &out[0]));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64Encode)->Arg(64)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+static void BM_Base64Decode(benchmark::State &state) {
+    std::vector<std::uint8_t> data = randomBytes(static_cast<std::size_t>(state.range(0)));
+    std::string b64 = base64::encode(RawData(data.begin(), data.end()));
+    std::vector<std::uint8_t> out(base64::decodedMaxLength(b64.size()));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(base64::decode(b64.data(), b64.size(), out.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Base64Decode)->Arg(64)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+static void BM_StripHtmlWithLibxml2(benchmark::State &state) {
+    std::string html = statusHtml(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(stripHtmlWithLibxml2(html));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * html.size()));
+}
+BENCHMARK(BM_StripHtmlWithLibxml2)->Arg(64)->Arg(256)->Arg(350);
+
+static void BM_ExtractStatusText(benchmark::State &state) {
+    std::string html = statusHtml(static_cast<std::size_t>(state.range(0)));
+    std::string text;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(extractStatusText(html, text));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * html.size()));
+}
+BENCHMARK(BM_ExtractStatusText)->Arg(64)->Arg(256)->Arg(350);
+
+static void BM_ParseTimelineJson(benchmark::State &state) {
+    std::string json = timelineJson(static_cast<int>(state.range(0)), 256);
+    std::vector<StatusFields> statuses;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseTimelineJson(json, statuses));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ParseTimelineJson)->Arg(1)->Arg(20)->Arg(40);
+
+// Messages a link posts, kept as short status-sized strings
+static std::vector<std::string> messages(std::size_t count) {
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::vector<std::uint8_t> bytes = randomBytes(64 + i);
+        result.push_back(base64::encode(RawData(bytes.begin(), bytes.end())));
+    }
+    return result;
+}
+
+static void BM_MessageHashQueueAdd(benchmark::State &state) {
+    std::vector<std::string> posted = messages(1024);
+    MessageHashQueue queue;
+    std::size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(queue.addMessage(posted[next]));
+        next = (next + 1) % posted.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_MessageHashQueueAdd);
+
+// Looks up received messages in a queue of the given depth, half of them our own
+static void BM_MessageHashQueueFind(benchmark::State &state) {
+    std::size_t depth = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> posted = messages(depth);
+    std::vector<std::string> received = messages(depth * 2);
+    for (std::size_t i = 0; i < depth; i += 2) {
+        received[i] = posted[i];
+    }
+    MessageHashQueue queue;
+    for (auto &message : posted) {
+        queue.addMessage(message);
+    }
+    std::size_t next = 0;
+    for (auto _ : state) {
+        const std::string &message = received[next];
+        if (queue.findAndRemoveMessage(message)) {
+            // Keep the queue at its depth so every iteration searches the same amount
+            state.PauseTiming();
+            queue.addMessage(message);
+            state.ResumeTiming();
+        }
+        next = (next + 1) % received.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_MessageHashQueueFind)->Arg(16)->Arg(256)->Arg(1024);
+
+// Removes the hash of a failed post from a full queue
+static void BM_MessageHashQueueRemoveHash(benchmark::State &state) {
+    std::size_t depth = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> posted = messages(depth);
+    MessageHashQueue queue;
+    std::vector<std::size_t> hashes;
+    for (auto &message : posted) {
+        hashes.push_back(queue.addMessage(message));
+    }
+    std::size_t next = 0;
+    for (auto _ : state) {
+        queue.removeHash(hashes[next]);
+        state.PauseTiming();
+        hashes[next] = queue.addMessage(posted[next]);
+        state.ResumeTiming();
+        next = (next + 1) % hashes.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_MessageHashQueueRemoveHash)->Arg(16)->Arg(256)->Arg(1024);
+
+// Enqueue-then-post bookkeeping of actions, from several dispatch threads at once
+static void BM_ActionTableRecordTake(benchmark::State &state) {
+    static ActionTable table;
+    const std::string linkId = "mastodon-link-" + std::to_string(state.thread_index());
+    uint64_t actionId = static_cast<uint64_t>(state.thread_index()) << 40;
+    ActionTable::Entry entry;
+    for (auto _ : state) {
+        table.record(actionId, linkId, "text/plain");
+        benchmark::DoNotOptimize(table.take(actionId, entry));
+        ++actionId;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_ActionTableRecordTake)->Threads(1)->Threads(4)->Threads(16);
+
+BENCHMARK_MAIN();
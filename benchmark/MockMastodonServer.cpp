@@ -0,0 +1,569 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MockMastodonServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+static std::string percentDecode(const std::string &value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded.push_back(' ');
+        } else if (value[i] == '%' && i + 2 < value.size() && std::isxdigit(value[i + 1]) &&
+                   std::isxdigit(value[i + 2])) {
+            decoded.push_back(static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        } else {
+            decoded.push_back(value[i]);
+        }
+    }
+    return decoded;
+}
+
+// Parses a query string or form body. Repeated names such as media_ids[] are joined with ','.
+static std::map<std::string, std::string> parseForm(const std::string &form) {
+    std::map<std::string, std::string> fields;
+    size_t start = 0;
+    while (start < form.size()) {
+        size_t end = form.find('&', start);
+        if (end == std::string::npos) {
+            end = form.size();
+        }
+        std::string field = form.substr(start, end - start);
+        size_t equals = field.find('=');
+        std::string name = percentDecode(field.substr(0, equals));
+        std::string value = equals == std::string::npos ? "" : percentDecode(field.substr(equals + 1));
+        auto inserted = fields.emplace(name, value);
+        if (!inserted.second) {
+            inserted.first->second += "," + value;
+        }
+        start = end + 1;
+    }
+    return fields;
+}
+
+static std::string escapeHtml(const std::string &text) {
+    std::string html;
+    html.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '<':
+                html += "&lt;";
+                break;
+            case '>':
+                html += "&gt;";
+                break;
+            case '&':
+                html += "&amp;";
+                break;
+            case '"':
+                html += "&quot;";
+                break;
+            default:
+                html.push_back(c);
+        }
+    }
+    return html;
+}
+
+static std::string lowerCase(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+static std::string isoTime(std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::tm tm{};
+    gmtime_r(&seconds, &tm);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+    return buffer;
+}
+
+static const char *reasonPhrase(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 202:
+            return "Accepted";
+        case 206:
+            return "Partial Content";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 422:
+            return "Unprocessable Entity";
+        case 429:
+            return "Too Many Requests";
+        default:
+            return "Unknown";
+    }
+}
+
+MockMastodonServer::MockMastodonServer(const Options &options_) : options(options_) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("MockMastodonServer: socket failed");
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 64) != 0 ||
+        getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        close(listenFd);
+        throw std::runtime_error("MockMastodonServer: could not listen on loopback");
+    }
+    port = ntohs(address.sin_port);
+    acceptThread = std::thread(&MockMastodonServer::acceptLoop, this);
+}
+
+MockMastodonServer::~MockMastodonServer() {
+    stopping = true;
+    shutdown(listenFd, SHUT_RDWR);
+    acceptThread.join();
+    close(listenFd);
+
+    // Wake every connection thread blocked in recv, and close the sockets once they are done
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (int fd : connectionFds) {
+        shutdown(fd, SHUT_RDWR);
+    }
+    for (auto &thread : connectionThreads) {
+        thread.join();
+    }
+    for (int fd : connectionFds) {
+        close(fd);
+    }
+}
+
+std::string MockMastodonServer::getUrl() const {
+    return "http://127.0.0.1:" + std::to_string(port);
+}
+
+uint64_t MockMastodonServer::getBodyBytes() const {
+    return bodyBytes;
+}
+
+uint64_t MockMastodonServer::getRequestCount() const {
+    return requestCount;
+}
+
+std::string MockMastodonServer::addStatus(const std::string &text, const std::string &hashtag) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    Status status;
+    status.id = nextId++;
+    status.html = "<p>" + escapeHtml(text) + " <a href=\"#\" class=\"mention hashtag\">#<span>" +
+                  escapeHtml(hashtag) + "</span></a></p>";
+    status.tags.push_back(lowerCase(hashtag));
+    statuses.push_back(status);
+    return std::to_string(status.id);
+}
+
+void MockMastodonServer::acceptLoop() {
+    while (!stopping) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        if (stopping) {
+            close(fd);
+            break;
+        }
+        connectionFds.push_back(fd);
+        connectionThreads.emplace_back(&MockMastodonServer::serve, this, fd);
+    }
+}
+
+// Runs on a thread per connection. The socket is closed by the destructor.
+void MockMastodonServer::serve(int fd) {
+    std::string buffer;
+    char chunk[16384];
+
+    // Serve requests on the connection until the client closes it
+    while (!stopping) {
+        size_t headerEnd;
+        while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+
+        Request request;
+        std::string head = buffer.substr(0, headerEnd);
+        size_t lineEnd = head.find("\r\n");
+        std::string requestLine = head.substr(0, lineEnd);
+        size_t methodEnd = requestLine.find(' ');
+        size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+        request.method = requestLine.substr(0, methodEnd);
+        std::string target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        size_t question = target.find('?');
+        request.path = target.substr(0, question);
+        if (question != std::string::npos) {
+            request.query = parseForm(target.substr(question + 1));
+        }
+        while (lineEnd != std::string::npos) {
+            size_t next = head.find("\r\n", lineEnd + 2);
+            std::string line = head.substr(lineEnd + 2, next == std::string::npos ? std::string::npos : next - lineEnd - 2);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                size_t valueStart = line.find_first_not_of(' ', colon + 1);
+                request.headers[lowerCase(line.substr(0, colon))] =
+                    valueStart == std::string::npos ? "" : line.substr(valueStart);
+            }
+            lineEnd = next;
+        }
+        buffer.erase(0, headerEnd + 4);
+
+        if (lowerCase(request.headers["expect"]) == "100-continue") {
+            const std::string proceed = "HTTP/1.1 100 Continue\r\n\r\n";
+            send(fd, proceed.data(), proceed.size(), MSG_NOSIGNAL);
+        }
+        size_t contentLength = request.headers.count("content-length") ?
+                                   std::stoul(request.headers["content-length"]) : 0;
+        while (buffer.size() < contentLength) {
+            ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+        request.body = buffer.substr(0, contentLength);
+        buffer.erase(0, contentLength);
+
+        ++requestCount;
+        Response response = handle(request);
+        std::this_thread::sleep_for(options.latency);
+
+        std::string reply = "HTTP/1.1 " + std::to_string(response.status) + " " +
+                            reasonPhrase(response.status) + "\r\nContent-Type: " + response.contentType +
+                            "\r\nContent-Length: " + std::to_string(response.body.size()) + "\r\n";
+        for (auto &header : response.headers) {
+            reply += header.first + ": " + header.second + "\r\n";
+        }
+        reply += "\r\n";
+        reply += response.body;
+        bodyBytes += response.body.size();
+        size_t sent = 0;
+        while (sent < reply.size()) {
+            ssize_t count = send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+            if (count <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(count);
+        }
+    }
+}
+
+MockMastodonServer::Response MockMastodonServer::handle(const Request &request) {
+    const std::string timelinePrefix = "/api/v1/timelines/tag/";
+    const std::string mediaPrefix = "/api/v1/media/";
+    const std::string filePrefix = "/files/";
+
+    // Attachment downloads are not rate limited, like media served from a CDN
+    if (request.method == "GET" && request.path.rfind(filePrefix, 0) == 0) {
+        return getMedia(std::stoull(request.path.substr(filePrefix.size())), true);
+    }
+
+    if (request.method == "GET" && request.path == "/api/v2/instance") {
+        Response response;
+        response.body = nlohmann::json{
+            {"configuration", {
+                {"statuses", {{"max_characters", options.maxCharacters},
+                              {"max_media_attachments", options.maxMediaAttachments}}},
+                {"media_attachments", {{"image_size_limit", 16 * 1024 * 1024}}},
+            }},
+        }.dump();
+        return response;
+    }
+
+    std::string bucket;
+    if (request.method == "POST" && request.path == "/api/v1/statuses") {
+        bucket = "statuses";
+    } else if ((request.method == "POST" && (request.path == "/api/v2/media" || request.path == "/api/v1/media")) ||
+               (request.method == "GET" && request.path.rfind(mediaPrefix, 0) == 0)) {
+        bucket = "media";
+    } else if (request.method == "GET" && request.path.rfind(timelinePrefix, 0) == 0) {
+        bucket = "timelines";
+    } else {
+        Response response;
+        response.status = 404;
+        response.body = "{\"error\":\"Record not found\"}";
+        return response;
+    }
+
+    // Like Mastodon, limits apply to each account separately
+    auto authorization = request.headers.find("authorization");
+    if (authorization != request.headers.end()) {
+        bucket += " " + authorization->second;
+    }
+    Response limited;
+    if (!takeToken(bucket, limited)) {
+        return limited;
+    }
+
+    Response response;
+    if (request.path == "/api/v1/statuses") {
+        response = postStatus(request);
+    } else if (request.method == "POST") {
+        response = postMedia(request);
+    } else if (request.path.rfind(mediaPrefix, 0) == 0) {
+        response = getMedia(std::stoull(request.path.substr(mediaPrefix.size())), false);
+    } else {
+        response = getTimeline(percentDecode(request.path.substr(timelinePrefix.size())), request);
+    }
+    response.headers.insert(response.headers.end(), limited.headers.begin(), limited.headers.end());
+    return response;
+}
+
+bool MockMastodonServer::takeToken(const std::string &name, Response &response) {
+    if (options.rateLimit <= 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto now = std::chrono::system_clock::now();
+    Bucket &bucket = buckets[name];
+    if (bucket.resetAt <= now) {
+        bucket.remaining = options.rateLimit;
+        bucket.resetAt = now + options.rateWindow;
+    }
+    bool allowed = bucket.remaining > 0;
+    if (allowed) {
+        --bucket.remaining;
+    } else {
+        response.status = 429;
+        response.body = "{\"error\":\"Too many requests\"}";
+    }
+    response.headers.emplace_back("X-RateLimit-Limit", std::to_string(options.rateLimit));
+    response.headers.emplace_back("X-RateLimit-Remaining", std::to_string(bucket.remaining));
+    response.headers.emplace_back("X-RateLimit-Reset", isoTime(bucket.resetAt));
+    return allowed;
+}
+
+MockMastodonServer::Response MockMastodonServer::postStatus(const Request &request) {
+    Response response;
+    auto form = parseForm(request.body);
+    std::string text = form["status"];
+
+    // Hashtags are the words starting with '#', as the server links them
+    Status status;
+    std::string html = escapeHtml(text);
+    size_t pos = 0;
+    while ((pos = text.find('#', pos)) != std::string::npos) {
+        size_t end = text.find_first_of(" \t\n", pos);
+        std::string tag = text.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+        if (!tag.empty()) {
+            status.tags.push_back(lowerCase(tag));
+        }
+        pos = end;
+    }
+    status.html = "<p>" + html + "</p>";
+
+    std::string mediaIds = form["media_ids[]"];
+    size_t start = 0;
+    while (start < mediaIds.size()) {
+        size_t end = mediaIds.find(',', start);
+        status.mediaIds.push_back(std::stoull(mediaIds.substr(start, end - start)));
+        start = end == std::string::npos ? mediaIds.size() : end + 1;
+    }
+
+    if (text.size() > static_cast<size_t>(options.maxCharacters)) {
+        response.status = 422;
+        response.body = "{\"error\":\"Validation failed: Text character limit of " +
+                        std::to_string(options.maxCharacters) + " exceeded\"}";
+        return response;
+    } else if (status.mediaIds.size() > static_cast<size_t>(options.maxMediaAttachments)) {
+        response.status = 422;
+        response.body = "{\"error\":\"Validation failed: Media attachments limit of " +
+                        std::to_string(options.maxMediaAttachments) + " exceeded\"}";
+        return response;
+    }
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (uint64_t mediaId : status.mediaIds) {
+        auto iter = media.find(mediaId);
+        if (iter == media.end() || iter->second.readyAt > std::chrono::steady_clock::now()) {
+            response.status = 422;
+            response.body = "{\"error\":\"Cannot attach files that have not finished processing\"}";
+            return response;
+        }
+    }
+    status.id = nextId++;
+    statuses.push_back(status);
+    response.body = statusJson(status);
+    return response;
+}
+
+MockMastodonServer::Response MockMastodonServer::postMedia(const Request &request) {
+    Response response;
+
+    // Keep the file part of the multipart body
+    std::string contentType = request.headers.count("content-type") ? request.headers.at("content-type") : "";
+    size_t boundaryPos = contentType.find("boundary=");
+    if (boundaryPos == std::string::npos) {
+        response.status = 422;
+        response.body = "{\"error\":\"Validation failed: File can't be blank\"}";
+        return response;
+    }
+    std::string delimiter = "\r\n--" + contentType.substr(boundaryPos + 9);
+    size_t dataStart = request.body.find("\r\n\r\n");
+    size_t dataEnd = request.body.find(delimiter, dataStart);
+    Media file;
+    if (dataStart != std::string::npos) {
+        file.data = request.body.substr(dataStart + 4, dataEnd == std::string::npos ? std::string::npos : dataEnd - dataStart - 4);
+    }
+    file.readyAt = std::chrono::steady_clock::now() + options.mediaProcessing;
+
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        id = nextId++;
+        media[id] = std::move(file);
+    }
+    bool ready = options.mediaProcessing.count() == 0;
+    response.status = ready ? 200 : 202;
+    nlohmann::json body = {{"id", std::to_string(id)}, {"type", "image"}};
+    body["url"] = ready ? nlohmann::json(getUrl() + "/files/" + std::to_string(id)) : nlohmann::json(nullptr);
+    response.body = body.dump();
+    return response;
+}
+
+MockMastodonServer::Response MockMastodonServer::getMedia(uint64_t id, bool attachment) {
+    Response response;
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto iter = media.find(id);
+    if (iter == media.end()) {
+        response.status = 404;
+        response.body = "{\"error\":\"Record not found\"}";
+        return response;
+    }
+    if (attachment) {
+        response.contentType = "image/jpeg";
+        response.body = iter->second.data;
+        return response;
+    }
+    bool ready = iter->second.readyAt <= std::chrono::steady_clock::now();
+    response.status = ready ? 200 : 206;
+    nlohmann::json body = {{"id", std::to_string(id)}, {"type", "image"}};
+    body["url"] = ready ? nlohmann::json(getUrl() + "/files/" + std::to_string(id)) : nlohmann::json(nullptr);
+    response.body = body.dump();
+    return response;
+}
+
+MockMastodonServer::Response MockMastodonServer::getTimeline(const std::string &rawTag, const Request &request) {
+    Response response;
+    std::string tag = lowerCase(rawTag.rfind("#", 0) == 0 ? rawTag.substr(1) : rawTag);
+    int limit = options.maxPageSize;
+    auto query = request.query;
+    if (!query["limit"].empty()) {
+        limit = std::min(limit, std::stoi(query["limit"]));
+    }
+    uint64_t minId = query["min_id"].empty() ? 0 : std::stoull(query["min_id"]);
+
+    // With min_id the page holds the oldest statuses after it, otherwise the newest ones.
+    // Either way the page lists them newest first.
+    std::vector<const Status *> page;
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto hasTag = [&tag](const Status &status) {
+        return std::find(status.tags.begin(), status.tags.end(), tag) != status.tags.end();
+    };
+    if (minId != 0) {
+        for (auto iter = statuses.begin(); iter != statuses.end() && static_cast<int>(page.size()) < limit; ++iter) {
+            if (iter->id > minId && hasTag(*iter)) {
+                page.push_back(&*iter);
+            }
+        }
+        std::reverse(page.begin(), page.end());
+    } else {
+        for (auto iter = statuses.rbegin(); iter != statuses.rend() && static_cast<int>(page.size()) < limit; ++iter) {
+            if (hasTag(*iter)) {
+                page.push_back(&*iter);
+            }
+        }
+    }
+
+    response.body = "[";
+    for (size_t i = 0; i < page.size(); ++i) {
+        response.body += (i == 0 ? "" : ",") + statusJson(*page[i]);
+    }
+    response.body += "]";
+
+    // Like Rails, a weak ETag of the body that a conditional request can match against
+    std::string etag = "W/\"" + std::to_string(std::hash<std::string>()(response.body)) + "\"";
+    response.headers.emplace_back("ETag", etag);
+    auto ifNoneMatch = request.headers.find("if-none-match");
+    if (ifNoneMatch != request.headers.end() && ifNoneMatch->second == etag) {
+        response.status = 304;
+        response.body.clear();
+        return response;
+    }
+    if (!page.empty()) {
+        std::string base = getUrl() + request.path + "?local=true&limit=" + std::to_string(limit);
+        response.headers.emplace_back(
+            "Link", "<" + base + "&max_id=" + std::to_string(page.back()->id) + ">; rel=\"next\", <" + base +
+                        "&min_id=" + std::to_string(page.front()->id) + ">; rel=\"prev\"");
+    }
+    return response;
+}
+
+// Called with stateMutex held
+std::string MockMastodonServer::statusJson(const Status &status) const {
+    nlohmann::json attachments = nlohmann::json::array();
+    for (uint64_t mediaId : status.mediaIds) {
+        attachments.push_back({{"id", std::to_string(mediaId)},
+                               {"type", "image"},
+                               {"url", getUrl() + "/files/" + std::to_string(mediaId)}});
+    }
+    nlohmann::json tags = nlohmann::json::array();
+    for (auto &tag : status.tags) {
+        tags.push_back({{"name", tag}, {"url", getUrl() + "/tags/" + tag}});
+    }
+    return nlohmann::json{
+        {"id", std::to_string(status.id)},
+        {"created_at", isoTime(std::chrono::system_clock::now())},
+        {"visibility", "public"},
+        {"content", status.html},
+        {"account", {{"id", "1"}, {"username", "benchmark"}, {"acct", "benchmark"}}},
+        {"media_attachments", attachments},
+        {"tags", tags},
+    }.dump();
+}
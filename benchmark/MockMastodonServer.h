@@ -0,0 +1,130 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_BENCHMARK_MOCK_MASTODON_SERVER_H__
+#define __COMMS_MASTODON_BENCHMARK_MOCK_MASTODON_SERVER_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief In-process HTTP server implementing the parts of the Mastodon API the transport uses:
+ * the instance configuration, posting statuses, uploading and polling media, tag timelines and
+ * attachment downloads.
+ *
+ * Each connection is served by its own thread with keep-alive, so pooled curl handles reuse
+ * their connections as they would against a real server. Responses are delayed by a fixed
+ * latency, and each endpoint class has a request budget per window that is advertised with
+ * X-RateLimit-* headers and enforced with 429.
+ */
+class MockMastodonServer {
+public:
+    struct Options {
+        std::chrono::milliseconds latency{0};       // Added before every response
+        int rateLimit{0};                           // Requests per window per endpoint class, 0 for unlimited
+        std::chrono::seconds rateWindow{300};
+        int maxPageSize{40};                        // Most statuses returned by one timeline page
+        std::chrono::milliseconds mediaProcessing{0}; // Time before an uploaded attachment is ready
+        int maxCharacters{500};                     // Longest status accepted, reported by /api/v2/instance
+        int maxMediaAttachments{4};                 // Most attachments on one status
+    };
+
+    explicit MockMastodonServer(const Options &options);
+    ~MockMastodonServer();
+
+    // Base URL of the server, e.g. http://127.0.0.1:40123
+    std::string getUrl() const;
+
+    // Adds a status as if another client had posted it
+    std::string addStatus(const std::string &text, const std::string &hashtag);
+
+    uint64_t getRequestCount() const;
+
+    // Bytes of response bodies sent
+    uint64_t getBodyBytes() const;
+
+    MockMastodonServer(const MockMastodonServer &) = delete;
+    MockMastodonServer &operator=(const MockMastodonServer &) = delete;
+
+private:
+    struct Request {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> query;
+        std::map<std::string, std::string> headers;  // Keyed by lower-cased name
+        std::string body;
+    };
+
+    struct Response {
+        int status = 200;
+        std::string contentType = "application/json";
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+    };
+
+    struct Status {
+        uint64_t id;
+        std::string html;
+        std::vector<std::string> tags;
+        std::vector<uint64_t> mediaIds;
+    };
+
+    struct Media {
+        std::string data;
+        std::chrono::steady_clock::time_point readyAt;
+    };
+
+    struct Bucket {
+        int remaining = 0;
+        std::chrono::system_clock::time_point resetAt;
+    };
+
+    void acceptLoop();
+    void serve(int fd);
+    Response handle(const Request &request);
+    Response postStatus(const Request &request);
+    Response postMedia(const Request &request);
+    Response getMedia(uint64_t id, bool attachment);
+    Response getTimeline(const std::string &tag, const Request &request);
+    bool takeToken(const std::string &bucket, Response &response);
+    std::string statusJson(const Status &status) const;
+
+    Options options;
+    int listenFd = -1;
+    uint16_t port = 0;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> requestCount{0};
+    std::atomic<uint64_t> bodyBytes{0};
+    std::thread acceptThread;
+
+    std::mutex connectionsMutex;
+    std::vector<std::thread> connectionThreads;
+    std::vector<int> connectionFds;
+
+    mutable std::mutex stateMutex;
+    uint64_t nextId = 100000;
+    std::vector<Status> statuses;  // Ordered by ID
+    std::map<uint64_t, Media> media;
+    std::map<std::string, Bucket> buckets;
+};
+
+#endif  // __COMMS_MASTODON_BENCHMARK_MOCK_MASTODON_SERVER_H__
@@ -0,0 +1,194 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_BENCHMARK_MOCK_TRANSPORT_SDK_H__
+#define __COMMS_MASTODON_BENCHMARK_MOCK_TRANSPORT_SDK_H__
+
+#include <ITransportSdk.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Transport SDK for running the plugin outside of a RACE node. User input prompts are
+ * answered from a fixed map, persistent storage is kept in memory, and the package status and
+ * receive callbacks are counted so a benchmark can wait for them.
+ */
+class MockTransportSdk : public ITransportSdk {
+public:
+    explicit MockTransportSdk(std::map<std::string, std::string> userInput) :
+        userInput(std::move(userInput)) {}
+
+    // Answers every prompt the plugin has made, in the order it made them
+    template <class Component>
+    void answerUserInput(Component &component) {
+        std::vector<std::pair<RaceHandle, std::string>> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.swap(prompts);
+        }
+        for (auto &prompt : pending) {
+            auto answer = userInput.find(prompt.second);
+            component.onUserInputReceived(prompt.first, answer != userInput.end(),
+                                          answer != userInput.end() ? answer->second : "");
+        }
+    }
+
+    // Waits until at least count packages have reached a final status, false on timeout
+    bool waitForPackages(std::size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, timeout, [&] { return packagesSent + packagesFailed >= count; });
+    }
+
+    // Waits until at least count items have been received, false on timeout
+    bool waitForReceived(std::size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, timeout, [&] { return received >= count; });
+    }
+
+    std::size_t getPackagesSent() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return packagesSent;
+    }
+
+    std::size_t getPackagesFailed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return packagesFailed;
+    }
+
+    std::size_t getReceived() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received;
+    }
+
+    std::string getActivePersona() override {
+        return "benchmark";
+    }
+
+    ComponentSdkResponse updateState(ComponentState) override {
+        return ok();
+    }
+
+    ComponentSdkResponse makeDir(const std::string &) override {
+        return ok();
+    }
+
+    ComponentSdkResponse removeDir(const std::string &) override {
+        return ok();
+    }
+
+    std::vector<std::string> listDir(const std::string &) override {
+        return {};
+    }
+
+    std::vector<uint8_t> readFile(const std::string &filepath) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = files.find(filepath);
+        return iter == files.end() ? std::vector<uint8_t>{} : iter->second;
+    }
+
+    ComponentSdkResponse appendFile(const std::string &filepath, const std::vector<uint8_t> &data) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &file = files[filepath];
+        file.insert(file.end(), data.begin(), data.end());
+        return ok();
+    }
+
+    ComponentSdkResponse writeFile(const std::string &filepath, const std::vector<uint8_t> &data) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        files[filepath] = data;
+        return ok();
+    }
+
+    ComponentSdkResponse requestPluginUserInput(const std::string &key, const std::string &, bool) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        RaceHandle handle = nextHandle++;
+        prompts.emplace_back(handle, key);
+        return ok(handle);
+    }
+
+    ComponentSdkResponse requestCommonUserInput(const std::string &key) override {
+        return requestPluginUserInput(key, "", false);
+    }
+
+    ChannelProperties getChannelProperties() override {
+        ChannelProperties properties;
+        properties.transmissionType = TT_MULTICAST;
+        properties.connectionType = CT_INDIRECT;
+        properties.sendType = ST_STORED_ASYNC;
+        properties.reliable = false;
+        properties.isFlushable = false;
+        properties.duration_s = -1;
+        properties.period_s = -1;
+        properties.mtu = 500;
+        properties.maxLinks = 0;
+        properties.currentRole.roleName = "benchmark";
+        properties.currentRole.linkSide = LS_BOTH;
+        return properties;
+    }
+
+    ComponentSdkResponse onLinkStatusChanged(RaceHandle, const LinkID &, LinkStatus,
+                                             const LinkParameters &) override {
+        return ok();
+    }
+
+    ComponentSdkResponse onPackageStatusChanged(RaceHandle, PackageStatus status) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++(status == PACKAGE_SENT ? packagesSent : packagesFailed);
+        }
+        changed.notify_all();
+        return ok();
+    }
+
+    ComponentSdkResponse onEvent(const Event &) override {
+        return ok();
+    }
+
+    ComponentSdkResponse onReceive(const LinkID &, const EncodingParameters &,
+                                   const std::vector<uint8_t> &) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++received;
+        }
+        changed.notify_all();
+        return ok();
+    }
+
+private:
+    static ComponentSdkResponse ok(RaceHandle handle = 0) {
+        ComponentSdkResponse response;
+        response.status = CM_OK;
+        response.handle = handle;
+        return response;
+    }
+
+    std::map<std::string, std::string> userInput;
+    std::mutex mutex;
+    std::condition_variable changed;
+    RaceHandle nextHandle = 1;
+    std::vector<std::pair<RaceHandle, std::string>> prompts;
+    std::map<std::string, std::vector<uint8_t>> files;
+    std::size_t packagesSent = 0;
+    std::size_t packagesFailed = 0;
+    std::size_t received = 0;
+};
+
+#endif  // __COMMS_MASTODON_BENCHMARK_MOCK_TRANSPORT_SDK_H__
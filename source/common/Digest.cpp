@@ -0,0 +1,117 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Digest.h"
+
+#include <cstring>
+
+// XXH64 as specified at https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+
+static const std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static const std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+static const std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static const std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline std::uint64_t rotl(std::uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// The digest is defined over little-endian words
+static inline std::uint64_t read64(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+#endif
+}
+
+static inline std::uint32_t read32(const unsigned char *p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    return static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8 |
+           static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+#endif
+}
+
+static inline std::uint64_t roundLane(std::uint64_t acc, std::uint64_t lane) {
+    acc += lane * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+}
+
+static inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t value) {
+    acc ^= roundLane(0, value);
+    return acc * prime1 + prime4;
+}
+
+std::uint64_t digest64(std::string_view data, std::uint64_t seed) {
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+    const unsigned char *end = p + data.size();
+    std::uint64_t acc;
+
+    if (data.size() >= 32) {
+        std::uint64_t v1 = seed + prime1 + prime2;
+        std::uint64_t v2 = seed + prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - prime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = roundLane(v1, read64(p));
+            v2 = roundLane(v2, read64(p + 8));
+            v3 = roundLane(v3, read64(p + 16));
+            v4 = roundLane(v4, read64(p + 24));
+        }
+        acc = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        acc = mergeRound(acc, v1);
+        acc = mergeRound(acc, v2);
+        acc = mergeRound(acc, v3);
+        acc = mergeRound(acc, v4);
+    } else {
+        acc = seed + prime5;
+    }
+
+    acc += static_cast<std::uint64_t>(data.size());
+
+    for (; end - p >= 8; p += 8) {
+        acc ^= roundLane(0, read64(p));
+        acc = rotl(acc, 27) * prime1 + prime4;
+    }
+    if (end - p >= 4) {
+        acc ^= static_cast<std::uint64_t>(read32(p)) * prime1;
+        acc = rotl(acc, 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        acc ^= static_cast<std::uint64_t>(*p) * prime5;
+        acc = rotl(acc, 11) * prime1;
+    }
+
+    acc ^= acc >> 33;
+    acc *= prime2;
+    acc ^= acc >> 29;
+    acc *= prime3;
+    acc ^= acc >> 32;
+    return acc;
+}
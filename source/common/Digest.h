@@ -0,0 +1,34 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_COMMON_DIGEST_H__
+#define __COMMS_MASTODON_COMMON_DIGEST_H__
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief 64-bit XXH64 digest of the data.
+ *
+ * Unlike std::hash the result is specified by the algorithm, so it is the same on every
+ * platform, standard library and run, and can be compared across processes.
+ *
+ * @param data The bytes to digest.
+ * @param seed Selects an independent hash function, 0 for the standard XXH64 values.
+ */
+std::uint64_t digest64(std::string_view data, std::uint64_t seed = 0);
+
+#endif  // __COMMS_MASTODON_COMMON_DIGEST_H__
@@ -0,0 +1,173 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "HashRing.h"
+
+static const std::size_t minCapacity = 16;
+
+static std::size_t nextPowerOfTwo(std::size_t value) {
+    std::size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+HashRing::HashRing(std::size_t capacity_) {
+    std::size_t capacity = capacity_ < minCapacity ? minCapacity : capacity_;
+    ring.assign(capacity, Entry{0, 0});
+    // Keep the load factor of the index at or below one half
+    table.assign(nextPowerOfTwo(capacity * 2), Entry{0, 0});
+    mask = table.size() - 1;
+}
+
+std::size_t HashRing::capacityForBytes(std::size_t maxBytes) {
+    // The ring holds one entry per key and the index two slots per key
+    std::size_t tableSlots = 1;
+    while ((tableSlots * 2) * sizeof(Entry) + tableSlots * sizeof(Entry) <= maxBytes) {
+        tableSlots <<= 1;
+    }
+    std::size_t capacity = tableSlots / 2;
+    return capacity < minCapacity ? minCapacity : capacity;
+}
+
+/**
+ * @brief Finalizer from SplitMix64, spreads keys with little entropy in their low bits (such as
+ * sequential snowflake IDs) across the whole index.
+ */
+std::uint64_t HashRing::mix(std::uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+/**
+ * @brief Finds the index slot holding the key, or the empty slot where it would be inserted.
+ */
+std::size_t HashRing::findSlot(std::uint64_t key) const {
+    std::size_t slot = mix(key) & mask;
+    while (table[slot].seq != 0 && table[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Clears an index slot using backward-shift deletion so probe chains stay intact without
+ * tombstones.
+ */
+void HashRing::removeFromTable(std::size_t slot) {
+    std::size_t hole = slot;
+    std::size_t next = (hole + 1) & mask;
+    while (table[next].seq != 0) {
+        std::size_t home = mix(table[next].key) & mask;
+        // Move the entry back if the hole lies between its home slot and its current slot
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table[hole] = table[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table[hole] = Entry{0, 0};
+}
+
+/**
+ * @brief Releases the oldest ring position, evicting its key if it is still live.
+ */
+void HashRing::popFront() {
+    Entry &entry = ring[head % ring.size()];
+    if (entry.seq == head) {
+        removeFromTable(findSlot(entry.key));
+        --count;
+    }
+    entry = Entry{0, 0};
+    ++head;
+}
+
+bool HashRing::contains(std::uint64_t key) const {
+    return table[findSlot(key)].seq != 0;
+}
+
+bool HashRing::insert(std::uint64_t key) {
+    std::size_t slot = findSlot(key);
+    if (table[slot].seq != 0) {
+        return false;
+    }
+
+    if (tail - head >= ring.size()) {
+        popFront();
+        // Eviction may have shifted entries in the probe chain
+        slot = findSlot(key);
+    }
+
+    std::uint64_t seq = tail++;
+    ring[seq % ring.size()] = Entry{key, seq};
+    table[slot] = Entry{key, seq};
+    ++count;
+    return true;
+}
+
+bool HashRing::erase(std::uint64_t key) {
+    std::size_t slot = findSlot(key);
+    if (table[slot].seq == 0) {
+        return false;
+    }
+
+    ring[table[slot].seq % ring.size()] = Entry{0, 0};
+    removeFromTable(slot);
+    --count;
+
+    // Reclaim erased positions at the front of the ring
+    while (head < tail && ring[head % ring.size()].seq != head) {
+        ++head;
+    }
+    return true;
+}
+
+bool HashRing::eraseThrough(std::uint64_t key) {
+    std::size_t slot = findSlot(key);
+    if (table[slot].seq == 0) {
+        return false;
+    }
+
+    std::uint64_t seq = table[slot].seq;
+    while (head <= seq) {
+        popFront();
+    }
+    return true;
+}
+
+void HashRing::clear() {
+    ring.assign(ring.size(), Entry{0, 0});
+    table.assign(table.size(), Entry{0, 0});
+    head = tail = 1;
+    count = 0;
+}
+
+std::size_t HashRing::size() const {
+    return count;
+}
+
+std::size_t HashRing::capacity() const {
+    return ring.size();
+}
+
+std::size_t HashRing::memoryBytes() const {
+    return (ring.size() + table.size()) * sizeof(Entry);
+}
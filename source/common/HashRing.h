@@ -0,0 +1,90 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_COMMON_HASH_RING_H__
+#define __COMMS_MASTODON_COMMON_HASH_RING_H__
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Fixed-capacity, insertion-ordered set of 64-bit keys.
+ *
+ * Keys are kept in a ring buffer in insertion order and indexed by an open-addressing hash
+ * table, so lookup, insertion and erasure take constant time. Both arrays are allocated once
+ * at construction; when the ring is full the oldest key is evicted, so memory use never grows.
+ */
+class HashRing {
+public:
+    explicit HashRing(std::size_t capacity);
+
+    /**
+     * @brief The number of keys that fit in the given memory budget.
+     *
+     * @param maxBytes The maximum number of bytes the ring and its index may use.
+     * @return The capacity to pass to the constructor.
+     */
+    static std::size_t capacityForBytes(std::size_t maxBytes);
+
+    bool contains(std::uint64_t key) const;
+
+    /**
+     * @brief Adds a key, evicting the oldest key if the ring is full.
+     *
+     * @return false if the key was already present, true otherwise.
+     */
+    bool insert(std::uint64_t key);
+
+    /**
+     * @brief Removes a key if present.
+     *
+     * @return true if the key was found and removed.
+     */
+    bool erase(std::uint64_t key);
+
+    /**
+     * @brief Removes a key and every key that was inserted before it.
+     *
+     * @return true if the key was found and removed.
+     */
+    bool eraseThrough(std::uint64_t key);
+
+    void clear();
+    std::size_t size() const;
+    std::size_t capacity() const;
+    std::size_t memoryBytes() const;
+
+private:
+    // seq is the 1-based insertion sequence number of the key, 0 marks an unused slot
+    struct Entry {
+        std::uint64_t key;
+        std::uint64_t seq;
+    };
+
+    static std::uint64_t mix(std::uint64_t key);
+    std::size_t findSlot(std::uint64_t key) const;
+    void removeFromTable(std::size_t slot);
+    void popFront();
+
+    std::vector<Entry> ring;
+    std::vector<Entry> table;
+    std::size_t mask;
+    std::uint64_t head{1};  // Sequence number of the oldest ring position in use
+    std::uint64_t tail{1};  // Sequence number the next insertion will take
+    std::size_t count{0};
+};
+
+#endif  // __COMMS_MASTODON_COMMON_HASH_RING_H__
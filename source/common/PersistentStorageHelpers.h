@@ -68,7 +68,7 @@ T psh::readValue(IComponentSdkBase *sdk, const std::string &key, T default_value
     }
 
     std::string valueString(valueData.begin(), valueData.end());
-    logDebug(loggingPrefix + "key: " + key + " value: " + valueString);
+    LOG_DEBUG(loggingPrefix + "key: " + key + " value: " + valueString);
     std::stringstream ss(valueString);
 
     T val;
@@ -0,0 +1,134 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "log.h"
+
+WorkerPool::WorkerPool(std::size_t numThreads) {
+    numThreads = std::max<std::size_t>(1, numThreads);
+    threads.reserve(numThreads);
+    for (std::size_t i = 0; i < numThreads; ++i) {
+        threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::post(const std::string &strand, std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!enqueue(strand, std::move(task))) {
+            return;
+        }
+    }
+    ready.notify_one();
+}
+
+void WorkerPool::postAfter(const std::string &strand, std::chrono::milliseconds delay,
+                           std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.emplace(std::chrono::steady_clock::now() + delay,
+                       std::make_pair(strand, std::move(task)));
+    }
+    // Wake a worker so it waits for the new deadline if it is the earliest
+    ready.notify_one();
+}
+
+/**
+ * @brief Appends a task to its strand. Called with the mutex held.
+ *
+ * @return true if the strand became ready and a worker should be woken.
+ */
+bool WorkerPool::enqueue(const std::string &strand, std::function<void()> task) {
+    auto inserted = strands.emplace(strand, Strand{});
+    inserted.first->second.tasks.push_back(std::move(task));
+    if (!inserted.second) {
+        // The strand is already queued or running, it picks the task up in order
+        return false;
+    }
+    readyStrands.push_back(strand);
+    return true;
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // Move delayed tasks that are due onto their strands
+        auto now = std::chrono::steady_clock::now();
+        bool promoted = false;
+        while (!timers.empty() && timers.begin()->first <= now) {
+            auto &timer = timers.begin()->second;
+            promoted = enqueue(timer.first, std::move(timer.second)) || promoted;
+            timers.erase(timers.begin());
+        }
+        if (promoted && readyStrands.size() > 1) {
+            ready.notify_all();
+        }
+
+        if (readyStrands.empty()) {
+            if (stopping) {
+                // Every queued task has been run, delayed tasks not yet due are dropped
+                return;
+            }
+            if (timers.empty()) {
+                ready.wait(lock);
+            } else {
+                // Copied, another worker may erase the timer while the lock is released
+                auto deadline = timers.begin()->first;
+                ready.wait_until(lock, deadline);
+            }
+            continue;
+        }
+
+        std::string key = std::move(readyStrands.front());
+        readyStrands.pop_front();
+        Strand &strand = strands.at(key);
+        std::function<void()> task = std::move(strand.tasks.front());
+        strand.tasks.pop_front();
+
+        lock.unlock();
+        try {
+            task();
+        } catch (std::exception &e) {
+            logError("WorkerPool::run: task on strand " + key + " failed: " + e.what());
+        } catch (...) {
+            logError("WorkerPool::run: task on strand " + key + " failed with an unknown exception");
+        }
+        lock.lock();
+
+        // Tasks posted while this one ran are waiting on the same strand
+        if (strand.tasks.empty()) {
+            strands.erase(key);
+        } else {
+            readyStrands.push_back(std::move(key));
+            ready.notify_one();
+        }
+    }
+}
@@ -0,0 +1,93 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_COMMON_WORKER_POOL_H__
+#define __COMMS_MASTODON_COMMON_WORKER_POOL_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Fixed-size thread pool that runs tasks in parallel while keeping the order of tasks
+ * posted to the same strand.
+ *
+ * Tasks posted with the same strand key run one at a time in the order they were posted.
+ * Tasks on different strands run concurrently, up to the number of threads. Ready strands are
+ * served round robin, so a strand with a long backlog cannot starve the others.
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(std::size_t numThreads);
+
+    /**
+     * @brief Waits for every queued task to finish, then stops the threads. Delayed tasks
+     * that are not yet due are dropped.
+     */
+    ~WorkerPool();
+
+    /**
+     * @brief Queues a task to run after every task previously posted to the same strand.
+     *
+     * @param strand The key that serializes dependent tasks, e.g. a link ID.
+     * @param task The task to run. Exceptions thrown by the task are logged and dropped.
+     */
+    void post(const std::string &strand, std::function<void()> task);
+
+    /**
+     * @brief Queues a task on a strand once a delay has passed, e.g. to retry failed work.
+     * The task is ordered after whatever was posted to the strand before it became due.
+     *
+     * @param strand The key that serializes dependent tasks, e.g. a link ID.
+     * @param delay How long to wait before queueing the task.
+     * @param task The task to run.
+     */
+    void postAfter(const std::string &strand, std::chrono::milliseconds delay,
+                   std::function<void()> task);
+
+    // Disable copying or moving
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+private:
+    struct Strand {
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool enqueue(const std::string &strand, std::function<void()> task);
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    // A strand is listed here while it has tasks and none of them is running
+    std::deque<std::string> readyStrands;
+    std::unordered_map<std::string, Strand> strands;
+    // Delayed tasks by due time
+    std::multimap<std::chrono::steady_clock::time_point,
+                  std::pair<std::string, std::function<void()>>>
+        timers;
+    bool stopping{false};
+    std::vector<std::thread> threads;
+};
+
+#endif  // __COMMS_MASTODON_COMMON_WORKER_POOL_H__
@@ -19,6 +19,14 @@
 
 #include <stdexcept>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE64_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define BASE64_NEON 1
+#endif
+
 constexpr char b64_encode_table[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
     "abcdefghijklmnopqrstuvwxyz"
@@ -48,42 +56,42 @@ constexpr std::int8_t b64_decode_table[] = {
 };
 static_assert(sizeof(b64_decode_table) == 256);
 
-std::string base64::encode(const RawData &data) {
-    std::string b64;
-    b64.reserve((data.size() + 2) / 3 * 4);
-    auto it = data.begin();
-    const std::size_t size = data.size();
+// Scalar implementation. This is the reference the vectorized paths must match, and it handles
+// the input left over after the vectorized loops as well as all error reporting.
+
+static std::size_t encodeScalar(const std::uint8_t *it, std::size_t size, char *out) {
+    char *const begin = out;
 
     for (std::size_t i = 0; i < size / 3; it += 3, ++i) {
-        b64.push_back(b64_encode_table[((it[0] & 0xFC) >> 2)]);
-        b64.push_back(b64_encode_table[((it[0] & 0x03) << 4) | ((it[1] & 0xF0) >> 4)]);
-        b64.push_back(b64_encode_table[((it[1] & 0x0F) << 2) | ((it[2] & 0xC0) >> 6)]);
-        b64.push_back(b64_encode_table[((it[2] & 0x3F) << 0)]);
+        *out++ = b64_encode_table[((it[0] & 0xFC) >> 2)];
+        *out++ = b64_encode_table[((it[0] & 0x03) << 4) | ((it[1] & 0xF0) >> 4)];
+        *out++ = b64_encode_table[((it[1] & 0x0F) << 2) | ((it[2] & 0xC0) >> 6)];
+        *out++ = b64_encode_table[((it[2] & 0x3F) << 0)];
     }
 
     switch (size % 3) {
         case 1:
-            b64.push_back(b64_encode_table[((it[0] & 0xFC) >> 2)]);
-            b64.push_back(b64_encode_table[((it[0] & 0x03) << 4)]);
-            b64.push_back('=');
-            b64.push_back('=');
+            *out++ = b64_encode_table[((it[0] & 0xFC) >> 2)];
+            *out++ = b64_encode_table[((it[0] & 0x03) << 4)];
+            *out++ = '=';
+            *out++ = '=';
             break;
         case 2:
-            b64.push_back(b64_encode_table[((it[0] & 0xFC) >> 2)]);
-            b64.push_back(b64_encode_table[((it[0] & 0x03) << 4) | ((it[1] & 0xF0) >> 4)]);
-            b64.push_back(b64_encode_table[((it[1] & 0x0F) << 2)]);
-            b64.push_back('=');
+            *out++ = b64_encode_table[((it[0] & 0xFC) >> 2)];
+            *out++ = b64_encode_table[((it[0] & 0x03) << 4) | ((it[1] & 0xF0) >> 4)];
+            *out++ = b64_encode_table[((it[1] & 0x0F) << 2)];
+            *out++ = '=';
             break;
 
         default:
             break;
     }
 
-    return b64;
+    return out - begin;
 }
 
-template <int I, class T>
-static void decode_block(RawData &data, T &it) {
+template <int I>
+static void decode_block(std::uint8_t *&out, const char *&it) {
     std::int8_t a, b, c, d;
 
     if ((I >= 1 && (a = b64_decode_table[std::uint8_t(*it++)]) < 0) ||
@@ -94,40 +102,373 @@ static void decode_block(RawData &data, T &it) {
     }
 
     if constexpr (I >= 1) {
-        data.push_back(((std::uint8_t(a) & 0x3F) << 2) | ((std::uint8_t(b) & 0x30) >> 4));
+        *out++ = ((std::uint8_t(a) & 0x3F) << 2) | ((std::uint8_t(b) & 0x30) >> 4);
     }
     if constexpr (I >= 2) {
-        data.push_back(((std::uint8_t(b) & 0x0F) << 4) | ((std::uint8_t(c) & 0x3C) >> 2));
+        *out++ = ((std::uint8_t(b) & 0x0F) << 4) | ((std::uint8_t(c) & 0x3C) >> 2);
     }
     if constexpr (I >= 3) {
-        data.push_back(((std::uint8_t(c) & 0x03) << 6) | ((std::uint8_t(d) & 0x3F) >> 0));
+        *out++ = ((std::uint8_t(c) & 0x03) << 6) | ((std::uint8_t(d) & 0x3F) >> 0);
     }
 }
 
-RawData base64::decode(const std::string &b64) {
-    if (b64.size() % 4 != 0) {
-        throw std::invalid_argument("Invalid length for base64 encoded string");
-    }
-    if (b64.size() == 0) {
-        return {};
-    }
-
-    RawData data;
-    data.reserve(b64.size() / 4 * 3);
-    auto it = b64.begin();
-    const std::size_t size = b64.size();
+// Decodes the remaining characters, which must be whole blocks including the final padded one
+static std::size_t decodeScalar(const char *it, std::size_t size, std::uint8_t *out) {
+    std::uint8_t *const begin = out;
 
     for (std::size_t i = 0; i < size / 4 - 1; ++i) {
-        decode_block<3>(data, it);
+        decode_block<3>(out, it);
     }
 
     if (it[3] != '=') {
-        decode_block<3>(data, it);
+        decode_block<3>(out, it);
     } else if (it[2] != '=') {
-        decode_block<2>(data, it);
+        decode_block<2>(out, it);
     } else {
-        decode_block<1>(data, it);
+        decode_block<1>(out, it);
+    }
+
+    return out - begin;
+}
+
+// Vectorized implementations. Each consumes as many whole blocks as it can and returns the
+// number of input bytes consumed and output bytes written; the scalar code finishes the rest.
+// Decoding always leaves the final block, which may hold padding, to the scalar code, and stops
+// early at an invalid block so the scalar code reports it.
+//
+// The x86 versions follow Muła and Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions": the bit fields are split out with multiplies and translated to and from ASCII
+// with pshufb lookups on their high nibbles.
+
+struct Progress {
+    std::size_t consumed = 0;
+    std::size_t written = 0;
+};
+
+#if defined(BASE64_X86)
+
+__attribute__((target("ssse3"))) static Progress encodeSsse3(const std::uint8_t *in,
+                                                                 std::size_t size, char *out) {
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    Progress progress;
+
+    // Each step reads 16 bytes but only encodes the first 12
+    while (size - progress.consumed >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + progress.consumed));
+        v = _mm_shuffle_epi8(v, shuffle);
+        const __m128i t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(t1, t3);
+
+        __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        offsets = _mm_or_si128(offsets, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        const __m128i ascii = _mm_add_epi8(_mm_shuffle_epi8(shiftLut, offsets), indices);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + progress.written), ascii);
+        progress.consumed += 12;
+        progress.written += 16;
+    }
+    return progress;
+}
+
+__attribute__((target("avx2"))) static Progress encodeAvx2(const std::uint8_t *in,
+                                                               std::size_t size, char *out) {
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shiftLut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,
+        'A', 0, 0);
+    Progress progress;
+
+    // Each step encodes 24 bytes, 12 in each lane, reading up to 28
+    while (size - progress.consumed >= 28) {
+        const std::uint8_t *src = in + progress.consumed;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuffle);
+        const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        offsets = _mm256_or_si256(offsets, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        const __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLut, offsets), indices);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + progress.written), ascii);
+        progress.consumed += 24;
+        progress.written += 32;
+    }
+    return progress;
+}
+
+__attribute__((target("ssse3"))) static Progress decodeSsse3(const char *in, std::size_t size,
+                                                                 std::uint8_t *out) {
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask2F = _mm_set1_epi8(0x2F);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    Progress progress;
+
+    // Each step decodes 16 characters into 12 bytes but stores 16. Keeping two blocks back
+    // leaves the final block for the scalar code and room in out for the extra 4 bytes.
+    while (size - progress.consumed >= 16 + 8) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + progress.consumed));
+        const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask2F);
+        const __m128i lo = _mm_shuffle_epi8(lutLo, _mm_and_si128(v, mask2F));
+        const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) !=
+            0xFFFF) {
+            break;
+        }
+        const __m128i roll =
+            _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask2F), hiNibbles));
+        const __m128i sextets = _mm_add_epi8(v, roll);
+
+        const __m128i pairs = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+        const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + progress.written),
+                         _mm_shuffle_epi8(words, pack));
+        progress.consumed += 16;
+        progress.written += 12;
+    }
+    return progress;
+}
+
+__attribute__((target("avx2"))) static Progress decodeAvx2(const char *in, std::size_t size,
+                                                               std::uint8_t *out) {
+    const __m256i lutLo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B,
+        0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B,
+        0x1B, 0x1A);
+    const __m256i lutHi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0,
+                                             0, 0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0,
+                                             0, 0, 0, 0);
+    const __m256i mask2F = _mm256_set1_epi8(0x2F);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    Progress progress;
+
+    // Each step decodes 32 characters into 24 bytes, storing 12 from each lane with 16-byte
+    // stores. As for SSSE3, two blocks are kept back for the scalar code and the extra 4 bytes.
+    while (size - progress.consumed >= 32 + 8) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + progress.consumed));
+        const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask2F);
+        const __m256i lo = _mm256_shuffle_epi8(lutLo, _mm256_and_si256(v, mask2F));
+        const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+        const __m256i roll = _mm256_shuffle_epi8(
+            lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask2F), hiNibbles));
+        const __m256i sextets = _mm256_add_epi8(v, roll);
+
+        const __m256i pairs = _mm256_maddubs_epi16(sextets, _mm256_set1_epi32(0x01400140));
+        const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        const __m256i bytes = _mm256_shuffle_epi8(words, pack);
+        std::uint8_t *dst = out + progress.written;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(bytes));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12), _mm256_extracti128_si256(bytes, 1));
+        progress.consumed += 32;
+        progress.written += 24;
+    }
+    return progress;
+}
+
+#elif defined(BASE64_NEON)
+
+// NEON has 64-byte table lookups, so it encodes and decodes with the tables directly on
+// de-interleaved loads of 48 bytes or 64 characters.
+
+static Progress encodeNeon(const std::uint8_t *in, std::size_t size, char *out) {
+    const std::uint8_t *table = reinterpret_cast<const std::uint8_t *>(b64_encode_table);
+    const uint8x16x4_t lut = {{vld1q_u8(table), vld1q_u8(table + 16), vld1q_u8(table + 32),
+                               vld1q_u8(table + 48)}};
+    const uint8x16_t mask3F = vdupq_n_u8(0x3F);
+    Progress progress;
+
+    while (size - progress.consumed >= 48) {
+        const uint8x16x3_t v = vld3q_u8(in + progress.consumed);
+        uint8x16x4_t indices;
+        indices.val[0] = vshrq_n_u8(v.val[0], 2);
+        indices.val[1] =
+            vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4), vshrq_n_u8(v.val[1], 4)), mask3F);
+        indices.val[2] =
+            vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2), vshrq_n_u8(v.val[2], 6)), mask3F);
+        indices.val[3] = vandq_u8(v.val[2], mask3F);
+
+        uint8x16x4_t ascii;
+        for (int i = 0; i < 4; ++i) {
+            ascii.val[i] = vqtbl4q_u8(lut, indices.val[i]);
+        }
+        vst4q_u8(reinterpret_cast<std::uint8_t *>(out + progress.written), ascii);
+        progress.consumed += 48;
+        progress.written += 64;
+    }
+    return progress;
+}
+
+static Progress decodeNeon(const char *in, std::size_t size, std::uint8_t *out) {
+    // Only the ASCII half of the table is needed, characters above it are rejected separately
+    const std::uint8_t *table = reinterpret_cast<const std::uint8_t *>(b64_decode_table);
+    const uint8x16x4_t lutLo = {{vld1q_u8(table), vld1q_u8(table + 16), vld1q_u8(table + 32),
+                                 vld1q_u8(table + 48)}};
+    const uint8x16x4_t lutHi = {{vld1q_u8(table + 64), vld1q_u8(table + 80),
+                                 vld1q_u8(table + 96), vld1q_u8(table + 112)}};
+    const uint8x16_t offset = vdupq_n_u8(64);
+    Progress progress;
+
+    // Keep the final block, which may hold padding, for the scalar code
+    while (size - progress.consumed >= 64 + 4) {
+        const uint8x16x4_t v =
+            vld4q_u8(reinterpret_cast<const std::uint8_t *>(in + progress.consumed));
+        uint8x16x4_t sextets;
+        uint8x16_t invalid = vdupq_n_u8(0);
+        for (int i = 0; i < 4; ++i) {
+            // Lookups out of range give 0 from vqtbl4q and leave the lane alone in vqtbx4q
+            uint8x16_t s = vqtbl4q_u8(lutLo, v.val[i]);
+            s = vqtbx4q_u8(s, lutHi, vsubq_u8(v.val[i], offset));
+            // Invalid characters map to 0xFF, and non-ASCII ones have their own high bit set
+            invalid = vorrq_u8(invalid, vorrq_u8(s, v.val[i]));
+            sextets.val[i] = s;
+        }
+        if (vmaxvq_u8(invalid) & 0x80) {
+            break;
+        }
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(sextets.val[0], 2), vshrq_n_u8(sextets.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(sextets.val[1], 4), vshrq_n_u8(sextets.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(sextets.val[2], 6), sextets.val[3]);
+        vst3q_u8(out + progress.written, bytes);
+        progress.consumed += 64;
+        progress.written += 48;
+    }
+    return progress;
+}
+
+#endif
+
+// CPU dispatch, resolved once on first use
+
+using EncodeImpl = Progress (*)(const std::uint8_t *, std::size_t, char *);
+using DecodeImpl = Progress (*)(const char *, std::size_t, std::uint8_t *);
+
+static Progress encodeNone(const std::uint8_t *, std::size_t, char *) {
+    return {};
+}
+
+static Progress decodeNone(const char *, std::size_t, std::uint8_t *) {
+    return {};
+}
+
+struct Implementation {
+    base64::Isa isa;
+    EncodeImpl encode;
+    DecodeImpl decode;
+};
+
+// Sets impl to the implementation for isa, false if this CPU cannot run it
+static bool implementationFor(base64::Isa isa, Implementation &impl) {
+    switch (isa) {
+#if defined(BASE64_X86)
+        case base64::Isa::AVX2:
+            if (__builtin_cpu_supports("avx2")) {
+                impl = {isa, encodeAvx2, decodeAvx2};
+                return true;
+            }
+            return false;
+        case base64::Isa::SSSE3:
+            if (__builtin_cpu_supports("ssse3")) {
+                impl = {isa, encodeSsse3, decodeSsse3};
+                return true;
+            }
+            return false;
+#elif defined(BASE64_NEON)
+        case base64::Isa::NEON:
+            // NEON is part of the AArch64 baseline
+            impl = {isa, encodeNeon, decodeNeon};
+            return true;
+#endif
+        case base64::Isa::SCALAR:
+            impl = {isa, encodeNone, decodeNone};
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Implementation selectImplementation() {
+    Implementation impl{};
+    for (base64::Isa isa : {base64::Isa::AVX2, base64::Isa::SSSE3, base64::Isa::NEON}) {
+        if (implementationFor(isa, impl)) {
+            return impl;
+        }
+    }
+    implementationFor(base64::Isa::SCALAR, impl);
+    return impl;
+}
+
+static Implementation &implementation() {
+    static Implementation impl = selectImplementation();
+    return impl;
+}
+
+base64::Isa base64::activeIsa() {
+    return implementation().isa;
+}
+
+bool base64::useIsa(Isa isa) {
+    return implementationFor(isa, implementation());
+}
+
+std::size_t base64::encode(const std::uint8_t *data, std::size_t size, char *out) {
+    Progress progress = implementation().encode(data, size, out);
+    return progress.written +
+           encodeScalar(data + progress.consumed, size - progress.consumed, out + progress.written);
+}
+
+std::size_t base64::decode(const char *b64, std::size_t size, std::uint8_t *out) {
+    if (size % 4 != 0) {
+        throw std::invalid_argument("Invalid length for base64 encoded string");
     }
+    if (size == 0) {
+        return 0;
+    }
+
+    Progress progress = implementation().decode(b64, size, out);
+    return progress.written +
+           decodeScalar(b64 + progress.consumed, size - progress.consumed, out + progress.written);
+}
 
+std::string base64::encode(const RawData &data) {
+    std::string b64(encodedLength(data.size()), '\0');
+    encode(data.data(), data.size(), b64.data());
+    return b64;
+}
+
+RawData base64::decode(const std::string &b64) {
+    RawData data(decodedMaxLength(b64.size()));
+    data.resize(decode(b64.data(), b64.size(), data.data()));
     return data;
 }
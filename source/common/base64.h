@@ -20,11 +20,56 @@
 
 #include <EncPkg.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 namespace base64 {
+
+// Number of characters encode writes for size bytes of data
+constexpr std::size_t encodedLength(std::size_t size) {
+    return (size + 2) / 3 * 4;
+}
+
+// Upper bound on the bytes decode writes for size characters of Base64
+constexpr std::size_t decodedMaxLength(std::size_t size) {
+    return size / 4 * 3;
+}
+
+/**
+ * @brief Encodes size bytes of data into out, which must hold encodedLength(size) characters.
+ *        No null terminator is written.
+ *
+ * @return The number of characters written.
+ */
+std::size_t encode(const std::uint8_t *data, std::size_t size, char *out);
+
+/**
+ * @brief Decodes size characters of Base64 into out, which must hold decodedMaxLength(size)
+ *        bytes. Throws std::invalid_argument if the input is not valid Base64.
+ *
+ * @return The number of bytes written.
+ */
+std::size_t decode(const char *b64, std::size_t size, std::uint8_t *out);
+
 std::string encode(const RawData &data);
 RawData decode(const std::string &b64);
+
+// The implementations encode and decode dispatch between. The vectorized ones leave what
+// their loops do not cover, and all error reporting, to the scalar code.
+enum class Isa { SCALAR, SSSE3, AVX2, NEON };
+
+// The implementation in use, the fastest this CPU supports unless useIsa changed it
+Isa activeIsa();
+
+/**
+ * @brief Switches encode and decode to an implementation, e.g. to check each against the
+ *        scalar code. Not safe to call while other threads encode or decode.
+ *
+ * @return false, leaving the implementation unchanged, if it is not built for this
+ *         architecture or the CPU does not support it.
+ */
+bool useIsa(Isa isa);
 }  // namespace base64
 
 #endif  // __TWOSIX_BASE64_H__
@@ -17,7 +17,10 @@
 
 #include "log.h"
 
+#include <atomic>
+
 static const std::string pluginNameForLogging = "PluginMastodon";
+static std::atomic<bool> debugLogging{true};
 
 void logDebug(const std::string &message) {
     RaceLog::logDebug(pluginNameForLogging, message, "");
@@ -34,3 +37,11 @@ void logWarning(const std::string &message) {
 void logError(const std::string &message) {
     RaceLog::logError(pluginNameForLogging, message, "");
 }
+
+bool isDebugLogging() {
+    return debugLogging.load(std::memory_order_relaxed);
+}
+
+void setDebugLogging(bool enabled) {
+    debugLogging.store(enabled, std::memory_order_relaxed);
+}
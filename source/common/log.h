@@ -27,6 +27,18 @@ void logInfo(const std::string &message);
 void logWarning(const std::string &message);
 void logError(const std::string &message);
 
+// True unless debug messages have been turned off with setDebugLogging
+bool isDebugLogging();
+void setDebugLogging(bool enabled);
+
+// Writes a debug message, formatting it only if debug logging is on
+#define LOG_DEBUG(message)      \
+    do {                        \
+        if (isDebugLogging()) { \
+            logDebug(message);  \
+        }                       \
+    } while (0)
+
 #define TRACE_METHOD(...) TRACE_METHOD_BASE(PluginMastodon, ##__VA_ARGS__)
 #define TRACE_FUNCTION(...) TRACE_FUNCTION_BASE(PluginMastodon, ##__VA_ARGS__)
 
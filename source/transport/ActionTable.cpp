@@ -0,0 +1,59 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "ActionTable.h"
+
+ActionTable::Shard &ActionTable::shardFor(uint64_t actionId) {
+    // Action IDs are usually sequential, the multiply spreads neighbours across shards
+    return shards[(actionId * 0x9E3779B97F4A7C15ull) >> 60];
+}
+
+void ActionTable::record(uint64_t actionId, const std::string &linkId, const std::string &contentType) {
+    Shard &shard = shardFor(actionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Stored &stored = shard.actions[actionId];
+    stored.linkId.assign(linkId);
+    stored.contentType.assign(contentType);
+}
+
+bool ActionTable::take(uint64_t actionId, Entry &entry) {
+    Shard &shard = shardFor(actionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.actions.find(actionId);
+    if (iter == shard.actions.end()) {
+        return false;
+    }
+    entry.linkId.assign(iter->second.linkId);
+    entry.contentType.assign(iter->second.contentType);
+    shard.actions.erase(iter);
+    return true;
+}
+
+void ActionTable::erase(uint64_t actionId) {
+    Shard &shard = shardFor(actionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.actions.erase(actionId);
+}
+
+std::size_t ActionTable::size() const {
+    std::size_t total = 0;
+    for (const Shard &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.actions.size();
+    }
+    return total;
+}
@@ -0,0 +1,93 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef __COMMS_MASTODON_TRANSPORT_ACTION_TABLE_H__
+#define __COMMS_MASTODON_TRANSPORT_ACTION_TABLE_H__
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief The link and content type of each action that has content enqueued, between
+ * enqueueContent and the doAction or dequeueContent that consumes it.
+ *
+ * Actions are spread over independently locked shards by ID, so actions dispatched from
+ * different threads rarely wait for each other. Each shard allocates its entries from its
+ * own pool, which recycles the nodes of consumed actions instead of going back to the heap.
+ *
+ * Every method is thread-safe.
+ */
+class ActionTable {
+public:
+    struct Entry {
+        std::string linkId;
+        std::string contentType;  // Type of the last fragment enqueued
+    };
+
+    ActionTable() = default;
+    ActionTable(const ActionTable &) = delete;
+    ActionTable &operator=(const ActionTable &) = delete;
+
+    // Records the link and content type of an action, replacing any earlier record
+    void record(uint64_t actionId, const std::string &linkId, const std::string &contentType);
+
+    /**
+     * @brief Removes the record of an action.
+     *
+     * @param actionId The action to remove.
+     * @param entry Set to the record, if there was one.
+     * @return false if the action had no record.
+     */
+    bool take(uint64_t actionId, Entry &entry);
+
+    void erase(uint64_t actionId);
+
+    std::size_t size() const;
+
+private:
+    // Allocator-aware so that its strings come from the shard's pool along with the node
+    struct Stored {
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        explicit Stored(const allocator_type &alloc = {}) : linkId(alloc), contentType(alloc) {}
+        Stored(const Stored &other, const allocator_type &alloc) :
+            linkId(other.linkId, alloc), contentType(other.contentType, alloc) {}
+        Stored(Stored &&other, const allocator_type &alloc) :
+            linkId(std::move(other.linkId), alloc), contentType(std::move(other.contentType), alloc) {}
+
+        std::pmr::string linkId;
+        std::pmr::string contentType;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::pmr::unsynchronized_pool_resource pool;  // Guarded by mutex, like the map using it
+        std::pmr::unordered_map<uint64_t, Stored> actions{&pool};
+    };
+
+    static const std::size_t numShards = 16;
+
+    Shard &shardFor(uint64_t actionId);
+
+    std::array<Shard, numShards> shards;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_ACTION_TABLE_H__
@@ -0,0 +1,203 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "HtmlText.h"
+
+#include <libxml/HTMLparser.h>
+
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+static bool isAsciiAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static void appendUtf8(std::string &text, std::uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        text += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        text += static_cast<char>(0xC0 | (codePoint >> 6));
+        text += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        text += static_cast<char>(0xE0 | (codePoint >> 12));
+        text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        text += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        text += static_cast<char>(0xF0 | (codePoint >> 18));
+        text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        text += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+/**
+ * @brief Decodes the character reference starting at html[pos], which is '&'.
+ *
+ * @return The position after the reference, or 0 if it is not one the fast path handles.
+ */
+static std::size_t decodeReference(std::string_view html, std::size_t pos, std::string &text) {
+    std::size_t end = html.find(';', pos + 1);
+    if (end == std::string_view::npos || end - pos > 10) {
+        return 0;
+    }
+    std::string_view name = html.substr(pos + 1, end - pos - 1);
+    if (name.size() >= 2 && name[0] == '#') {
+        bool hex = name[1] == 'x' || name[1] == 'X';
+        std::size_t digits = hex ? 2 : 1;
+        if (digits >= name.size()) {
+            return 0;
+        }
+        std::uint32_t codePoint = 0;
+        for (std::size_t i = digits; i < name.size(); ++i) {
+            char c = name[i];
+            int value;
+            if (c >= '0' && c <= '9') {
+                value = c - '0';
+            } else if (hex && c >= 'a' && c <= 'f') {
+                value = c - 'a' + 10;
+            } else if (hex && c >= 'A' && c <= 'F') {
+                value = c - 'A' + 10;
+            } else {
+                return 0;
+            }
+            codePoint = codePoint * (hex ? 16 : 10) + value;
+        }
+        // Leave NUL, surrogates and out of range values to the full parser
+        if (codePoint == 0 || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+            return 0;
+        }
+        appendUtf8(text, codePoint);
+    } else if (name == "amp") {
+        text += '&';
+    } else if (name == "lt") {
+        text += '<';
+    } else if (name == "gt") {
+        text += '>';
+    } else if (name == "quot") {
+        text += '"';
+    } else if (name == "apos") {
+        text += '\'';
+    } else if (name == "nbsp") {
+        appendUtf8(text, 0xA0);
+    } else {
+        return 0;
+    }
+    return end + 1;
+}
+
+/**
+ * @brief Skips the tag starting at html[pos], which is '<'.
+ *
+ * @return The position after the tag, or 0 if it is not one the fast path handles.
+ */
+static std::size_t skipTag(std::string_view html, std::size_t pos) {
+    std::size_t nameStart = pos + 1;
+    if (nameStart < html.size() && html[nameStart] == '/') {
+        ++nameStart;
+    }
+    if (nameStart >= html.size() || !isAsciiAlpha(html[nameStart])) {
+        // Comments, doctypes, processing instructions and stray '<'
+        return 0;
+    }
+
+    std::size_t nameEnd = nameStart;
+    while (nameEnd < html.size() && (std::isalnum(static_cast<unsigned char>(html[nameEnd])))) {
+        ++nameEnd;
+    }
+    std::string name(html.substr(nameStart, nameEnd - nameStart));
+    for (auto &c : name) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    // Elements whose content is not markup, or is dropped by the parser
+    if (name == "script" || name == "style" || name == "textarea" || name == "title" ||
+        name == "xmp" || name == "plaintext" || name == "noscript" || name == "template") {
+        return 0;
+    }
+
+    // Attribute values may contain '>' when quoted
+    char quote = 0;
+    for (std::size_t i = nameEnd; i < html.size(); ++i) {
+        char c = html[i];
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '<') {
+            return 0;
+        } else if (c == '>') {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool extractStatusText(std::string_view html, std::string &text) {
+    text.clear();
+    text.reserve(html.size());
+
+    // Whitespace before the first element or text is not part of the document body. Stray
+    // end tags there are left to the parser, which treats the whitespace after them unevenly.
+    std::size_t pos = html.find_first_not_of(" \t\n");
+    if (pos == std::string_view::npos) {
+        return true;
+    }
+    if (html.compare(pos, 2, "</") == 0) {
+        return false;
+    }
+
+    while (pos < html.size()) {
+        // Copy the run of plain text up to the next tag or reference in one go
+        std::size_t special = html.find_first_of("<&\r", pos);
+        if (special == std::string_view::npos) {
+            text.append(html.substr(pos));
+            break;
+        }
+        text.append(html.substr(pos, special - pos));
+
+        if (html[special] == '\r') {
+            // The parser normalizes line endings
+            return false;
+        }
+        pos = html[special] == '<' ? skipTag(html, special) : decodeReference(html, special, text);
+        if (pos == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string stripHtmlWithLibxml2(const std::string &html) {
+    // Parse the HTML content
+    htmlDocPtr doc = htmlReadMemory(html.c_str(), html.size(), NULL, "UTF-8", HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    if (!doc) {
+        throw std::runtime_error("Failed to parse HTML content");
+    }
+
+    // Extract plain text
+    xmlChar *plainText = xmlNodeGetContent(xmlDocGetRootElement(doc));
+    std::string result;
+    if (plainText) {
+        result = reinterpret_cast<const char *>(plainText);
+        xmlFree(plainText);
+    }
+
+    // Free the document
+    xmlFreeDoc(doc);
+    return result;
+}
@@ -0,0 +1,46 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_HTML_TEXT_H__
+#define __COMMS_MASTODON_TRANSPORT_HTML_TEXT_H__
+
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Extracts the text of a status from the HTML subset Mastodon renders statuses in.
+ *
+ * Tags are dropped and character references are decoded in a single pass over the input,
+ * without building a document. The result matches the concatenated text content of the
+ * parsed document. Markup outside the subset, such as comments, raw text elements like
+ * <script> or unknown named entities, is rejected so the caller can fall back to a full
+ * HTML parser.
+ *
+ * @param html The HTML content of a status.
+ * @param text Set to the plain text. Its contents are unspecified if false is returned.
+ * @return false if the markup needs a full HTML parser.
+ */
+bool extractStatusText(std::string_view html, std::string &text);
+
+/**
+ * @brief Extracts the text content of any HTML with libxml2, for markup that
+ * extractStatusText rejects. The input is read as UTF-8.
+ *
+ * @throws std::runtime_error If libxml2 cannot parse the HTML at all.
+ */
+std::string stripHtmlWithLibxml2(const std::string &html);
+
+#endif  // __COMMS_MASTODON_TRANSPORT_HTML_TEXT_H__
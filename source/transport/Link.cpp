@@ -15,6 +15,13 @@
 //
 
 #include "Link.h"
+#include "Digest.h"
+#include "PackageFraming.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
 #include <string>
 #include <sstream>
 
@@ -22,22 +29,103 @@ Link::Link(const LinkID& id,
            const LinkAddress& addr,
            const LinkProperties& props,
            ITransportSdk* sdk,
-           MastodonClient* mastodonClient)
+           MastodonClientPool* clients,
+           WorkerPool* workers)
     : linkId(id),
       address(addr),
+      hashtag("#" + addr.hashtag),
       properties(props),
       sdk(sdk),
-      mastodonClient(mastodonClient),
+      clients(clients),
+      workers(workers),
       logPrefix("[Link " + id + "] ") {
     this->properties.linkAddress = nlohmann::json(this->address).dump();
 }
 
+// Actions replayed from the spool are posted under IDs the SDK never hands out
+static const uint64_t replayActionIds = uint64_t(1) << 63;
+
 void Link::start() {
-    // Any startup logic if needed
+    getHomeClient()->retainOwnPosts(getHashtag());
+
+    const std::string& directory = clients->getConfig().spoolDirectory;
+    if (directory.empty()) {
+        return;
+    }
+    // The file is named by a digest of the address, which comes from a peer, so that no hashtag
+    // can name a path outside the directory and links on different servers do not collide
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.spool",
+                  static_cast<unsigned long long>(digest64(address.server + "\n" + address.hashtag)));
+    try {
+        spool = Spool::open(directory + "/" + name);
+    } catch (std::exception& e) {
+        logError(logPrefix + "Posting without a spool: " + e.what());
+        return;
+    }
+    replaySpool();
+}
+
+void Link::replaySpool() {
+    std::vector<Spool::Action> actions = spool->takeReplay();
+    if (actions.empty()) {
+        return;
+    }
+    logInfo(logPrefix + "Posting " + std::to_string(actions.size()) + " actions left in the spool");
+
+    // The packages are no longer tracked by the SDK, so they are posted without handles
+    std::shared_ptr<Link> self = shared_from_this();
+    for (auto& action : actions) {
+        uint64_t actionId = replayActionIds | action.id;
+        ActionContent content;
+        content.textContent = std::move(action.text);
+        content.hasText = action.hasText;
+        for (const auto& image : action.images) {
+            content.images.push_back({nullptr, {}, image});
+        }
+        content.hasImage = !content.images.empty();
+        content.spoolId = action.id;
+        {
+            std::lock_guard<std::mutex> lock(contentMutex);
+            contentQueue.emplace(actionId, std::move(content));
+            clients->getMetrics().setQueueDepth(linkId, contentQueue.size());
+        }
+        if (workers != nullptr) {
+            workers->post(linkId, [self, actionId] { self->post({}, actionId); });
+        } else {
+            post({}, actionId);
+        }
+    }
+}
+
+void Link::unspool(const ActionContent& content) {
+    if (spool && content.spoolId != 0) {
+        spool->remove(content.spoolId);
+    }
+}
+
+MastodonClient::ImageSource Link::imageSource(const ActionImage& image) const {
+    if (image.content) {
+        auto content = image.content;
+        return [content] { return content; };
+    }
+    auto spooled = image.spooled;
+    auto source = spool;
+    return [source, spooled] { return source->readImage(spooled); };
 }
 
 void Link::shutdown() {
-    // Any shutdown/cleanup logic if needed
+    // Posts waiting to be retried fail instead of running after the link is gone
+    isShutdown = true;
+    // So does a batch still waiting for its window. The flush is posted now rather than left
+    // to the timer, as a pool being destroyed drops timers that are not yet due but runs
+    // what is queued.
+    if (workers != nullptr) {
+        std::shared_ptr<Link> self = shared_from_this();
+        workers->post(linkId, [self] { self->flushBatch(); });
+    }
+    getHomeClient()->releaseOwnPosts(getHashtag());
+    clients->getMetrics().removeLink(linkId);
 }
 
 LinkID Link::getId() const {
@@ -45,110 +133,401 @@ LinkID Link::getId() const {
 }
 
 
-const LinkProperties& Link::getProperties() const {
-    return properties;
+const std::string& Link::getHashtag() const {
+    return hashtag;
 }
 
-ComponentStatus Link::enqueueContent(uint64_t actionId, const std::vector<uint8_t>& content, const std::string& contentType) {
-    if (contentType == "text/plain") {
-        contentQueue[actionId].textContent = content;
-        contentQueue[actionId].hasText = true;
-        logDebug(logPrefix + "Enqueued text content for action " + std::to_string(actionId));
-    } else if (contentType == "image/jpeg") {
-        contentQueue[actionId].imageContent = content;
-        contentQueue[actionId].hasImage = true;
-        logDebug(logPrefix + "Enqueued image content for action " + std::to_string(actionId));
-    } else {
+const std::string& Link::getServer() const {
+    return address.server;
+}
+
+MastodonClient* Link::getClient(RateLimiter::Endpoint endpoint) const {
+    return clients->clientFor(address.server, getHashtag(), endpoint);
+}
+
+MastodonClient* Link::getHomeClient() const {
+    return clients->homeClient(address.server, getHashtag());
+}
+
+// Weight of a new measurement in a smoothed latency
+static const double latencySmoothing = 0.125;
+
+static void smoothLatency(double& estimateMs, std::chrono::microseconds elapsed) {
+    double ms = static_cast<double>(elapsed.count()) / 1000.0;
+    estimateMs = estimateMs < 0 ? ms : estimateMs + latencySmoothing * (ms - estimateMs);
+}
+
+// Applies a measured latency to the expected properties of one direction, raising the worst
+// case to match when it is exceeded
+static void applyLatency(LinkPropertySet& expected, LinkPropertySet& worst, double latencyMs) {
+    if (latencyMs < 0) {
+        return;
+    }
+    expected.latency_ms = static_cast<int>(std::lround(latencyMs));
+    worst.latency_ms = std::max(worst.latency_ms, expected.latency_ms);
+}
+
+LinkProperties Link::getProperties() const {
+    LinkProperties current = properties;
+
+    // Until the server has reported its limits, the channel's mtu is the better guess
+    if (getHomeClient()->getInstanceLimits().known) {
+        current.mtu = static_cast<int>(getStatusRoom());
+    }
+
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    applyLatency(current.expected.send, current.worst.send, postLatencyMs);
+    applyLatency(current.expected.receive, current.worst.receive, fetchLatencyMs);
+    return current;
+}
+
+std::size_t Link::getStatusRoom() const {
+    // The content is followed by a space and the hashtag, and a package may need an escape
+    int maxCharacters = getHomeClient()->getInstanceLimits().maxCharacters;
+    std::size_t limit = static_cast<std::size_t>(std::max(0, maxCharacters));
+    std::size_t reserved = getHashtag().size() + 1 + framing::escapeSize;
+    return limit > reserved ? limit - reserved : 0;
+}
+
+void Link::recordFetchTime(std::chrono::microseconds elapsed) {
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    smoothLatency(fetchLatencyMs, elapsed);
+}
+
+ComponentStatus Link::enqueueContent(uint64_t actionId, std::vector<uint8_t> content, const std::string& contentType) {
+    const bool isText = contentType == "text/plain";
+    if (!isText && contentType != "image/jpeg") {
         logError(logPrefix + "Unknown content type: " + contentType);
         return COMPONENT_ERROR;
     }
+
+    // Content that is refused leaves neither a queue entry nor a spool record behind
+    std::lock_guard<std::mutex> lock(contentMutex);
+    auto iter = contentQueue.find(actionId);
+    if (!isText && iter != contentQueue.end()) {
+        int maxImages = getHomeClient()->getInstanceLimits().maxMediaAttachments;
+        const std::size_t images = iter->second.images.size();
+        if (images >= static_cast<std::size_t>(std::max(1, maxImages))) {
+            logError(logPrefix + "Action " + std::to_string(actionId) + " already has " +
+                     std::to_string(images) + " images, the most the server attaches to a status");
+            return COMPONENT_ERROR;
+        }
+    }
+
+    ActionContent& queued = iter != contentQueue.end() ? iter->second : contentQueue[actionId];
+    if (spool && queued.spoolId == 0) {
+        queued.spoolId = spool->newAction();
+    }
+
+    if (isText) {
+        if (spool && !spool->appendText(queued.spoolId, content)) {
+            logWarning(logPrefix + "Text of action " + std::to_string(actionId) + " is not spooled");
+        }
+        queued.textContent = std::move(content);
+        queued.hasText = true;
+        LOG_DEBUG(logPrefix + "Enqueued text content for action " + std::to_string(actionId));
+    } else {
+        // Start the upload now so that it overlaps the posts of earlier actions and the uploads
+        // of the action's other images. The status must be posted by the same account as every
+        // upload, the media belongs to it.
+        if (queued.uploadClient == nullptr) {
+            queued.uploadClient = getClient(RateLimiter::MEDIA);
+        }
+        // A spooled image is read back from disk when its upload starts instead of waiting in
+        // memory for its turn
+        ActionImage image;
+        if (!spool || !spool->appendImage(queued.spoolId, content, image.spooled)) {
+            image.content = std::make_shared<const std::vector<uint8_t>>(std::move(content));
+        }
+        image.upload = queued.uploadClient->uploadMediaAsync(imageSource(image));
+        queued.images.push_back(std::move(image));
+        queued.hasImage = true;
+        LOG_DEBUG(logPrefix + "Enqueued image " + std::to_string(queued.images.size()) + " for action " +
+                 std::to_string(actionId));
+    }
+    clients->getMetrics().setQueueDepth(linkId, contentQueue.size());
     return COMPONENT_OK;
 }
 
 ComponentStatus Link::dequeueContent(uint64_t actionId) {
-    contentQueue.erase(actionId);
+    std::lock_guard<std::mutex> lock(contentMutex);
+    auto iter = contentQueue.find(actionId);
+    if (iter != contentQueue.end()) {
+        unspool(iter->second);
+        contentQueue.erase(iter);
+    }
+    clients->getMetrics().setQueueDepth(linkId, contentQueue.size());
     return COMPONENT_OK;
 }
 
+// Exponential backoff with jitter, so that links failing together do not retry in lockstep
+static std::chrono::milliseconds retryDelay(int attempts, const MastodonConfig& config) {
+    thread_local std::mt19937 random{std::random_device{}()};
+    double delayMs = config.retryInitialDelayMs * std::pow(2.0, std::max(0, attempts - 1));
+    delayMs = std::min(delayMs, static_cast<double>(config.retryMaxDelayMs));
+    std::uniform_real_distribution<double> jitter(delayMs / 2, delayMs);
+    return std::chrono::milliseconds(static_cast<int64_t>(jitter(random)));
+}
+
 ComponentStatus Link::post(const std::vector<RaceHandle>& handles, uint64_t actionId) {
     TRACE_METHOD(linkId, handles, actionId);
 
-    auto iter = contentQueue.find(actionId);
-    if (iter == contentQueue.end()) {
-        logInfo(logPrefix + "No enqueued content for action ID: " + std::to_string(actionId));
+    if (isShutdown) {
+        logInfo(logPrefix + "Link is shut down, not posting action ID: " + std::to_string(actionId));
         updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
         return COMPONENT_OK;
     }
 
-    const ActionContent& content = iter->second;
-    std::string hashtag = "#" + address.hashtag;
-    bool success = false;
+    // Take the content out of the queue so the upload runs without holding the lock
+    auto start = std::chrono::steady_clock::now();
+    ActionContent content;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        auto iter = contentQueue.find(actionId);
+        if (iter == contentQueue.end() || iter->second.posting) {
+            logInfo(logPrefix + "No enqueued content for action ID: " + std::to_string(actionId));
+            updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
+            return COMPONENT_OK;
+        }
+        content = std::move(iter->second);
+        ActionContent placeholder;
+        placeholder.spoolId = content.spoolId;
+        placeholder.posting = true;
+        iter->second = std::move(placeholder);
+    }
+    if (content.attempts == 0) {
+        content.firstAttempt = start;
+    }
+
+    // Text is held back for the batch window so that it can share a status with the text of
+    // the following actions. Retries are posted on their own.
+    if (content.hasText && !content.hasImage && content.attempts == 0 && workers != nullptr &&
+        clients->getConfig().postBatchWindowMs > 0) {
+        return addToBatch(handles, actionId, std::move(content), start);
+    }
+
+    PostResult result;
 
-    if (content.hasImage && content.hasText) {
-        // Post both text and image together
-        logDebug(logPrefix + "Posting mixed content (text + image) to Mastodon");
-        std::string textStr(content.textContent.begin(), content.textContent.end());
-        success = mastodonClient->postImageWithText(content.imageContent, textStr, hashtag);
-    } else if (content.hasImage) {
-        // Post image only
-        logDebug(logPrefix + "Posting image content to Mastodon");
-        success = mastodonClient->postImage(content.imageContent, hashtag);
+    if (content.hasImage) {
+        // Post the images, with the text if there is any, once all of their uploads have finished
+        LOG_DEBUG(logPrefix + "Posting " + std::to_string(content.images.size()) + " images to Mastodon");
+        bool anyUploaded = std::any_of(content.images.begin(), content.images.end(),
+                                       [](const ActionImage& image) { return image.upload.valid(); });
+        if (!anyUploaded) {
+            // Nothing belongs to the previous account yet, so the upload can move to another one
+            content.uploadClient = getClient(RateLimiter::MEDIA);
+        }
+        for (auto& image : content.images) {
+            if (!image.upload.valid()) {
+                image.upload = content.uploadClient->uploadMediaAsync(imageSource(image));
+            }
+        }
+
+        std::vector<std::string> mediaIds;
+        for (auto& image : content.images) {
+            PostResult media = image.upload.get();
+            if (media.success) {
+                mediaIds.push_back(media.id);
+            } else {
+                // Upload again on the next attempt, the other images are kept
+                image.upload = {};
+                result = media;
+            }
+        }
+        if (mediaIds.size() == content.images.size()) {
+            std::string text = framing::single(std::string_view(
+                reinterpret_cast<const char*>(content.textContent.data()), content.textContent.size()));
+            result = content.uploadClient->createStatus(text, hashtag, mediaIds);
+        }
     } else if (content.hasText) {
         // Post text only
-        logDebug(logPrefix + "Posting text content to Mastodon");
-        std::string textStr(content.textContent.begin(), content.textContent.end());
-        success = mastodonClient->postStatus(textStr, hashtag);
+        LOG_DEBUG(logPrefix + "Posting text content to Mastodon");
+        std::string text = framing::single(std::string_view(
+            reinterpret_cast<const char*>(content.textContent.data()), content.textContent.size()));
+        result = getClient(RateLimiter::STATUSES)->postStatus(text, hashtag);
     } else {
         logError(logPrefix + "No content to post for action ID: " + std::to_string(actionId));
+        dequeueContent(actionId);
         updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
         return COMPONENT_ERROR;
     }
 
-    if (success) {
+    return finishPost(handles, actionId, std::move(content), result, start);
+}
+
+ComponentStatus Link::finishPost(const std::vector<RaceHandle>& handles, uint64_t actionId,
+                                 ActionContent content, const PostResult& result,
+                                 std::chrono::steady_clock::time_point start) {
+    Metrics& metrics = clients->getMetrics();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    metrics.recordPost(linkId, result.success, elapsed);
+    if (result.success) {
+        {
+            std::lock_guard<std::mutex> lock(latencyMutex);
+            smoothLatency(postLatencyMs, elapsed);
+        }
+        unspool(content);
+        {
+            std::lock_guard<std::mutex> lock(contentMutex);
+            contentQueue.erase(actionId);
+            metrics.setQueueDepth(linkId, contentQueue.size());
+        }
         updatePackageStatus(handles, PACKAGE_SENT);
-        contentQueue.erase(actionId);
         return COMPONENT_OK;
-    } else {
-        updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
-        return COMPONENT_ERROR;
     }
+
+    // Put the content back in place of its placeholder so that a retry reuses it as is, until
+    // the SDK dequeues it. If the SDK dequeued it while it was being posted, it is dropped.
+    int attempts = ++content.attempts;
+    auto firstAttempt = content.firstAttempt;
+    {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        auto iter = contentQueue.find(actionId);
+        if (iter == contentQueue.end()) {
+            logInfo(logPrefix + "Action ID " + std::to_string(actionId) + " was dequeued while posting, not retrying");
+            unspool(content);
+            updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
+            return COMPONENT_ERROR;
+        }
+        iter->second = std::move(content);
+    }
+
+    // Transient failures are retried on this link's strand, bounded by the address's maxTries
+    // and by how long the post has been retried for
+    const MastodonConfig& config = clients->getConfig();
+    bool inTime = config.retryMaxElapsedMs <= 0 ||
+                  std::chrono::steady_clock::now() - firstAttempt < std::chrono::milliseconds(config.retryMaxElapsedMs);
+    if (result.retryable && workers != nullptr && attempts < address.maxTries && inTime) {
+        auto delay = retryDelay(attempts, config);
+        logWarning(logPrefix + "Post of action ID " + std::to_string(actionId) + " failed, retry " +
+                   std::to_string(attempts) + " in " + std::to_string(delay.count()) + " ms");
+        metrics.recordRetry(linkId);
+        std::shared_ptr<Link> self = shared_from_this();
+        workers->postAfter(linkId, delay, [self, handles, actionId] { self->post(handles, actionId); });
+        return COMPONENT_OK;
+    }
+
+    // No SDK action will ever dequeue a replayed post, so it is dropped here
+    if ((actionId & replayActionIds) != 0) {
+        logError(logPrefix + "Dropping replayed post after " + std::to_string(attempts) + " attempts");
+        dequeueContent(actionId);
+    }
+    updatePackageStatus(handles, PACKAGE_FAILED_GENERIC);
+    return COMPONENT_ERROR;
+}
+
+ComponentStatus Link::addToBatch(const std::vector<RaceHandle>& handles, uint64_t actionId,
+                                 ActionContent content, std::chrono::steady_clock::time_point start) {
+    const std::size_t room = getStatusRoom();
+
+    ComponentStatus status = COMPONENT_OK;
+    std::size_t size = framing::frameSize(content.textContent.size());
+    if (!batch.empty() && batchSize + size > room) {
+        status = flushBatch();
+    }
+
+    if (batch.empty()) {
+        // The window starts with the first package of the batch. A batch flushed early for
+        // size leaves its timer to find a newer generation and do nothing.
+        batchSize = framing::emptySize;
+        uint64_t generation = ++batchGeneration;
+        std::shared_ptr<Link> self = shared_from_this();
+        workers->postAfter(linkId, std::chrono::milliseconds(clients->getConfig().postBatchWindowMs),
+                           [self, generation] {
+                               if (self->batchGeneration == generation) {
+                                   self->flushBatch();
+                               }
+                           });
+    }
+    batchSize += size;
+    batch.push_back({handles, actionId, std::move(content), start});
+    return status;
+}
+
+ComponentStatus Link::flushBatch() {
+    std::vector<BatchedPost> posts = std::move(batch);
+    batch.clear();
+    ++batchGeneration;
+    if (posts.empty()) {
+        return COMPONENT_OK;
+    }
+
+    if (isShutdown) {
+        for (auto& post : posts) {
+            updatePackageStatus(post.handles, PACKAGE_FAILED_GENERIC);
+        }
+        return COMPONENT_OK;
+    }
+
+    // A batch of one is posted on its own, exactly as it would be without batching
+    std::vector<std::string_view> packages;
+    for (auto& post : posts) {
+        packages.emplace_back(reinterpret_cast<const char*>(post.content.textContent.data()),
+                              post.content.textContent.size());
+    }
+    std::string text = packages.size() == 1 ? framing::single(packages.front()) : framing::frame(packages);
+    LOG_DEBUG(logPrefix + "Posting " + std::to_string(posts.size()) + " packages in one status");
+    PostResult result = getClient(RateLimiter::STATUSES)->postStatus(text, getHashtag());
+
+    // Each package is accounted for, and on failure retried, on its own
+    ComponentStatus status = COMPONENT_OK;
+    for (auto& post : posts) {
+        ComponentStatus postStatus =
+            finishPost(post.handles, post.actionId, std::move(post.content), result, post.start);
+        if (postStatus != COMPONENT_OK) {
+            status = postStatus;
+        }
+    }
+    return status;
 }
 
 ComponentStatus Link::fetch() {
     TRACE_METHOD(linkId);
 
-    std::string hashtag = "#" + address.hashtag;
-    auto results = mastodonClient->searchStatuses(hashtag);
+    if (!getHomeClient()->needsPoll(hashtag)) {
+        LOG_DEBUG(logPrefix + "Stream for " + hashtag + " is caught up, skipping fetch");
+        return COMPONENT_OK;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto results = getClient(RateLimiter::TIMELINES)->searchStatuses(hashtag);
+    recordFetchTime(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
 
     logInfo(logPrefix + "Fetched " + std::to_string(results.size()) + " items for hashtag " + hashtag);
+    return receive(results);
+}
+
+ComponentStatus Link::receive(const std::vector<MastodonContent>& results) {
 
-    // Group content by status (assumes all content from same status should be grouped)
-    // For mixed content, we need to ensure proper ordering: text first, then image
-    std::vector<MastodonContent> textContent;
-    std::vector<MastodonContent> imageContent;
-    
-    // Separate text and image content while preserving retrieval order
+    // Call sdk->onReceive in the same order as getActionParams: text first, then images
+    // This ensures proper fragment ordering for message reconstruction. Each pass keeps
+    // the retrieval order and hands the fetched buffers to the SDK without copying them.
+
+    clients->getMetrics().recordReceived(linkId, results.size());
+
+    // First, send all text content. A status holding a batch of packages is split back into
+    // one onReceive call per package, and an escaped package is delivered without its escape.
+    std::vector<std::string_view> packages;
     for (const auto& content : results) {
         if (content.contentType == "text/plain") {
-            textContent.push_back(content);
-        } else if (content.contentType == "image/jpeg") {
-            imageContent.push_back(content);
+            logInfo(logPrefix + "Fetched text content, size: " + std::to_string(content.data.size()));
+            std::string_view text(reinterpret_cast<const char*>(content.data.data()), content.data.size());
+            if (!framing::unframe(text, packages)) {
+                sdk->onReceive(linkId, {linkId, content.contentType, false, {}}, content.data);
+                continue;
+            }
+            for (auto package : packages) {
+                sdk->onReceive(linkId, {linkId, content.contentType, false, {}},
+                               std::vector<uint8_t>(package.begin(), package.end()));
+            }
         }
     }
-    
-    // Call sdk->onReceive in the same order as getActionParams: text first, then images
-    // This ensures proper fragment ordering for message reconstruction
-    
-    // First, send all text content
-    for (const auto& content : textContent) {
-        logInfo(logPrefix + "Fetched text content, size: " + std::to_string(content.data.size()));
-        sdk->onReceive(linkId, {linkId, content.contentType, false, {}}, content.data);
-    }
-    
-    // Then, send all image content  
-    for (const auto& content : imageContent) {
-        logInfo(logPrefix + "Fetched image content, size: " + std::to_string(content.data.size()));
-        sdk->onReceive(linkId, {linkId, content.contentType, false, {}}, content.data);
+
+    // Then, send all image content
+    for (const auto& content : results) {
+        if (content.contentType == "image/jpeg") {
+            logInfo(logPrefix + "Fetched image content, size: " + std::to_string(content.data.size()));
+            sdk->onReceive(linkId, {linkId, content.contentType, false, {}}, content.data);
+        }
     }
 
     return COMPONENT_OK;
@@ -19,32 +19,61 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <future>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include "LinkAddress.h"
 #include "LinkProperties.h"
 #include "ITransportSdk.h"
 #include "MastodonClient.h"
+#include "MastodonClientPool.h"
+#include "Spool.h"
+#include "WorkerPool.h"
 #include "log.h"
 
+/**
+ * @brief An image of a post and its upload
+ */
+struct ActionImage {
+    std::shared_ptr<const std::vector<uint8_t>> content;  // Shared with the background upload, null if spooled
+    std::shared_future<PostResult> upload;  // Started at enqueue time, reset if it failed
+    Spool::Image spooled;                   // Where the image is in the spool when content is null
+};
+
 /**
  * @brief Structure to hold content with its type for mixed posting
  */
 struct ActionContent {
     std::vector<uint8_t> textContent;
-    std::vector<uint8_t> imageContent;
+    std::vector<ActionImage> images;         // Attached to the status in the order enqueued
+    MastodonClient* uploadClient = nullptr;  // Account every image is uploaded to, the media belongs to it
     bool hasText = false;
     bool hasImage = false;
+    int attempts = 0;  // Failed posts so far
+    std::chrono::steady_clock::time_point firstAttempt;  // When the first post started
+    uint64_t spoolId = 0;  // Action ID of the content in the spool, 0 if not spooled
+    bool posting = false;  // The content is out being posted and this entry only holds its place
 };
 
-class Link {
+class Link : public std::enable_shared_from_this<Link> {
 public:
+    /**
+     * @param clients The accounts to send requests through. Each request goes through the
+     *        account the pool currently places the link on.
+     * @param workers Runs retries of failed posts, may be null to disable retries.
+     */
     Link(const LinkID& id,
          const LinkAddress& addr,
          const LinkProperties& props,
          ITransportSdk* sdk,
-         MastodonClient* mastodonClient);
+         MastodonClientPool* clients,
+         WorkerPool* workers = nullptr);
 
+    // Opens the link's spool, if one is configured, and posts what it still holds
     void start();
+    // Stops retries and fails the text still held back for the batch window
     void shutdown();
     
     /**
@@ -55,30 +84,98 @@ public:
     virtual LinkID getId() const;
 
 
-    const LinkProperties& getProperties() const;
+    /**
+     * @brief The link's properties, with the mtu set to the text a status can carry once the
+     * server has reported its limits, and the expected latencies to what posts and fetches on
+     * the link have measured so far.
+     */
+    LinkProperties getProperties() const;
+
+    // Characters of a status left for a package once the hashtag and its escape are added
+    std::size_t getStatusRoom() const;
+
+    // Records how long a fetch of this link's hashtag took, for the receive latency
+    void recordFetchTime(std::chrono::microseconds elapsed);
 
-    // Enqueue content for a POST action with content type
-    ComponentStatus enqueueContent(uint64_t actionId, const std::vector<uint8_t>& content, const std::string& contentType);
+    // Enqueue content for a POST action with content type. The content is taken by value so
+    // that callers can move it in; it is not copied again on the way to the server.
+    ComponentStatus enqueueContent(uint64_t actionId, std::vector<uint8_t> content, const std::string& contentType);
 
     // Remove content for a POST action
     ComponentStatus dequeueContent(uint64_t actionId);
 
-    // Post content as a Mastodon toot with a unique hashtag
+    // Post content as a Mastodon toot with a unique hashtag. Transient failures are retried
+    // with backoff and the handles are only marked failed once retries run out. With a batch
+    // window configured, text is held back to share a status with the text of later posts.
     ComponentStatus post(const std::vector<RaceHandle>& handles, uint64_t actionId);
 
     // Fetch Mastodon toots with the link's unique hashtag
     ComponentStatus fetch();
 
+    // Deliver content fetched for this link's hashtag to the SDK
+    ComponentStatus receive(const std::vector<MastodonContent>& results);
+
+    // The hashtag, including the leading '#', that this link posts and fetches with
+    const std::string& getHashtag() const;
+
+    // The server the hashtag is posted on, empty for the default server
+    const std::string& getServer() const;
+
+    // The client requests to an endpoint class go through right now
+    MastodonClient* getClient(RateLimiter::Endpoint endpoint) const;
+
+    // The client the link is placed on, which streams its hashtag
+    MastodonClient* getHomeClient() const;
+
 private:
     LinkID linkId;
     LinkAddress address;
+    std::string hashtag;  // "#" and the address's hashtag, built once for every request
     LinkProperties properties;
     ITransportSdk* sdk;
-    MastodonClient* mastodonClient;
+    MastodonClientPool* clients;
+    WorkerPool* workers;
     std::string logPrefix;
+    std::atomic<bool> isShutdown{false};
 
-    // Maps actionId to mixed content (text and/or image)
+    // Maps actionId to mixed content (text and/or image). Enqueued on the SDK thread and
+    // posted from the worker pool, so access is guarded by contentMutex. An action being posted
+    // keeps a placeholder here, so that a dequeue while it is in flight is not lost.
+    std::mutex contentMutex;
     std::unordered_map<uint64_t, ActionContent> contentQueue;
 
+    // Copy of the enqueued content on disk, null unless config.spoolDirectory is set. Shared
+    // with the uploads that read images back from it.
+    std::shared_ptr<Spool> spool;
+
+    // Smoothed time of successful posts and of fetches in milliseconds, -1 until measured
+    mutable std::mutex latencyMutex;
+    double postLatencyMs = -1;
+    double fetchLatencyMs = -1;
+
+    // Text posts waiting for the batch window to close. Only touched on this link's strand.
+    struct BatchedPost {
+        std::vector<RaceHandle> handles;
+        uint64_t actionId;
+        ActionContent content;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::vector<BatchedPost> batch;
+    std::size_t batchSize = 0;       // Characters of the framed batch
+    uint64_t batchGeneration = 0;    // Incremented on every flush, so a stale timer does nothing
+
     void updatePackageStatus(const std::vector<RaceHandle>& handles, PackageStatus status);
+    // Posts the actions found in the spool when it was opened
+    void replaySpool();
+    // Drops an action's content from the spool once it no longer needs posting
+    void unspool(const ActionContent& content);
+    MastodonClient::ImageSource imageSource(const ActionImage& image) const;
+    // Reports the outcome of a post, keeping the content queued and retrying it on failure
+    ComponentStatus finishPost(const std::vector<RaceHandle>& handles, uint64_t actionId,
+                               ActionContent content, const PostResult& result,
+                               std::chrono::steady_clock::time_point start);
+    ComponentStatus addToBatch(const std::vector<RaceHandle>& handles, uint64_t actionId,
+                               ActionContent content, std::chrono::steady_clock::time_point start);
+    // Posts the batch as one status
+    ComponentStatus flushBatch();
 };
\ No newline at end of file
@@ -25,6 +25,9 @@ void to_json(nlohmann::json &destJson, const LinkAddress &srcLinkAddress) {
         {"timestamp", srcLinkAddress.timestamp},
         // clang-format on
     };
+    if (!srcLinkAddress.server.empty()) {
+        destJson["server"] = srcLinkAddress.server;
+    }
 }
 
 void from_json(const nlohmann::json &srcJson, LinkAddress &destLinkAddress) {
@@ -33,4 +36,5 @@ void from_json(const nlohmann::json &srcJson, LinkAddress &destLinkAddress) {
     // Optional
     destLinkAddress.maxTries = srcJson.value("maxTries", destLinkAddress.maxTries);
     destLinkAddress.timestamp = srcJson.value("timestamp", destLinkAddress.timestamp);
+    destLinkAddress.server = srcJson.value("server", destLinkAddress.server);
 }
\ No newline at end of file
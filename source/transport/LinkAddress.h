@@ -24,8 +24,11 @@
 struct LinkAddress {
     // Required
     std::string hashtag;
-    int maxTries{120};
+    int maxTries{5};
     double timestamp{-1.0};
+    // Optional, the server the hashtag is posted on. Empty means the server the transport
+    // was configured with.
+    std::string server;
 };
 
 // Enable automatic conversion to/from json
@@ -17,97 +17,95 @@
 
 #include "LinkMap.h"
 
+LinkMap::LinkMap() : links(std::make_shared<const Map>()) {}
+
+template <typename Modify>
+void LinkMap::update(Modify modify) {
+    auto copy = std::make_shared<Map>(*std::atomic_load(&links));
+    modify(*copy);
+    std::atomic_store(&links, Snapshot(std::move(copy)));
+}
+
 /**
  * @brief Retrieves the number of links in the LinkMap.
  * 
- * This method provides a thread-safe way to access the size of the
- * internal links container by using a mutex to ensure synchronization.
+ * This method reads the current snapshot, so it never waits for writers.
  * 
  * @return The number of links currently stored in the LinkMap.
  */
 int LinkMap::size() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return links.size();
+    return static_cast<int>(std::atomic_load(&links)->size());
 }
 
 /**
  * @brief Clears all links from the LinkMap.
  * 
- * This function removes all elements from the internal links container,
- * ensuring that the operation is thread-safe by using a mutex lock.
+ * Snapshots taken before the call keep the links they hold.
  */
 void LinkMap::clear() {
-    std::lock_guard<std::mutex> lock(mutex);
-    links.clear();
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::atomic_store(&links, std::make_shared<const Map>());
 }
 
 /**
  * @brief Adds a new link to the LinkMap.
  * 
- * This method safely adds a shared pointer to a Link object into the internal
- * map of links, using the link's unique identifier as the key. Thread safety
- * is ensured by locking a mutex during the operation.
+ * This method publishes a copy of the map with the link added, using the link's unique
+ * identifier as the key. Writers are serialized by a mutex, readers are not blocked.
  * 
  * @param link A shared pointer to the Link object to be added. The Link object
  *             must have a valid unique identifier accessible via getId().
  */
 void LinkMap::add(const std::shared_ptr<Link> &link) {
-    std::lock_guard<std::mutex> lock(mutex);
-    links[link->getId()] = link;
+    std::lock_guard<std::mutex> lock(writeMutex);
+    update([&link](Map &map) { map[link->getId()] = link; });
 }
 
 /**
  * @brief Retrieves a shared pointer to a Link object associated with the given LinkID.
  * 
- * This method provides thread-safe access to the internal map of links. It locks
- * the mutex to ensure that no other thread can modify the map while the lookup
- * is being performed. If the specified LinkID does not exist in the map, this
- * method will throw a `std::out_of_range` exception.
+ * The lookup runs on the current snapshot and never waits for writers. If the specified LinkID
+ * does not exist in the map, this method will throw a `std::out_of_range` exception.
  * 
  * @param linkId The identifier of the Link to retrieve.
  * @return std::shared_ptr<Link> A shared pointer to the Link object associated with the given LinkID.
  * @throws std::out_of_range If the specified LinkID is not found in the map.
  */
 std::shared_ptr<Link> LinkMap::get(const LinkID &linkId) const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return links.at(linkId);
+    return std::atomic_load(&links)->at(linkId);
 }
 
 /**
- * @brief Retrieves a copy of the internal map of links.
+ * @brief Retrieves the current snapshot of the links.
  * 
- * This method provides thread-safe access to the internal unordered map
- * of links by locking a mutex before returning a copy of the map. The
- * returned map contains associations between LinkID and shared pointers
- * to Link objects.
+ * Nothing is copied: the returned map is immutable and stays valid, unchanged, for as long
+ * as the caller holds it. Links added or removed later appear in later snapshots only.
  * 
- * @return std::unordered_map<LinkID, std::shared_ptr<Link>> 
- *         A copy of the internal map of links.
+ * @return LinkMap::Snapshot The map from LinkID to the shared pointers of the Link objects.
  */
-std::unordered_map<LinkID, std::shared_ptr<Link>> LinkMap::getMap() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return links;
+LinkMap::Snapshot LinkMap::getMap() const {
+    return std::atomic_load(&links);
 }
 
 /**
  * @brief Removes a link from the map by its ID.
  *
- * This function removes the link associated with the given LinkID from the
- * internal map. If the link is found, it is erased from the map and a shared
- * pointer to the removed link is returned. If the link is not found, a null
- * shared pointer is returned.
+ * This function publishes a copy of the map without the link associated with the given
+ * LinkID. If the link is found, a shared pointer to the removed link is returned. If the
+ * link is not found, a null shared pointer is returned and the map is left as it is.
  *
  * @param linkId The ID of the link to be removed.
  * @return std::shared_ptr<Link> A shared pointer to the removed link if it
  *         exists, or a null shared pointer if the link was not found.
  */
 std::shared_ptr<Link> LinkMap::remove(const LinkID &linkId) {
-    std::lock_guard<std::mutex> lock(mutex);
-    std::shared_ptr<Link> value;
-    auto iter = links.find(linkId);
-    if (iter != links.end()) {
-        value = iter->second;
-        links.erase(iter);
+    std::lock_guard<std::mutex> lock(writeMutex);
+    Snapshot current = std::atomic_load(&links);
+    auto iter = current->find(linkId);
+    if (iter == current->end()) {
+        return nullptr;
     }
+    std::shared_ptr<Link> value = iter->second;
+    update([&linkId](Map &map) { map.erase(linkId); });
     return value;
 }
\ No newline at end of file
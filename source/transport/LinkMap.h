@@ -24,18 +24,34 @@
 
 #include "Link.h"
 
+/**
+ * @brief The links of the plugin, published as immutable snapshots.
+ *
+ * Readers atomically load the current snapshot without taking the writers' mutex, and may
+ * iterate it for as long as they hold it while links are added and removed. Writers, which are rare, copy the map,
+ * change the copy and publish it in place of the old one.
+ */
 class LinkMap {
 public:
+    using Map = std::unordered_map<LinkID, std::shared_ptr<Link>>;
+    using Snapshot = std::shared_ptr<const Map>;
+
+    LinkMap();
+
     int size() const;
     void clear();
     void add(const std::shared_ptr<Link> &link);
     std::shared_ptr<Link> get(const LinkID &linkId) const;
-    std::unordered_map<LinkID, std::shared_ptr<Link>> getMap() const;
+    Snapshot getMap() const;
     std::shared_ptr<Link> remove(const LinkID &linkId);
 
 private:
-    mutable std::mutex mutex;
-    std::unordered_map<LinkID, std::shared_ptr<Link>> links;
+    // Publishes a modified copy of the current map, called with writeMutex held
+    template <typename Modify>
+    void update(Modify modify);
+
+    std::mutex writeMutex;  // Serializes writers, readers never take it
+    Snapshot links;         // Only accessed through std::atomic_load and std::atomic_store
 };
 
-#endif  // __COMMS_TWOSIX_TRANSPORT_LINK_MAP_H__
\ No newline at end of file
+#endif  // __COMMS_TWOSIX_TRANSPORT_LINK_MAP_H__
@@ -1,13 +1,14 @@
 #include "MastodonClient.h"
+#include "HtmlText.h"
+#include "StatusJson.h"
 // #include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
 #include "log.h"
+#include <algorithm>
+#include <cctype>
 #include <stdexcept>
-#include <iostream>
+#include <thread>
 #include <curl/curl.h> // For curl_easy_escape
-#include <libxml/HTMLparser.h>
-#include <libxml/xpath.h>
-#include <libxml/HTMLtree.h>
 
 // Callback function to write response data
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
@@ -16,6 +17,21 @@ static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::stri
     return totalSize;
 }
 
+// Callback function to collect response headers, keyed by lower-cased header name
+static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, std::map<std::string, std::string>* headers) {
+    size_t totalSize = size * nitems;
+    std::string line(buffer, totalSize);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        size_t end = line.find_last_not_of(" \t\r\n");
+        (*headers)[name] = (start == std::string::npos || end < start) ? "" : line.substr(start, end - start + 1);
+    }
+    return totalSize;
+}
+
 // Callback function to write binary data
 static size_t WriteBinaryCallback(void* contents, size_t size, size_t nmemb, std::vector<uint8_t>* data) {
     size_t totalSize = size * nmemb;
@@ -25,16 +41,9 @@ static size_t WriteBinaryCallback(void* contents, size_t size, size_t nmemb, std
     }
     
     try {
-        // Reserve additional space if needed
-        if (data->capacity() < data->size() + totalSize) {
-            data->reserve(data->size() + totalSize + 4096); // Reserve extra space
-        }
-        
-        // Use push_back in a loop instead of insert with iterators
+        // Append the whole chunk at once, the vector grows geometrically
         const uint8_t* byteData = static_cast<const uint8_t*>(contents);
-        for (size_t i = 0; i < totalSize; ++i) {
-            data->push_back(byteData[i]);
-        }
+        data->insert(data->end(), byteData, byteData + totalSize);
     } catch (const std::exception& e) {
         // Log error if logging is available
         return 0; // Signal an error to libcurl
@@ -43,21 +52,58 @@ static size_t WriteBinaryCallback(void* contents, size_t size, size_t nmemb, std
     return totalSize;
 }
 
+// Read position in a buffer uploaded as a MIME part with curl_mime_data_cb. The buffer must
+// outlive the transfer, curl frees the source itself when the form is destroyed.
+struct MimeSource {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+
+    static size_t read(char* buffer, size_t size, size_t nitems, void* arg) {
+        MimeSource* source = static_cast<MimeSource*>(arg);
+        size_t count = std::min(size * nitems, source->size - source->offset);
+        std::copy(source->data + source->offset, source->data + source->offset + count, buffer);
+        source->offset += count;
+        return count;
+    }
+
+    static int seek(void* arg, curl_off_t offset, int origin) {
+        MimeSource* source = static_cast<MimeSource*>(arg);
+        if (origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > source->size) {
+            return CURL_SEEKFUNC_CANTSEEK;
+        }
+        source->offset = static_cast<size_t>(offset);
+        return CURL_SEEKFUNC_OK;
+    }
+
+    static void free(void* arg) {
+        delete static_cast<MimeSource*>(arg);
+    }
+};
+
+// Logs one line of a traced request, built in a single allocation
+static void logCurlTrace(const std::string& logPrefix, const char* label, const char* data, size_t size) {
+    std::string line;
+    line.reserve(logPrefix.size() + 24 + size);
+    line.append(logPrefix).append(label).append(data, size);
+    logDebug(line);
+}
+
 // Debug callback function
 static int CurlDebugCallback(CURL* handle, curl_infotype type, char* data, size_t size, void* userptr) {
     // Cast userptr to the logging prefix or context (if needed)
-    std::string* logPrefix = static_cast<std::string*>(userptr);
+    const std::string* logPrefix = static_cast<const std::string*>(userptr);
 
-    // Process the debug information based on its type
+    // Process the debug information based on its type. Bodies are only logged by size.
     switch (type) {
         case CURLINFO_TEXT:
-            logDebug(*logPrefix + "CURL INFO: " + std::string(data, size));
+            logCurlTrace(*logPrefix, "CURL INFO: ", data, size);
             break;
         case CURLINFO_HEADER_IN:
-            logDebug(*logPrefix + "CURL HEADER IN: " + std::string(data, size));
+            logCurlTrace(*logPrefix, "CURL HEADER IN: ", data, size);
             break;
         case CURLINFO_HEADER_OUT:
-            logDebug(*logPrefix + "CURL HEADER OUT: " + std::string(data, size));
+            logCurlTrace(*logPrefix, "CURL HEADER OUT: ", data, size);
             break;
         case CURLINFO_DATA_IN:
             logDebug(*logPrefix + "CURL DATA IN: " + std::to_string(size) + " bytes");
@@ -72,45 +118,48 @@ static int CurlDebugCallback(CURL* handle, curl_infotype type, char* data, size_
     return 0; // Returning 0 indicates success
 }
 
-// Configure CURL to use the debug callback
-void configureCurlDebug(CURL* curl, const std::string& logPrefix) {
-    // Enable verbose mode
+// Trace a request through the debug callback. The prefix is passed to the callback by
+// pointer, so it must outlive the transfer. With a debug callback installed curl writes no
+// verbose output of its own, so nothing needs redirecting.
+static void configureCurlDebug(CURL* curl, const std::string& logPrefix) {
     curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-
-    // Set the debug callback function
     curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, CurlDebugCallback);
-
-    // Pass the log prefix or context to the callback
     curl_easy_setopt(curl, CURLOPT_DEBUGDATA, &logPrefix);
-
-    // Redirect default verbose output to /dev/null to suppress it
-    FILE* devNull = fopen("/dev/null", "w");
-    if (devNull) {
-        curl_easy_setopt(curl, CURLOPT_STDERR, devNull);
-    }
 }
 
-MastodonClient::MastodonClient(const std::string& server, const std::string& accessToken)
-    : serverUrl(server), accessToken(accessToken) {
-    curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize CURL");
-    }
-    initCurl();
+MastodonClient::MastodonClient(const std::string& server, const std::string& accessToken,
+                               IComponentSdkBase* sdk, const MastodonConfig& config,
+                               std::shared_ptr<TimelineState> timelineState,
+                               std::shared_ptr<Metrics> metrics)
+    : serverUrl(server),
+      accessToken(accessToken),
+      statusesUrl(server + "/api/v1/statuses"),
+      mediaV2Url(server + "/api/v2/media"),
+      mediaV1Url(server + "/api/v1/media"),
+      timelineUrlPrefix(server + "/api/v1/timelines/tag/"),
+      authHeaders(createAuthHeader()),
+      formHeaders(curl_slist_append(createAuthHeader(), "Content-Type: application/x-www-form-urlencoded")),
+      sdk(sdk),
+      config(config),
+      metrics(metrics ? std::move(metrics) : std::make_shared<Metrics>()),
+      timelineState(timelineState ? std::move(timelineState) :
+                                    std::make_shared<TimelineState>(sdk, static_cast<size_t>(config.seenIndexMaxBytes))),
+      timelineValidators(static_cast<size_t>(std::max(config.timelineValidatorEntries, 0))),
+      heldImages(static_cast<size_t>(std::max(config.mediaCacheMaxBytes, 0))),
+      uploadWorkers(static_cast<size_t>(config.maxConcurrentUploads)) {
+    instanceLimits.maxCharacters = config.maxStatusCharacters;
 }
 
 MastodonClient::~MastodonClient() {
-    if (curl) {
-        curl_easy_cleanup(curl);
-    }
+    // Stop the stream thread, then finish its deliveries, before the state they use is destroyed
+    stream.reset();
+    streamWorkers.reset();
 }
 
-void MastodonClient::initCurl() {
-    // Set common CURL options
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    // curl_easy_setopt(curl, CURLOPT_CAINFO, "/etc/ssl/certs/ca-certificates.crt"); // Set CA certificate path
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Enable verbose logging
+CurlPool::Handle MastodonClient::acquireCurl(const std::string& url, const std::string& logPrefix) {
+    CurlPool::Handle curl = curlPool.acquire();
+    setCommonCurlOptions(curl, url, logPrefix);
+    return curl;
 }
 
 void MastodonClient::setCommonCurlOptions(CURL* curl, const std::string& url, const std::string& logPrefix) {
@@ -119,405 +168,1036 @@ void MastodonClient::setCommonCurlOptions(CURL* curl, const std::string& url, co
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
     curl_easy_setopt(curl, CURLOPT_CAINFO, "/etc/ssl/certs/ca-certificates.crt");
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L); // 30-second timeout
-    configureCurlDebug(curl, logPrefix); // Set debug callback
-}
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L); // Keep pooled connections warm
 
-bool MastodonClient::postStatus(const std::string& content, const std::string& hashtag) {
-    std::string url = serverUrl + "/api/v1/statuses";
-    std::string body = "status=" + content + " " + hashtag + "&visibility=public";
-
-    CURL* postCurl = curl_easy_init();
-    if (!postCurl) {
-        logError("MastodonClient::postStatus: Failed to initialize CURL");
-        return false;
+    // Tracing is off unless configured, and then only one request in curlTraceSampleEvery
+    // is traced. Pooled handles are reset between requests, so the choice is per request.
+    int sampleEvery = config.curlTraceSampleEvery;
+    if (sampleEvery > 0 && traceCounter.fetch_add(1, std::memory_order_relaxed) % sampleEvery == 0) {
+        configureCurlDebug(curl, logPrefix);
     }
+}
 
-    setCommonCurlOptions(postCurl, url, "MastodonClient::postStatus: ");
-
-    // Add Authorization and Content-Type headers
-    struct curl_slist* headers = createAuthHeader();
-    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-    curl_easy_setopt(postCurl, CURLOPT_HTTPHEADER, headers);
+// Timeouts, dropped connections and server overload are worth retrying, anything else is not
+static bool isRetryable(CURLcode code) {
+    switch (code) {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+        case CURLE_SSL_CONNECT_ERROR:
+            return true;
+        default:
+            return false;
+    }
+}
 
-    // Set POST options
-    curl_easy_setopt(postCurl, CURLOPT_POST, 1L);
-    curl_easy_setopt(postCurl, CURLOPT_POSTFIELDS, body.c_str());
+static bool isRetryable(long httpCode) {
+    return httpCode == 408 || httpCode == 429 || httpCode >= 500;
+}
 
-    // Perform the request
-    CURLcode res = curl_easy_perform(postCurl);
+PostResult MastodonClient::postStatus(std::string_view content, const std::string& hashtag) {
+    return createStatus(content, hashtag, {});
+}
 
-    // Clean up
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(postCurl);
+PostResult MastodonClient::postImage(const std::vector<uint8_t>& imageData, const std::string& hashtag) {
+    return postImageWithText(imageData, "", hashtag);
+}
 
-    if (res != CURLE_OK) {
-        logError("MastodonClient::postStatus: CURL error: " + std::string(curl_easy_strerror(res)));
-        return false;
+PostResult MastodonClient::postImageWithText(const std::vector<uint8_t>& imageData, std::string_view text, const std::string& hashtag) {
+    PostResult media = uploadMedia(imageData);
+    if (!media.success) {
+        return media;
     }
+    return createStatus(text, hashtag, {media.id});
+}
 
-    return true;
+std::shared_future<PostResult> MastodonClient::uploadMediaAsync(std::shared_ptr<const std::vector<uint8_t>> imageData) {
+    return uploadMediaAsync([imageData] { return imageData; });
 }
 
-bool MastodonClient::postImage(const std::vector<uint8_t>& imageData, const std::string& hashtag) {
-    std::string mediaUrl = serverUrl + "/api/v1/media";
-    std::string mediaId;
+std::shared_future<PostResult> MastodonClient::uploadMediaAsync(ImageSource loadImage) {
+    auto promise = std::make_shared<std::promise<PostResult>>();
+    std::shared_future<PostResult> media = promise->get_future().share();
+
+    // Every upload gets its own strand, uploads are independent of each other
+    uploadWorkers.post("upload-" + std::to_string(nextUploadId++), [this, promise, loadImage] {
+        PostResult result;
+        try {
+            std::shared_ptr<const std::vector<uint8_t>> imageData = loadImage();
+            if (imageData) {
+                result = uploadMedia(*imageData);
+            }
+        } catch (std::exception& e) {
+            logError("MastodonClient::uploadMediaAsync: " + std::string(e.what()));
+        } catch (...) {
+            // The promise is set whatever failed, a post waits on it
+            logError("MastodonClient::uploadMediaAsync: unknown exception");
+        }
+        promise->set_value(result);
+    });
+    return media;
+}
 
-    CURL* postCurl = curl_easy_init();
-    if (!postCurl) {
-        logError("MastodonClient::postImage: Failed to initialize CURL");
-        return false;
+// Interval between checks on an attachment the server is still processing
+static const std::chrono::milliseconds mediaPollInterval{500};
+
+PostResult MastodonClient::uploadMedia(const std::vector<uint8_t>& imageData) {
+    const std::string logPrefix = "MastodonClient::uploadMedia: ";
+    PostResult result;
+
+    // The v2 endpoint returns before the server has finished processing the attachment.
+    // Servers that predate it get the synchronous v1 endpoint instead.
+    std::string mediaResponse;
+    long httpCode = 0;
+    try {
+        httpCode = sendMedia(mediaV2Url, imageData, mediaResponse);
+        if (httpCode == 404) {
+            mediaResponse.clear();
+            httpCode = sendMedia(mediaV1Url, imageData, mediaResponse);
+        }
+    } catch (curl_exception& e) {
+        logError(logPrefix + "CURL error during media upload: " + std::string(e.what()));
+        result.retryable = isRetryable(e.getCode());
+        return result;
+    }
+    if (httpCode != 200 && httpCode != 202) {
+        logError(logPrefix + "Media upload failed with HTTP status " + std::to_string(httpCode));
+        result.retryable = isRetryable(httpCode);
+        return result;
+    }
+
+    // Parse media response to get media ID
+    bool processing = httpCode == 202;
+    try {
+        auto mediaJson = nlohmann::json::parse(mediaResponse);
+        if (mediaJson.contains("id")) {
+            result.id = mediaJson["id"].get<std::string>();
+        } else {
+            logError(logPrefix + "Media upload failed: no ID in response");
+            return result;
+        }
+        processing = processing || !mediaJson.contains("url") || mediaJson["url"].is_null();
+    } catch (const std::exception& e) {
+        logError(logPrefix + "Error parsing media response: " + std::string(e.what()));
+        return result;
+    }
+
+    if (processing && !waitForMedia(result.id, result.retryable)) {
+        result.id.clear();
+        return result;
     }
+    result.success = true;
+    return result;
+}
 
-    setCommonCurlOptions(postCurl, mediaUrl, "MastodonClient::postImage: ");
+long MastodonClient::sendMedia(const std::string& url, const std::vector<uint8_t>& imageData, std::string& response) {
+    const std::string logPrefix = "MastodonClient::sendMedia: ";
+    CurlPool::Handle mediaCurl = acquireCurl(url, logPrefix);
 
-    // Create multipart form data
-    curl_mime* mime = curl_mime_init(postCurl);
+    // Create multipart form data for image upload
+    curl_mime* mime = mediaCurl->createForm();
     curl_mimepart* part = curl_mime_addpart(mime);
-    curl_mime_data(part, reinterpret_cast<const char*>(imageData.data()), imageData.size());
+    // Stream the part straight from the caller's buffer instead of letting curl copy it
+    MimeSource* source = new MimeSource{imageData.data(), imageData.size(), 0};
+    curl_mime_data_cb(part, static_cast<curl_off_t>(imageData.size()), MimeSource::read,
+                      MimeSource::seek, MimeSource::free, source);
     curl_mime_name(part, "file");
     curl_mime_filename(part, "image.jpg");
     curl_mime_type(part, "image/jpeg");
 
     // Add Authorization header
-    struct curl_slist* headers = createAuthHeader();
-    curl_easy_setopt(postCurl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(postCurl, CURLOPT_MIMEPOST, mime);
+    mediaCurl->setSharedHeaders(authHeaders.get());
 
-    // Perform the request
-    std::string mediaResponse;
-    curl_easy_setopt(postCurl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(postCurl, CURLOPT_WRITEDATA, &mediaResponse);
+    // Capture media upload response
+    mediaCurl->setopt(CURLOPT_WRITEFUNCTION, WriteCallback);
+    mediaCurl->setopt(CURLOPT_WRITEDATA, &response);
 
-    CURLcode res = curl_easy_perform(postCurl);
+    return performTracked(mediaCurl, RateLimiter::MEDIA, Metrics::UPLOAD_MEDIA);
+}
 
-    // Clean up
-    curl_mime_free(mime);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(postCurl);
+bool MastodonClient::waitForMedia(const std::string& mediaId, bool& retryable) {
+    const std::string logPrefix = "MastodonClient::waitForMedia: ";
+    std::string url = mediaV1Url + "/" + mediaId;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(config.mediaProcessingTimeoutSeconds);
+
+    // The server answers 206 while the attachment is processing and 200 once it can be attached
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(mediaPollInterval);
+        try {
+            CurlPool::Handle pollCurl = acquireCurl(url, logPrefix);
+            pollCurl->setopt(CURLOPT_HTTPGET, 1L);
+            pollCurl->setSharedHeaders(authHeaders.get());
+            std::string response;
+            pollCurl->setopt(CURLOPT_WRITEFUNCTION, WriteCallback);
+            pollCurl->setopt(CURLOPT_WRITEDATA, &response);
+            long httpCode = performTracked(pollCurl, RateLimiter::MEDIA, Metrics::POLL_MEDIA);
+            if (httpCode == 200) {
+                return true;
+            } else if (httpCode != 206) {
+                logError(logPrefix + "unexpected HTTP status " + std::to_string(httpCode) + " for media " + mediaId);
+                retryable = isRetryable(httpCode);
+                return false;
+            }
+        } catch (curl_exception& e) {
+            logError(logPrefix + "CURL error: " + std::string(e.what()));
+            retryable = isRetryable(e.getCode());
+            return false;
+        }
+    }
 
-    if (res != CURLE_OK) {
-        logError("MastodonClient::postImage: CURL error: " + std::string(curl_easy_strerror(res)));
-        return false;
+    // A busy server may still finish processing a fresh upload
+    logError(logPrefix + "timed out waiting for media " + mediaId + " to be processed");
+    retryable = true;
+    return false;
+}
+
+PostResult MastodonClient::createStatus(std::string_view text, const std::string& hashtag, const std::vector<std::string>& mediaIds) {
+    const std::string logPrefix = "MastodonClient::createStatus: ";
+    PostResult result;
+
+    // Create a status with any media attachments. The status request reuses a pooled
+    // connection to the server. The body and response are built in buffers kept by the
+    // thread, so once they have grown to the size of a status posting allocates nothing.
+    thread_local std::string statusBody;
+    thread_local std::string response;
+    statusBody.clear();
+    response.clear();
+    statusBody.reserve(text.size() + hashtag.size() + 32 + 24 * mediaIds.size());
+    statusBody.append("status=");
+    if (!text.empty()) {
+        statusBody.append(text).append(" ");
+    }
+    statusBody.append(hashtag).append("&visibility=public");
+    for (const auto& mediaId : mediaIds) {
+        statusBody.append("&media_ids[]=").append(mediaId);
     }
 
-    // Parse media response to get media ID
+    // The status may reach the stream before its ID reaches us
+    timelineState->beginOwnPost(hashtag, text, mediaIds.size());
     try {
-        auto mediaJson = nlohmann::json::parse(mediaResponse);
-        if (mediaJson.contains("id")) {
-            mediaId = mediaJson["id"].get<std::string>();
-        } else {
-            logError("MastodonClient::postImage: Media upload failed: no ID in response");
-            return false;
+        CurlPool::Handle statusCurl = acquireCurl(statusesUrl, logPrefix);
+
+        // Add Authorization and Content-Type headers
+        statusCurl->setSharedHeaders(formHeaders.get());
+
+        // Set POST options
+        statusCurl->setopt(CURLOPT_POST, 1L);
+        statusCurl->setopt(CURLOPT_POSTFIELDS, statusBody.c_str());
+        statusCurl->setopt(CURLOPT_WRITEFUNCTION, WriteCallback);
+        statusCurl->setopt(CURLOPT_WRITEDATA, &response);
+
+        long httpCode = performTracked(statusCurl, RateLimiter::STATUSES, Metrics::POST_STATUS);
+        if (httpCode != 200) {
+            logError(logPrefix + "Status post failed with HTTP status " + std::to_string(httpCode));
+            result.retryable = isRetryable(httpCode);
+            timelineState->endOwnPost(hashtag, text, mediaIds.size(), result.id);
+            return result;
         }
+    } catch (curl_exception& e) {
+        logError(logPrefix + "CURL error during status post: " + std::string(e.what()));
+        result.retryable = isRetryable(e.getCode());
+        timelineState->endOwnPost(hashtag, text, mediaIds.size(), result.id);
+        return result;
+    }
+
+    result.success = true;
+    try {
+        result.id = nlohmann::json::parse(response).value("id", "");
     } catch (const std::exception& e) {
-        logError("MastodonClient::postImage: Error parsing media response: " + std::string(e.what()));
-        return false;
+        logWarning(logPrefix + "Error parsing status response: " + std::string(e.what()));
     }
+    timelineState->endOwnPost(hashtag, text, mediaIds.size(), result.id);
+    return result;
+}
 
-    // Use mediaId to post the status (similar to postStatus)
-    
-    std::string statusUrl = serverUrl + "/api/v1/statuses";
-    std::string statusBody = "status=" + hashtag + "&visibility=public&media_ids[]=" + mediaId;    
+// Convert status HTML to text, using libxml2 only for markup the single-pass extractor rejects
+static std::string statusHtmlToText(const std::string& html) {
+    std::string text;
+    if (extractStatusText(html, text)) {
+        return text;
+    }
+    LOG_DEBUG("MastodonClient::statusHtmlToText: falling back to libxml2");
+    return stripHtmlWithLibxml2(html);
+}
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        logError("MastodonClient::postStatus: Failed to initialize CURL");
-        return false;
+// A status from a timeline page whose attachments are still to be downloaded
+struct MastodonClient::PendingStatus {
+    std::string id;
+    uint64_t numericId = 0;
+    std::vector<ImageAttachment> images;
+    std::vector<size_t> imageSlots;  // Indices into the batch of image downloads
+    std::string text;
+    bool hasText = false;
+    bool alreadySeen = false;  // Delivered before, only kept so the cursor can move past it
+    bool heldBack = false;     // May be a post of ours still waiting for its ID, fetched again later
+};
+
+// Mastodon returns at most 40 statuses per page of a tag timeline
+static const int timelinePageLimit = 40;
+
+// Status IDs are 64-bit snowflakes serialized as decimal strings. Returns 0 if the ID is not numeric.
+static uint64_t parseStatusId(const std::string& id) {
+    if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos) {
+        return 0;
     }
+    try {
+        return std::stoull(id);
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
 
-    setCommonCurlOptions(curl, statusUrl, "MastodonClient::postStatus: ");
+// Extract the URL for the given relation (e.g. "prev") from an RFC 8288 Link header
+static std::string parseLinkHeader(const std::string& header, const std::string& rel) {
+    const std::string relParam = "rel=\"" + rel + "\"";
+    size_t pos = 0;
+    while ((pos = header.find('<', pos)) != std::string::npos) {
+        size_t end = header.find('>', pos);
+        if (end == std::string::npos) {
+            break;
+        }
+        size_t next = header.find('<', end);
+        std::string params = header.substr(end + 1, next == std::string::npos ? std::string::npos : next - end - 1);
+        if (params.find(relParam) != std::string::npos) {
+            return header.substr(pos + 1, end - pos - 1);
+        }
+        pos = end;
+    }
+    return "";
+}
 
-    // Add Authorization and Content-Type headers
-    struct curl_slist* statusHeaders = createAuthHeader();
-    statusHeaders = curl_slist_append(statusHeaders, "Content-Type: application/x-www-form-urlencoded");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, statusHeaders);
+std::vector<MastodonContent> MastodonClient::searchStatuses(const std::string& hashtag) {
+    return std::move(searchStatusesBatch({hashtag}).front());
+}
 
-    // Set POST options
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, statusBody.c_str());
+// State of one hashtag while a batch of timelines is being read
+struct MastodonClient::TimelineQuery {
+    std::string hashtag;
+    uint64_t cursor = 0;
+    std::string url;  // Next page to request, empty once the timeline is exhausted
+    std::vector<PendingStatus> pendingStatuses;
+    bool advanceCursor = true;
+    bool complete = true;          // Every page was read and every status was delivered
+    // The URL and validators of each page read, remembered once the query is complete
+    std::vector<std::pair<std::string, ValidatorCache::Validators>> pageValidators;
+    uint64_t streamGeneration = 0; // Stream connection live when the search began, 0 if none
+};
+
+std::vector<std::vector<MastodonContent>> MastodonClient::searchStatusesBatch(const std::vector<std::string>& hashtags) {
+    std::vector<std::vector<MastodonContent>> results(hashtags.size());
+    std::vector<TimelineQuery> queries(hashtags.size());
+
+    for (size_t i = 0; i < hashtags.size(); ++i) {
+        TimelineQuery& query = queries[i];
+        query.hashtag = hashtags[i];
+
+        // Validate the hashtag parameter
+        if (query.hashtag.empty()) {
+            logError("MastodonClient::searchStatusesBatch: Hashtag parameter is empty.");
+            continue;
+        }
 
-    // Perform the request
-    CURLcode statusRes = curl_easy_perform(curl);
+        query.url = timelineUrl(query.hashtag);
+        if (query.url.empty()) {
+            logError("MastodonClient::searchStatusesBatch: Failed to URL-encode the hashtag.");
+            continue;
+        }
 
-    // Clean up
-    curl_slist_free_all(statusHeaders);
-    curl_easy_cleanup(curl);
+        // Without a cursor only the newest page is read so that older history is not replayed.
+        // With a cursor, min_id returns the statuses immediately after it and the "prev" Link
+        // relation walks forward through any newer pages.
+        query.cursor = timelineState->getCursor(query.hashtag);
+        if (stream) {
+            // Statuses posted after this point reach us through the stream if it stays up
+            stream->isLive(query.hashtag, query.streamGeneration);
+        }
+        if (query.cursor == 0) {
+            query.url += "&limit=20";
+        } else {
+            query.url += "&limit=" + std::to_string(timelinePageLimit) + "&min_id=" + std::to_string(query.cursor);
+        }
+    }
 
-    if (statusRes != CURLE_OK) {
-        logError("MastodonClient::postStatus: CURL error: " + std::string(curl_easy_strerror(statusRes)));
-        return false;
+    // Read every timeline in parallel, one round per page depth
+    for (int page = 0; page < config.maxTimelinePages; ++page) {
+        std::vector<TimelineQuery*> active;
+        std::vector<std::string> urls;
+        for (auto& query : queries) {
+            if (!query.url.empty()) {
+                LOG_DEBUG("MastodonClient::searchStatusesBatch: Searching for hashtag: " + query.url);
+                active.push_back(&query);
+                urls.push_back(query.url);
+            }
+        }
+        if (active.empty()) {
+            break;
+        }
+
+        std::vector<TimelinePage> pages = fetchTimelinePages(urls);
+        for (size_t i = 0; i < active.size(); ++i) {
+            TimelineQuery& query = *active[i];
+            std::string url = std::move(query.url);
+            query.url.clear();
+            if (!pages[i].ok) {
+                query.complete = false;
+                continue;
+            }
+            if (pages[i].notModified) {
+                // Nothing new since the same request last returned a complete page
+                continue;
+            }
+            query.pageValidators.emplace_back(std::move(url), std::move(pages[i].validators));
+
+            size_t pageSize = parseTimelinePage(query.hashtag, pages[i].body, query.pendingStatuses);
+            if (query.cursor != 0 && pageSize >= static_cast<size_t>(timelinePageLimit)) {
+                query.url = pages[i].prevUrl;
+            }
+        }
     }
 
-    return true;
+    // Deliver in chronological order regardless of the order pages list statuses in, and
+    // download the attachments of every timeline as a single batch
+    std::vector<ImageAttachment> attachments;
+    for (auto& query : queries) {
+        std::stable_sort(query.pendingStatuses.begin(), query.pendingStatuses.end(),
+                         [](const PendingStatus& lhs, const PendingStatus& rhs) {
+                             return lhs.numericId < rhs.numericId;
+                         });
+        for (auto& pending : query.pendingStatuses) {
+            for (auto& image : pending.images) {
+                pending.imageSlots.push_back(attachments.size());
+                attachments.push_back(image);
+            }
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> images = loadImages(attachments);
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        TimelineQuery& query = queries[i];
+        if (!query.url.empty()) {
+            // Stopped at maxTimelinePages with newer pages still unread
+            query.complete = false;
+        }
+        results[i] = assembleTimeline(query, images);
+
+        // A page that was not fully delivered must be read again in full, so only the
+        // validators of complete queries are kept
+        for (auto& page : query.pageValidators) {
+            if (query.complete) {
+                timelineValidators.put(page.first, std::move(page.second));
+            } else {
+                timelineValidators.erase(page.first);
+            }
+        }
+
+        if (query.complete && query.streamGeneration != 0) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            polledGenerations[query.hashtag] = query.streamGeneration;
+        }
+    }
+    return results;
 }
 
-bool MastodonClient::postImageWithText(const std::vector<uint8_t>& imageData, const std::string& text, const std::string& hashtag) {
-    // First, upload the media to get a media ID
-    std::string mediaUrl = serverUrl + "/api/v1/media";
-    std::string mediaId;
-    
-    // Create multipart form data for image upload
-    curl_mime *mime = curl_mime_init(curl);
-    curl_mimepart *part = curl_mime_addpart(mime);
-    
-    // Set the image data
-    curl_mime_data(part, reinterpret_cast<const char*>(imageData.data()), imageData.size());
-    curl_mime_name(part, "file");
-    curl_mime_filename(part, "image.jpg");
-    curl_mime_type(part, "image/jpeg");
-    
-    // Authorization header for media upload
-    std::string authHeader = "Authorization: Bearer " + accessToken;
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, authHeader.c_str());
-    
-    // Capture media upload response
-    std::string mediaResponse;
-    curl_easy_setopt(curl, CURLOPT_URL, mediaUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &mediaResponse);
-    
-    CURLcode res = curl_easy_perform(curl);
-    
-    // Clean up mime and headers
-    curl_mime_free(mime);
-    curl_slist_free_all(headers);
-    
-    if (res != CURLE_OK) {
-        std::cerr << "CURL error during media upload: " << curl_easy_strerror(res) << std::endl;
-        return false;
+std::vector<MastodonContent> MastodonClient::assembleTimeline(TimelineQuery& query,
+                                                              std::vector<std::vector<uint8_t>>& images) {
+    std::vector<MastodonContent> results;
+
+    // Assemble results in status order. The cursor only advances over a contiguous run of
+    // delivered statuses so that a held back status is fetched again on the next poll.
+    uint64_t newCursor = query.cursor;
+    bool advanceCursor = query.advanceCursor;
+    for (auto& pending : query.pendingStatuses) {
+        if (pending.alreadySeen) {
+            if (advanceCursor && pending.numericId > newCursor) {
+                newCursor = pending.numericId;
+            }
+            continue;
+        }
+        if (pending.heldBack) {
+            advanceCursor = false;
+            query.complete = false;
+            continue;
+        }
+
+        // Deliver a status only once all of its attachments are available, otherwise leave it
+        // unseen so the whole status is retried on the next poll
+        bool complete = true;
+        for (size_t slot : pending.imageSlots) {
+            if (images[slot].empty()) {
+                logWarning("MastodonClient::searchStatuses: image download failed for status " + pending.id + ", will retry");
+                complete = false;
+                break;
+            }
+        }
+        if (!complete) {
+            // Keep what did download so that the retry only fetches the missing attachments
+            for (size_t k = 0; k < pending.imageSlots.size(); ++k) {
+                if (!images[pending.imageSlots[k]].empty()) {
+                    heldImages.put(pending.images[k].id, std::move(images[pending.imageSlots[k]]));
+                }
+            }
+            advanceCursor = false;
+            query.complete = false;
+            continue;
+        }
+
+        // Claim the status before delivering it, the stream and a poll may both have found it
+        bool claimed = timelineState->markSeen(query.hashtag, pending.id);
+        metrics->recordDedup(!claimed);
+        if (!claimed) {
+            if (advanceCursor && pending.numericId > newCursor) {
+                newCursor = pending.numericId;
+            }
+            continue;
+        }
+
+        for (size_t slot : pending.imageSlots) {
+            // Store image data directly as raw bytes
+            MastodonContent content;
+            content.contentType = "image/jpeg";
+            content.data = std::move(images[slot]);
+            LOG_DEBUG("MastodonClient::searchStatuses: Downloaded image, size: " + std::to_string(content.data.size()));
+            results.push_back(std::move(content));
+        }
+
+        if (pending.hasText) {
+            MastodonContent content;
+            content.contentType = "text/plain";
+            content.data = std::vector<uint8_t>(pending.text.begin(), pending.text.end());
+            results.push_back(std::move(content));
+        }
+
+        if (advanceCursor && pending.numericId > newCursor) {
+            newCursor = pending.numericId;
+        }
     }
-    
-    // Parse media response to get media ID
+
+    if (newCursor != query.cursor) {
+        timelineState->saveCursor(query.hashtag, newCursor);
+    }
+
+    return results;
+}
+
+std::vector<MastodonClient::TimelinePage> MastodonClient::fetchTimelinePages(const std::vector<std::string>& urls) {
+    const std::string logPrefix = "MastodonClient::fetchTimelinePages: ";
+    std::vector<TimelinePage> pages(urls.size());
+    std::vector<std::map<std::string, std::string>> responseHeaders(urls.size());
+    std::vector<CurlPool::Handle> handles;
+    std::vector<CURL*> easyHandles;
+    handles.reserve(urls.size());
+    easyHandles.reserve(urls.size());
+
     try {
-        auto mediaJson = nlohmann::json::parse(mediaResponse);
-        if (mediaJson.contains("id")) {
-            mediaId = mediaJson["id"].get<std::string>();
-        } else {
-            std::cerr << "Media upload failed: no ID in response" << std::endl;
-            return false;
+        for (size_t i = 0; i < urls.size(); ++i) {
+            rateLimiter.acquire(RateLimiter::TIMELINES);
+            handles.push_back(acquireCurl(urls[i], logPrefix));
+            CurlPool::Handle& searchCurl = handles.back();
+            searchCurl->setopt(CURLOPT_HTTPGET, 1L);
+            ValidatorCache::Validators validators;
+            if (timelineValidators.get(urls[i], validators)) {
+                struct curl_slist* headers = createAuthHeader();
+                if (!validators.etag.empty()) {
+                    headers = curl_slist_append(headers, ("If-None-Match: " + validators.etag).c_str());
+                }
+                if (!validators.lastModified.empty()) {
+                    headers = curl_slist_append(headers, ("If-Modified-Since: " + validators.lastModified).c_str());
+                }
+                searchCurl->setHeaders(headers);
+            } else {
+                searchCurl->setSharedHeaders(authHeaders.get());
+            }
+            searchCurl->setopt(CURLOPT_WRITEFUNCTION, WriteCallback);
+            searchCurl->setopt(CURLOPT_WRITEDATA, &pages[i].body);
+            searchCurl->setopt(CURLOPT_HEADERFUNCTION, HeaderCallback);
+            searchCurl->setopt(CURLOPT_HEADERDATA, &responseHeaders[i]);
+            searchCurl->setopt(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            searchCurl->setopt(CURLOPT_PIPEWAIT, 1L);
+            easyHandles.push_back(searchCurl);
+        }
+
+        CurlMulti multi;
+        std::vector<CURLcode> codes = multi.performAll(easyHandles, config.maxConcurrentTimelineRequests);
+        for (size_t i = 0; i < codes.size(); ++i) {
+            if (codes[i] != CURLE_OK) {
+                logError(logPrefix + "CURL error for " + urls[i] + ": " + std::string(curl_easy_strerror(codes[i])));
+                recordRequest(Metrics::FETCH_TIMELINE, handles[i], codes[i], 0);
+                continue;
+            }
+
+            long httpCode = handles[i]->getinfo<long>(CURLINFO_RESPONSE_CODE);
+            recordRequest(Metrics::FETCH_TIMELINE, handles[i], codes[i], httpCode);
+            rateLimiter.update(RateLimiter::TIMELINES, responseHeaders[i], httpCode);
+            if (httpCode == 304) {
+                pages[i].ok = true;
+                pages[i].notModified = true;
+                continue;
+            }
+            if (httpCode != 200) {
+                logError(logPrefix + "unexpected HTTP status " + std::to_string(httpCode) + " for " + urls[i]);
+                continue;
+            }
+
+            pages[i].ok = true;
+            auto link = responseHeaders[i].find("link");
+            if (link != responseHeaders[i].end()) {
+                pages[i].prevUrl = parseLinkHeader(link->second, "prev");
+            }
+            auto etag = responseHeaders[i].find("etag");
+            if (etag != responseHeaders[i].end()) {
+                pages[i].validators.etag = etag->second;
+            }
+            auto lastModified = responseHeaders[i].find("last-modified");
+            if (lastModified != responseHeaders[i].end()) {
+                pages[i].validators.lastModified = lastModified->second;
+            }
+        }
+    } catch (curl_exception& e) {
+        logError(logPrefix + "CURL error: " + std::string(e.what()));
+        for (auto& page : pages) {
+            page.ok = false;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing media upload response: " << e.what() << std::endl;
-        return false;
     }
-    
-    // Now create a status with both text and media attachment
-    std::string statusUrl = serverUrl + "/api/v1/statuses";
-    std::string statusBody = "status=" + text + " " + hashtag + "&visibility=public&media_ids[]=" + mediaId;
-    
-    // Create headers for status post
-    headers = nullptr;
-    headers = curl_slist_append(headers, authHeader.c_str());
-    headers = curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-    
-    // Reset curl options for status post
-    curl_easy_reset(curl);
-    curl_easy_setopt(curl, CURLOPT_URL, statusUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, statusBody.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_CAINFO, "/etc/ssl/certs/ca-certificates.crt");
-    
-    // Perform the status post request
-    res = curl_easy_perform(curl);
-    
-    // Clean up headers
-    curl_slist_free_all(headers);
-    
-    // Reinitialize curl for future use
-    initCurl();
-    
-    if (res != CURLE_OK) {
-        std::cerr << "CURL error during status post: " << curl_easy_strerror(res) << std::endl;
-        return false;
+
+    return pages;
+}
+
+size_t MastodonClient::parseTimelinePage(const std::string& hashtag,
+                                         const std::string& responseString,
+                                         std::vector<PendingStatus>& pendingStatuses) {
+    // Parse the JSON response, keeping only the fields of each status that are used
+    LOG_DEBUG("MastodonClient::parseTimelinePage: parsing response");
+    std::vector<StatusFields> statuses;
+    if (!parseTimelineJson(responseString, statuses)) {
+        logError("MastodonClient::parseTimelinePage: Error parsing JSON response");
+        return 0;
     }
-    
-    return true;
+
+    // Image URLs are collected first so that every attachment in the batch can be
+    // downloaded in parallel.
+    try {
+        for (auto& status : statuses) {
+            pendingStatuses.push_back(parseStatus(hashtag, std::move(status)));
+        }
+    } catch (const std::exception& e) {
+        logError("MastodonClient::parseTimelinePage: Error parsing status: " + std::string(e.what()));
+    }
+
+    return statuses.size();
 }
 
-// Helper function to strip HTML tags using libxml2
-std::string stripHtmlWithLibxml2(const std::string& html) {
-    // Parse the HTML content
-    htmlDocPtr doc = htmlReadMemory(html.c_str(), html.size(), NULL, NULL, HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
-    if (!doc) {
-        throw std::runtime_error("Failed to parse HTML content");
+// Extract the attachment URLs and text of one status, from a timeline page or a stream event
+MastodonClient::PendingStatus MastodonClient::parseStatus(const std::string& hashtag, StatusFields&& status) {
+    LOG_DEBUG("MastodonClient::parseStatus: parsing status");
+    PendingStatus pending;
+    pending.id = std::move(status.id);
+    pending.numericId = parseStatusId(pending.id);
+
+    // Skip statuses that were already delivered before doing any network work for them
+    if (timelineState->isSeen(hashtag, pending.id)) {
+        LOG_DEBUG("MastodonClient::parseStatus: skipping status " + pending.id + " because it was already seen");
+        metrics->recordDedup(true);
+        pending.alreadySeen = true;
+        return pending;
     }
 
-    // Extract plain text
-    xmlChar* plainText = xmlNodeGetContent(xmlDocGetRootElement(doc));
-    std::string result;
-    if (plainText) {
-        result = reinterpret_cast<const char*>(plainText);
-        xmlFree(plainText);
+    // Our own posts come back on every fetch of the hashtag. They are recognized by the ID the
+    // server returned, before their text is extracted.
+    if (timelineState->isOwnPost(hashtag, pending.id)) {
+        LOG_DEBUG("MastodonClient::parseStatus: skipping status " + pending.id + " because we posted it");
+        metrics->recordEcho();
+        timelineState->markSeen(hashtag, pending.id);
+        pending.alreadySeen = true;
+        return pending;
     }
 
-    // Free the document
-    xmlFreeDoc(doc);
-    return result;
+    // Image attachments
+    pending.images = std::move(status.images);
+
+    // Also process text content if available
+    if (status.hasContent) {
+        // Strip HTML tags and decode entities
+        std::string plainTextContent = statusHtmlToText(status.content);
+
+        // Remove the hashtag from text content
+        size_t pos = plainTextContent.find(" " + hashtag);
+        if (pos != std::string::npos) {
+            plainTextContent = plainTextContent.substr(0, pos);
+        }
+
+        // Only add non-empty text content
+        if (!plainTextContent.empty() && plainTextContent != hashtag) {
+            pending.text = std::move(plainTextContent);
+            pending.hasText = true;
+        }
+    }
+
+    // A post of ours with the same text and images has not been answered yet, so this may be
+    // it. Whether it is is known by the time it is fetched again.
+    if (timelineState->isOwnPostInFlight(hashtag, pending.text, pending.images.size())) {
+        LOG_DEBUG("MastodonClient::parseStatus: holding back status " + pending.id + " while our post is in flight");
+        pending.images.clear();
+        pending.text.clear();
+        pending.hasText = false;
+        pending.heldBack = true;
+    }
+
+    return pending;
 }
 
-std::vector<MastodonContent> MastodonClient::searchStatuses(const std::string& hashtag) {
-    std::vector<MastodonContent> results;
+void MastodonClient::retainOwnPosts(const std::string& hashtag) {
+    timelineState->retainOwnPosts(hashtag);
+}
 
-    // Validate the hashtag parameter
-    if (hashtag.empty()) {
-        std::cerr << "Error: Hashtag parameter is empty." << std::endl;
-        return results;
+void MastodonClient::releaseOwnPosts(const std::string& hashtag) {
+    timelineState->releaseOwnPosts(hashtag);
+}
+
+void MastodonClient::startStreaming(StreamCallback callback) {
+    if (stream) {
+        return;
     }
+    streamCallback = std::move(callback);
+    streamWorkers = std::make_unique<WorkerPool>(static_cast<size_t>(std::max(config.workerThreads, 1)));
+    stream = std::make_unique<MastodonStream>(
+        [this](const std::string& hashtag) { return acquireStreamCurl(hashtag); },
+        [this](const std::string& hashtag, const std::string& statusJson) { onStreamStatus(hashtag, statusJson); },
+        config.streamReconnectMaxSeconds);
+}
 
-    // URL-encode the hashtag
-    char* encodedHashtag = curl_easy_escape(curl, hashtag.c_str(), hashtag.length());
-    if (!encodedHashtag) {
-        std::cerr << "Error: Failed to URL-encode the hashtag." << std::endl;
-        return results;
+void MastodonClient::subscribe(const std::string& hashtag) {
+    if (stream) {
+        stream->subscribe(hashtag);
     }
+}
 
-    // Construct the URL with the encoded hashtag
-    std::string url = serverUrl + "/api/v1/timelines/tag/" + encodedHashtag + "?limit=20&local=true";
-    logDebug("MastodonClient::searchStatuses: Searching for hashtag: " + url);
+void MastodonClient::unsubscribe(const std::string& hashtag) {
+    if (stream) {
+        stream->unsubscribe(hashtag);
+    }
+}
 
-    // Free the encoded string after use
-    curl_free(encodedHashtag);
+bool MastodonClient::needsPoll(const std::string& hashtag) const {
+    uint64_t generation = 0;
+    if (!stream || !stream->isLive(hashtag, generation)) {
+        return true;
+    }
 
-    // Create the Authorization header
-    std::string authHeader = "Authorization: Bearer " + accessToken;
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, authHeader.c_str());
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto iter = polledGenerations.find(hashtag);
+    return iter == polledGenerations.end() || iter->second != generation;
+}
 
-    // Set CURL options
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_CAINFO, "/etc/ssl/certs/ca-certificates.crt");
+// Outlives every stream request, which holds a pointer to it for the debug callback
+static const std::string streamLogPrefix = "MastodonClient::stream: ";
 
-    // Capture the response
-    std::string responseString;
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseString);
+CurlPool::Handle MastodonClient::acquireStreamCurl(const std::string& hashtag) {
+    std::string tag = hashtag.rfind("#", 0) == 0 ? hashtag.substr(1) : hashtag;
+    CurlPool::Handle curl = curlPool.acquire();
+    char* encodedTag = curl_easy_escape(curl, tag.c_str(), tag.length());
+    if (!encodedTag) {
+        throw curl_exception(CURLE_OUT_OF_MEMORY);
+    }
+    std::string url = serverUrl + "/api/v1/streaming/hashtag/local?tag=" + encodedTag;
+    curl_free(encodedTag);
+
+    setCommonCurlOptions(curl, url, streamLogPrefix);
+    curl->setopt(CURLOPT_HTTPGET, 1L);
+    curl->setSharedHeaders(authHeaders.get());
+
+    // The request stays open indefinitely. The server sends a heartbeat comment every few
+    // seconds, so a connection that goes quiet for a minute is treated as dropped.
+    curl->setopt(CURLOPT_TIMEOUT, 0L);
+    curl->setopt(CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl->setopt(CURLOPT_LOW_SPEED_TIME, 60L);
+    return curl;
+}
 
-    // Perform the request
-    CURLcode res = curl_easy_perform(curl);
+void MastodonClient::onStreamStatus(const std::string& hashtag, const std::string& statusJson) {
+    const std::string logPrefix = "MastodonClient::onStreamStatus: ";
+    auto pending = std::make_shared<PendingStatus>();
+
+    try {
+        StatusFields status;
+        if (!parseStatusJson(statusJson, status)) {
+            logError(logPrefix + "Error parsing streamed status");
+            return;
+        }
+        *pending = parseStatus(hashtag, std::move(status));
+        if (pending->alreadySeen) {
+            return;
+        }
+    } catch (const std::exception& e) {
+        logError(logPrefix + "Error parsing streamed status: " + std::string(e.what()));
+        return;
+    }
 
-    // Clean up headers
-    curl_slist_free_all(headers);
+    // The stream thread only parses, downloads would stall every streamed hashtag
+    streamWorkers->post("stream " + hashtag,
+                        [this, hashtag, pending] { deliverStreamStatus(hashtag, *pending); });
+}
 
-    if (res != CURLE_OK) {
-        std::cerr << "CURL error: " << curl_easy_strerror(res) << std::endl;
-        return results;
+void MastodonClient::deliverStreamStatus(const std::string& hashtag, PendingStatus& pending) {
+    TimelineQuery query;
+    query.hashtag = hashtag;
+    query.pendingStatuses.push_back(std::move(pending));
+
+    PendingStatus& status = query.pendingStatuses.front();
+    for (size_t i = 0; i < status.images.size(); ++i) {
+        status.imageSlots.push_back(i);
+    }
+    std::vector<std::vector<uint8_t>> images = loadImages(status.images);
+
+    // While the hashtag is caught up nothing older can still be missing, so the cursor may
+    // move past this status. Otherwise the next search would skip what is still unread.
+    query.cursor = timelineState->getCursor(hashtag);
+    query.advanceCursor = !needsPoll(hashtag);
+    std::vector<MastodonContent> results = assembleTimeline(query, images);
+
+    if (!query.complete) {
+        // The status was held back, make the next fetch search for it again
+        std::lock_guard<std::mutex> lock(stateMutex);
+        polledGenerations.erase(hashtag);
+    }
+    if (!results.empty()) {
+        streamCallback(hashtag, std::move(results));
+    }
+}
+
+std::vector<std::vector<uint8_t>> MastodonClient::loadImages(const std::vector<ImageAttachment>& attachments) {
+    std::vector<std::vector<uint8_t>> images(attachments.size());
+    std::vector<std::string> missingUrls;
+    std::vector<size_t> missingSlots;
+    for (size_t i = 0; i < attachments.size(); ++i) {
+        if (heldImages.take(attachments[i].id, images[i])) {
+            metrics->recordMediaCacheHit();
+        } else {
+            missingUrls.push_back(attachments[i].url);
+            missingSlots.push_back(i);
+        }
     }
 
-    // Parse the JSON response
+    std::vector<std::vector<uint8_t>> downloaded = downloadImages(missingUrls);
+    for (size_t i = 0; i < missingSlots.size(); ++i) {
+        images[missingSlots[i]] = std::move(downloaded[i]);
+    }
+    return images;
+}
+
+std::vector<std::vector<uint8_t>> MastodonClient::downloadImages(const std::vector<std::string>& imageUrls) {
+    const std::string logPrefix = "MastodonClient::downloadImages: ";
+    std::vector<std::vector<uint8_t>> images(imageUrls.size());
+    if (imageUrls.empty()) {
+        return images;
+    }
+    LOG_DEBUG(logPrefix + "downloading " + std::to_string(imageUrls.size()) + " images");
+
+    std::vector<CurlPool::Handle> handles;
+    std::vector<CURL*> easyHandles;
+    handles.reserve(imageUrls.size());
+    easyHandles.reserve(imageUrls.size());
+
     try {
-        logDebug("MastodonClient::searchStatuses: parsing response");
-
-        auto jsonResponse = nlohmann::json::parse(responseString);
-
-        // Extract statuses from the JSON response
-        for (const auto& status : jsonResponse) {
-            logDebug("MastodonClient::searchStatuses: parsing status");
-
-            // Check if this status has media attachments (images)
-            if (status.contains("media_attachments") && 
-                status["media_attachments"].is_array() && 
-                !status["media_attachments"].empty()) {
-                    
-                logDebug("MastodonClient::searchStatuses: has attachment");
-                // Process media attachments
-                for (const auto& media : status["media_attachments"]) {
-                    if (media.contains("type") && media["type"].get<std::string>() == "image") {
-                        if (media.contains("url")) {
-                            std::string imageUrl = media["url"].get<std::string>();
-                            logDebug("MastodonClient::searchStatuses: caling downlaod for url: " + imageUrl);
-                    
-                            // Download the image
-                            std::vector<uint8_t> imageData = downloadImage(imageUrl);
-                            if (!imageData.empty()) {
-                                // Store image data directly as raw bytes
-                                MastodonContent content;
-                                content.contentType = "image/jpeg";
-                                content.data = std::move(imageData);
-                                if (seenPostsByHashtag.find(hashtag) != seenPostsByHashtag.end()) {
-                                    if (seenPostsByHashtag[hashtag].find(status["id"]) != seenPostsByHashtag[hashtag].end()) {
-                                        logDebug("MastodonClient::searchStatuses: skipping decoding image for because it was already seen");
-                                        continue;
-                                    }
-                                } else {
-                                    std::set<std::string> newSet;
-                                    newSet.insert(status["id"]);
-                                    seenPostsByHashtag[hashtag] = newSet;
-                                }
-                                results.push_back(content);
-                                seenPostsByHashtag[hashtag].insert(status["id"]);
-                                logDebug("MastodonClient::searchStatuses: Downloaded image, size: " + std::to_string(content.data.size()));
-                            }
-                        }
-                    }
-                }
-            }
-                
-            // Also process text content if available
-            if (status.contains("content")) {
-                std::string rawContent = status["content"].get<std::string>();
-
-                // Strip HTML tags using libxml2
-                std::string plainTextContent = stripHtmlWithLibxml2(rawContent);
-
-                // Remove the hashtag from text content
-                size_t pos = plainTextContent.find(" " + hashtag);
-                if (pos != std::string::npos) {
-                    plainTextContent = plainTextContent.substr(0, pos);
-                }
+        for (size_t i = 0; i < imageUrls.size(); ++i) {
+            LOG_DEBUG(logPrefix + "queueing download for url: " + imageUrls[i]);
+            handles.push_back(acquireCurl(imageUrls[i], logPrefix));
+            CurlPool::Handle& imgCurl = handles.back();
+
+            // Set binary write callback
+            imgCurl->setopt(CURLOPT_WRITEFUNCTION, WriteBinaryCallback);
+            imgCurl->setopt(CURLOPT_WRITEDATA, &images[i]);
+
+            // Add Authorization header
+            imgCurl->setSharedHeaders(authHeaders.get());
+
+            // Wait for an existing HTTP/2 connection to multiplex on rather than opening more
+            imgCurl->setopt(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            imgCurl->setopt(CURLOPT_PIPEWAIT, 1L);
+            easyHandles.push_back(imgCurl);
+        }
 
-                // Only add non-empty text content
-                if (!plainTextContent.empty() && plainTextContent != hashtag) {
-                    MastodonContent content;
-                    content.contentType = "text/plain";
-                    content.data = std::vector<uint8_t>(plainTextContent.begin(), plainTextContent.end());
-                    results.push_back(content);
-                }
+        CurlMulti multi;
+        std::vector<CURLcode> codes = multi.performAll(easyHandles, config.maxConcurrentDownloads);
+        for (size_t i = 0; i < codes.size(); ++i) {
+            long httpCode = codes[i] == CURLE_OK ? handles[i]->getinfo<long>(CURLINFO_RESPONSE_CODE) : 0;
+            recordRequest(Metrics::DOWNLOAD_IMAGE, handles[i], codes[i], httpCode);
+            if (codes[i] != CURLE_OK) {
+                logError(logPrefix + "CURL error for " + imageUrls[i] + ": " +
+                         std::string(curl_easy_strerror(codes[i])));
+                images[i].clear();
+            } else if (httpCode != 200) {
+                // The body is an error page, not the image
+                logError(logPrefix + "unexpected HTTP status " + std::to_string(httpCode) + " for " + imageUrls[i]);
+                images[i].clear();
             }
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
+    } catch (curl_exception& e) {
+        logError(logPrefix + "CURL error: " + std::string(e.what()));
+        for (auto& image : images) {
+            image.clear();
+        }
     }
 
-    return results;
+    return images;
 }
 
-std::vector<uint8_t> MastodonClient::downloadImage(const std::string& imageUrl) {
-    std::vector<uint8_t> imageData;
-    logDebug("MastodonClient::downloadImage: called: " + imageUrl);
+long MastodonClient::performTracked(CurlPool::Handle& curl, RateLimiter::Endpoint endpoint, Metrics::Request request) {
+    std::map<std::string, std::string> responseHeaders;
+    curl->setopt(CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl->setopt(CURLOPT_HEADERDATA, &responseHeaders);
 
-    CURL* imgCurl = curl_easy_init();
-    if (imgCurl) {
-        std::string logPrefix = "MastodonClient::downloadImage: ";
-        setCommonCurlOptions(imgCurl, imageUrl, logPrefix);
+    rateLimiter.acquire(endpoint);
+    try {
+        curl->perform();
+    } catch (curl_exception& e) {
+        recordRequest(request, curl, e.getCode(), 0);
+        throw;
+    }
+    long httpCode = curl->getinfo<long>(CURLINFO_RESPONSE_CODE);
+    recordRequest(request, curl, CURLE_OK, httpCode);
+    rateLimiter.update(endpoint, responseHeaders, httpCode);
+    return httpCode;
+}
 
-        // Set binary write callback
-        curl_easy_setopt(imgCurl, CURLOPT_WRITEFUNCTION, WriteBinaryCallback);
-        curl_easy_setopt(imgCurl, CURLOPT_WRITEDATA, &imageData);
+// A client is taken out of placement after this many failed requests in a row, and tried
+// again once the cooldown has passed since the last failure
+static const int unhealthyAfterFailures = 3;
+static const std::chrono::milliseconds unhealthyCooldown{30000};
 
-        // Add Authorization header
-        struct curl_slist* headers = createAuthHeader();
-        curl_easy_setopt(imgCurl, CURLOPT_HTTPHEADER, headers);
+static int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
 
-        // Perform the request
-        logDebug("MastodonClient::downloadImage: performing curl");
-        CURLcode res = curl_easy_perform(imgCurl);
+void MastodonClient::recordRequest(Metrics::Request request, CURL* curl, CURLcode code, long httpCode) {
+    metrics->recordRequest(request, curl, code, httpCode);
+    if (code != CURLE_OK || httpCode >= 500) {
+        ++consecutiveFailures;
+        lastFailureMs = steadyNowMs();
+    } else {
+        consecutiveFailures = 0;
+    }
+}
 
-        // Clean up
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(imgCurl);
+bool MastodonClient::isHealthy() const {
+    return consecutiveFailures < unhealthyAfterFailures ||
+           steadyNowMs() - lastFailureMs >= unhealthyCooldown.count();
+}
+
+// Reads an integer field of a JSON object, leaving value as it is if the field is missing,
+// null or of another type
+template <typename T>
+static void readLimit(const nlohmann::json& object, const char* key, T& value) {
+    auto iter = object.find(key);
+    if (iter != object.end() && iter->is_number_integer()) {
+        value = iter->get<T>();
+    }
+}
+
+// Reads the limits out of an instance document. Mastodon 3.4 and later report them under
+// "configuration" in both API versions, older servers and some forks only the status length.
+static bool parseInstanceLimits(const std::string& response, InstanceLimits& limits) {
+    nlohmann::json instance = nlohmann::json::parse(response, nullptr, false);
+    if (!instance.is_object()) {
+        return false;
+    }
+    if (instance.contains("configuration") && instance["configuration"].is_object()) {
+        const nlohmann::json& configuration = instance["configuration"];
+        if (configuration.contains("statuses") && configuration["statuses"].is_object()) {
+            const nlohmann::json& statuses = configuration["statuses"];
+            readLimit(statuses, "max_characters", limits.maxCharacters);
+            readLimit(statuses, "max_media_attachments", limits.maxMediaAttachments);
+        }
+        if (configuration.contains("media_attachments") && configuration["media_attachments"].is_object()) {
+            readLimit(configuration["media_attachments"], "image_size_limit", limits.imageSizeLimit);
+        }
+    } else {
+        readLimit(instance, "max_toot_chars", limits.maxCharacters);
+    }
+    limits.known = true;
+    return true;
+}
 
-        if (res != CURLE_OK) {
-            logError("MastodonClient::downloadImage: CURL error: " + std::string(curl_easy_strerror(res)));
+bool MastodonClient::fetchInstanceLimits() {
+    const std::string logPrefix = "MastodonClient::fetchInstanceLimits: ";
+
+    // The instance endpoints need no authentication and are not rate limited like the others
+    for (const char* path : {"/api/v2/instance", "/api/v1/instance"}) {
+        std::string url = serverUrl + path;
+        try {
+            CurlPool::Handle curl = acquireCurl(url, logPrefix);
+            curl->setopt(CURLOPT_HTTPGET, 1L);
+            std::string response;
+            curl->setopt(CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl->setopt(CURLOPT_WRITEDATA, &response);
+            curl->perform();
+            long httpCode = curl->getinfo<long>(CURLINFO_RESPONSE_CODE);
+
+            InstanceLimits limits = getInstanceLimits();
+            if (httpCode != 200 || !parseInstanceLimits(response, limits)) {
+                logWarning(logPrefix + "no instance configuration at " + url + ", HTTP status " +
+                           std::to_string(httpCode));
+                continue;
+            }
+            logInfo(logPrefix + serverUrl + " allows " + std::to_string(limits.maxCharacters) +
+                    " characters, " + std::to_string(limits.maxMediaAttachments) + " attachments and " +
+                    std::to_string(limits.imageSizeLimit) + " byte images per status");
+            std::lock_guard<std::mutex> lock(stateMutex);
+            instanceLimits = limits;
+            return true;
+        } catch (curl_exception& e) {
+            logError(logPrefix + "CURL error: " + std::string(e.what()));
+        } catch (nlohmann::json::exception& e) {
+            logError(logPrefix + "invalid instance configuration at " + url + ": " + e.what());
         }
     }
+    return false;
+}
+
+InstanceLimits MastodonClient::getInstanceLimits() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return instanceLimits;
+}
+
+RateLimiter::Budget MastodonClient::getRateBudget(RateLimiter::Endpoint endpoint) const {
+    return rateLimiter.getBudget(endpoint);
+}
+
+const MastodonConfig& MastodonClient::getConfig() const {
+    return config;
+}
 
-    return imageData;
+const std::string& MastodonClient::getServer() const {
+    return serverUrl;
+}
+
+Metrics& MastodonClient::getMetrics() {
+    return *metrics;
+}
+
+std::string MastodonClient::timelineUrl(const std::string& hashtag) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    auto iter = timelineUrls.find(hashtag);
+    if (iter != timelineUrls.end()) {
+        return iter->second;
+    }
+
+    char* encodedHashtag = curl_easy_escape(nullptr, hashtag.c_str(), static_cast<int>(hashtag.length()));
+    if (!encodedHashtag) {
+        return "";
+    }
+    std::string url = timelineUrlPrefix + encodedHashtag + "?local=true";
+    curl_free(encodedHashtag);
+    timelineUrls.emplace(hashtag, url);
+    return url;
 }
 
 struct curl_slist* MastodonClient::createAuthHeader() {
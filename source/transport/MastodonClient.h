@@ -1,10 +1,26 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <curl/curl.h>
+#include <atomic>
+#include <functional>
+#include <future>
 #include <map>
-#include <set>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "curlwrap.h"
+#include "MastodonConfig.h"
+#include "MastodonStream.h"
+#include "RateLimiter.h"
+#include "ResponseCache.h"
+#include "IComponentSdkBase.h"
+#include "Metrics.h"
+#include "StatusJson.h"
+#include "TimelineState.h"
+#include "WorkerPool.h"
 
 /**
  * @brief Structure to hold content with its MIME type
@@ -12,6 +28,33 @@
 struct MastodonContent {
     std::string contentType;  // "text/plain" or "image/jpeg"
     std::vector<uint8_t> data;  // Raw data (text as bytes or image as bytes)
+
+    // Move-only so that downloaded images are never duplicated on the way to the SDK
+    MastodonContent() = default;
+    MastodonContent(MastodonContent&&) = default;
+    MastodonContent& operator=(MastodonContent&&) = default;
+    MastodonContent(const MastodonContent&) = delete;
+    MastodonContent& operator=(const MastodonContent&) = delete;
+};
+
+/**
+ * @brief Outcome of posting a status or uploading media
+ */
+struct PostResult {
+    bool success = false;
+    bool retryable = false;  // The failure was transient (timeout, 429, 5xx) and may succeed if retried
+    std::string id;          // ID of the created status or media attachment
+};
+
+/**
+ * @brief The limits a server places on statuses, from its instance configuration. Until the
+ * configuration has been read they are Mastodon's defaults.
+ */
+struct InstanceLimits {
+    bool known = false;                       // The server has reported its configuration
+    int maxCharacters = 500;                  // Characters in a status, hashtag included
+    int maxMediaAttachments = 4;              // Attachments on one status
+    int64_t imageSizeLimit = 16 * 1024 * 1024;  // Bytes in an uploaded image
 };
 
 /**
@@ -22,29 +65,47 @@ struct MastodonContent {
  * containing a specific hashtag.
  *
  * All content is assumed to be base64-encoded and posted as plain text.
+ *
+ * The requests a link posts with are virtual, so that tests can answer them without a server.
  */
 class MastodonClient {
 public:
-    MastodonClient(const std::string& server, const std::string& accessToken);
-    ~MastodonClient();
+    // Receives the content of statuses delivered by a stream, called on a stream delivery thread
+    using StreamCallback = std::function<void(const std::string& hashtag, std::vector<MastodonContent> results)>;
+
+    /**
+     * @param server The Mastodon server URL (e.g., "https://mastodon.social").
+     * @param accessToken The API access token used for every request.
+     * @param sdk The SDK used to persist timeline cursors, may be null to disable persistence.
+     * @param config Optional tuning parameters.
+     * @param timelineState What has been delivered and posted on the server, shared by the
+     *        clients of every account on it. A new one is created if null.
+     * @param metrics Where requests are recorded, shared by the clients of every account.
+     *        A new one is created if null.
+     */
+    MastodonClient(const std::string& server, const std::string& accessToken,
+                   IComponentSdkBase* sdk = nullptr, const MastodonConfig& config = {},
+                   std::shared_ptr<TimelineState> timelineState = nullptr,
+                   std::shared_ptr<Metrics> metrics = nullptr);
+    virtual ~MastodonClient();
 
     /**
      * @brief Posts a public status (toot) to Mastodon.
      *
      * @param content The base64-encoded content to post as the status text.
      * @param hashtag The hashtag to include for indexing (e.g., "#raceboat_link_123").
-     * @return true if the post succeeded, false otherwise.
+     * @return The result of the post.
      */
-    bool postStatus(const std::string& content, const std::string& hashtag);
+    virtual PostResult postStatus(std::string_view content, const std::string& hashtag);
 
     /**
      * @brief Posts an image to Mastodon as a media attachment with a hashtag.
      *
      * @param imageData The raw JPEG image data as bytes.
      * @param hashtag The hashtag to include for indexing (e.g., "#raceboat_link_123").
-     * @return true if the post succeeded, false otherwise.
+     * @return The result of the post.
      */
-    bool postImage(const std::vector<uint8_t>& imageData, const std::string& hashtag);
+    PostResult postImage(const std::vector<uint8_t>& imageData, const std::string& hashtag);
 
     /**
      * @brief Posts an image with text to Mastodon as a media attachment with custom text and hashtag.
@@ -52,26 +113,232 @@ public:
      * @param imageData The raw JPEG image data as bytes.
      * @param text The text content to include in the status.
      * @param hashtag The hashtag to include for indexing (e.g., "#raceboat_link_123").
-     * @return true if the post succeeded, false otherwise.
+     * @return The result of the post.
      */
-    bool postImageWithText(const std::vector<uint8_t>& imageData, const std::string& text, const std::string& hashtag);
+    PostResult postImageWithText(const std::vector<uint8_t>& imageData, std::string_view text, const std::string& hashtag);
+
+    /**
+     * @brief Uploads an image as a media attachment and waits until the server has finished
+     * processing it.
+     *
+     * Uses the asynchronous /api/v2/media endpoint and polls the attachment until it is ready,
+     * falling back to /api/v1/media on servers without it.
+     *
+     * @param imageData The raw JPEG image data as bytes.
+     * @return The result of the upload, with the ID of the attachment on success.
+     */
+    PostResult uploadMedia(const std::vector<uint8_t>& imageData);
+
+    /**
+     * @brief Starts uploading an image in the background, at most config.maxConcurrentUploads
+     * at a time, so the upload overlaps the posting of earlier statuses.
+     *
+     * @param imageData The raw JPEG image data as bytes.
+     * @return The result of uploadMedia once the upload finishes.
+     */
+    std::shared_future<PostResult> uploadMediaAsync(std::shared_ptr<const std::vector<uint8_t>> imageData);
+
+    // Loads the bytes of an image when its upload starts, null if they cannot be read
+    using ImageSource = std::function<std::shared_ptr<const std::vector<uint8_t>>()>;
+
+    /**
+     * @brief Like uploadMediaAsync, but the image is only loaded once its upload starts, so
+     * uploads waiting for their turn hold no image in memory.
+     */
+    virtual std::shared_future<PostResult> uploadMediaAsync(ImageSource loadImage);
+
+    /**
+     * @brief Posts a public status with already uploaded media attachments.
+     *
+     * @param text The text content to include in the status, may be empty.
+     * @param hashtag The hashtag to include for indexing (e.g., "#raceboat_link_123").
+     * @param mediaIds The IDs returned by uploadMedia.
+     * @return The result of the post, with the ID of the new status on success.
+     */
+    virtual PostResult createStatus(std::string_view text, const std::string& hashtag,
+                                    const std::vector<std::string>& mediaIds);
 
     /**
      * @brief Searches for public statuses containing the given hashtag.
      *
+     * A per-hashtag cursor remembers the newest status already delivered, so each call only
+     * transfers statuses posted since the previous one. The cursor is persisted through the SDK
+     * storage so that a restart does not replay history.
+     *
      * @param hashtag The hashtag to search for (e.g., "#raceboat_link_123").
      * @return A vector of MastodonContent objects containing both text and image content.
      */
     std::vector<MastodonContent> searchStatuses(const std::string& hashtag);
 
+    /**
+     * @brief Searches the timelines of several hashtags at once.
+     *
+     * The timeline requests for every hashtag are issued in parallel and all of their
+     * attachments are downloaded as one batch, so the time taken scales with network
+     * concurrency rather than with the number of hashtags.
+     *
+     * @param hashtags The hashtags to search for.
+     * @return The content found for each hashtag, in the same order as hashtags.
+     */
+    std::vector<std::vector<MastodonContent>> searchStatusesBatch(const std::vector<std::string>& hashtags);
+
+    /**
+     * @brief Enables the streaming receive mode. Statuses posted to subscribed hashtags are
+     * passed to the callback as soon as the server pushes them.
+     *
+     * @param callback Called with the content of each new status, in order for each hashtag.
+     * Statuses are parsed on the stream thread, then their images are downloaded and the
+     * callback is called on a pool of config.workerThreads threads, so that a slow download
+     * does not hold up the stream.
+     */
+    void startStreaming(StreamCallback callback);
+
+    /**
+     * @brief Starts streaming a hashtag. Does nothing unless streaming was started.
+     */
+    void subscribe(const std::string& hashtag);
+
+    /**
+     * @brief Stops streaming a hashtag once every subscriber has unsubscribed.
+     */
+    void unsubscribe(const std::string& hashtag);
+
+    /**
+     * @brief Checks whether a hashtag still needs to be polled.
+     *
+     * A hashtag is caught up when its stream has been connected since before the last
+     * complete search, so every newer status is delivered by the stream. Polling is needed
+     * whenever streaming is off or the stream has dropped since then.
+     *
+     * @param hashtag The hashtag to check.
+     * @return true if searchStatuses must be called to receive every status.
+     */
+    bool needsPoll(const std::string& hashtag) const;
+
+    /**
+     * @brief The request budget the server has left for an endpoint class.
+     */
+    RateLimiter::Budget getRateBudget(RateLimiter::Endpoint endpoint) const;
+
+    /**
+     * @brief Reads the server's status and media limits from /api/v2/instance, falling back to
+     * /api/v1/instance, and caches them for getInstanceLimits.
+     *
+     * @return false if neither endpoint answered, in which case the defaults are kept.
+     */
+    bool fetchInstanceLimits();
+
+    /**
+     * @brief The limits last read by fetchInstanceLimits. Before then, the status length is
+     * config.maxStatusCharacters and the rest are Mastodon's defaults.
+     */
+    InstanceLimits getInstanceLimits() const;
+
+    const MastodonConfig& getConfig() const;
+
+    const std::string& getServer() const;
+
+    /**
+     * @brief Checks whether requests are reaching the server. A client is unhealthy after
+     * several consecutive connection errors or 5xx responses, until a cooldown has passed.
+     */
+    bool isHealthy() const;
+
+    /**
+     * @brief Keeps the record of the statuses posted to a hashtag while a link uses it. Each
+     * call from a link is paired with a releaseOwnPosts when it shuts down, and the record is
+     * dropped once no link uses the hashtag.
+     */
+    void retainOwnPosts(const std::string& hashtag);
+    void releaseOwnPosts(const std::string& hashtag);
+
+    /**
+     * @brief Request, deduplication and link metrics, shared with the links using this client.
+     */
+    Metrics& getMetrics();
+
 private:
+    struct PendingStatus; // A fetched status whose attachments are still to be downloaded
+    struct TimelineQuery; // Progress of one hashtag through a batch search
+
+    // One page of a timeline response
+    struct TimelinePage {
+        bool ok = false;
+        bool notModified = false; // 304 to a conditional request, the page has no body
+        std::string body;
+        std::string prevUrl; // Link to the next newer page, if any
+        ValidatorCache::Validators validators; // Of a 200 response, for the next request
+    };
+
     std::string serverUrl;
     std::string accessToken;
-    CURL* curl;
-    std::map<std::string, std::set<std::string>> seenPostsByHashtag;
 
-    void initCurl();
+    // Built once for every request: the endpoint URLs and the header lists they send
+    struct SlistDeleter {
+        void operator()(struct curl_slist* list) const { curl_slist_free_all(list); }
+    };
+    const std::string statusesUrl;
+    const std::string mediaV2Url;
+    const std::string mediaV1Url;
+    const std::string timelineUrlPrefix;
+    std::unique_ptr<struct curl_slist, SlistDeleter> authHeaders;
+    std::unique_ptr<struct curl_slist, SlistDeleter> formHeaders; // Authorization and form Content-Type
+    IComponentSdkBase* sdk;
+    MastodonConfig config;
+    CurlPool curlPool; // Reusable handles keeping their connections, sharing DNS and TLS session caches
+    RateLimiter rateLimiter; // Paces requests to the limits reported by the server
+    std::shared_ptr<Metrics> metrics;
+    std::shared_ptr<TimelineState> timelineState; // Seen statuses, cursors and own posts
+    ValidatorCache timelineValidators; // Makes repeated timeline requests conditional
+    MediaCache heldImages; // Downloaded attachments of statuses held back for a failed one
+    mutable std::mutex stateMutex; // Guards the polled generations, instance limits and timeline URLs
+    InstanceLimits instanceLimits;
+    std::unordered_map<std::string, std::string> timelineUrls; // First page URL of each hashtag, without a cursor
+    std::map<std::string, uint64_t> polledGenerations; // Stream generation covered by the last complete search
+    std::atomic<int> consecutiveFailures{0};
+    std::atomic<int64_t> lastFailureMs{0}; // Steady clock time of the last failed request
+    WorkerPool uploadWorkers; // Runs uploadMediaAsync
+    std::atomic<uint64_t> nextUploadId{0};
+    std::atomic<uint64_t> traceCounter{0}; // Requests started, for sampling curl traces
+    StreamCallback streamCallback;
+    std::unique_ptr<WorkerPool> streamWorkers; // Downloads and delivers streamed statuses, a strand per hashtag
+    std::unique_ptr<MastodonStream> stream; // Declared last so it stops before the pools are destroyed
+
+    // The log prefix is used to trace the request, it must outlive the returned handle's request
+    CurlPool::Handle acquireCurl(const std::string& url, const std::string& logPrefix);
     void setCommonCurlOptions(CURL* curl, const std::string& url, const std::string& logPrefix);
-    struct curl_slist* createAuthHeader(); // Create Authorization header
-    std::vector<uint8_t> downloadImage(const std::string& imageUrl);
+    struct curl_slist* createAuthHeader(); // Create Authorization header, for requests that add their own
+    std::string timelineUrl(const std::string& hashtag); // Escaped once per hashtag, empty on failure
+    // Performs a rate-limited request, records its metrics and returns its HTTP status
+    long performTracked(CurlPool::Handle& curl, RateLimiter::Endpoint endpoint, Metrics::Request request);
+    // Records the metrics of a finished request and whether the server was reachable
+    void recordRequest(Metrics::Request request, CURL* curl, CURLcode code, long httpCode);
+    long sendMedia(const std::string& url, const std::vector<uint8_t>& imageData, std::string& response);
+    bool waitForMedia(const std::string& mediaId, bool& retryable);
+    std::vector<TimelinePage> fetchTimelinePages(const std::vector<std::string>& urls);
+    size_t parseTimelinePage(const std::string& hashtag, const std::string& responseString,
+                             std::vector<PendingStatus>& pendingStatuses);
+    PendingStatus parseStatus(const std::string& hashtag, StatusFields&& status);
+    CurlPool::Handle acquireStreamCurl(const std::string& hashtag);
+    void onStreamStatus(const std::string& hashtag, const std::string& statusJson);
+    void deliverStreamStatus(const std::string& hashtag, PendingStatus& pending);
+    std::vector<MastodonContent> assembleTimeline(TimelineQuery& query,
+                                                  std::vector<std::vector<uint8_t>>& images);
+
+    /**
+     * @brief Gets the images of a batch of attachments, taking those kept from an earlier
+     * attempt out of heldImages and downloading the rest with downloadImages.
+     *
+     * @return The image bytes in the same order as attachments. Failed downloads are empty.
+     */
+    std::vector<std::vector<uint8_t>> loadImages(const std::vector<ImageAttachment>& attachments);
+
+    /**
+     * @brief Downloads a batch of images concurrently, limited to config.maxConcurrentDownloads
+     * transfers in flight.
+     *
+     * @param imageUrls The URLs of the images to download.
+     * @return The image bytes in the same order as imageUrls. Failed downloads are empty.
+     */
+    std::vector<std::vector<uint8_t>> downloadImages(const std::vector<std::string>& imageUrls);
  };
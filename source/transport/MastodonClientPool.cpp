@@ -0,0 +1,161 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MastodonClientPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <stdexcept>
+
+#include "Digest.h"
+#include "log.h"
+
+// Points per account on the hash ring, enough for links to spread evenly over a few accounts
+static const int pointsPerAccount = 64;
+
+static bool canSend(const MastodonClient &client, RateLimiter::Endpoint endpoint) {
+    if (!client.isHealthy()) {
+        return false;
+    }
+    RateLimiter::Budget budget = client.getRateBudget(endpoint);
+    return !budget.known || budget.remaining > 0 || budget.untilReset.count() <= 0;
+}
+
+MastodonClientPool::MastodonClientPool(const std::vector<MastodonAccount> &accounts,
+                                       IComponentSdkBase *sdk, const MastodonConfig &config,
+                                       ClientFactory makeClient) :
+    config(config), metrics(std::make_shared<Metrics>()) {
+    if (accounts.empty()) {
+        throw std::invalid_argument("MastodonClientPool: no accounts configured");
+    }
+
+    std::map<std::string, std::shared_ptr<TimelineState>> timelineStates;
+    for (auto &account : accounts) {
+        std::string server = normalizeServer(account.server);
+        auto &state = timelineStates[server];
+        if (!state) {
+            state = std::make_shared<TimelineState>(sdk, static_cast<std::size_t>(config.seenIndexMaxBytes));
+        }
+
+        // Points depend on the account rather than its position in the list, so reordering
+        // the accounts does not move any link
+        std::size_t index = clients.size();
+        std::string identity = server + "\n" + account.accessToken;
+        for (int point = 0; point < pointsPerAccount; ++point) {
+            ring.emplace_back(digest64(identity, static_cast<uint64_t>(point)), index);
+        }
+
+        servers.push_back(server);
+        if (makeClient) {
+            clients.push_back(makeClient(account, state, metrics));
+        } else {
+            clients.push_back(std::make_unique<MastodonClient>(account.server, account.accessToken,
+                                                               sdk, config, state, metrics));
+        }
+    }
+    std::sort(ring.begin(), ring.end());
+}
+
+// Server URLs are compared without case or a trailing slash
+std::string MastodonClientPool::normalizeServer(const std::string &server) {
+    std::string normalized = server;
+    while (!normalized.empty() && normalized.back() == '/') {
+        normalized.pop_back();
+    }
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return normalized;
+}
+
+// Compares a server URL with a normalized one as normalizeServer would, without copying it
+bool MastodonClientPool::sameServer(const std::string &normalized, const std::string &server) {
+    std::size_t length = server.find_last_not_of('/');
+    length = length == std::string::npos ? 0 : length + 1;
+    return length == normalized.size() &&
+           std::equal(normalized.begin(), normalized.end(), server.begin(), [](char lhs, char rhs) {
+               return lhs == std::tolower(static_cast<unsigned char>(rhs));
+           });
+}
+
+bool MastodonClientPool::hasServer(const std::string &server) const {
+    return server.empty() || std::any_of(servers.begin(), servers.end(), [&server](const std::string &candidate) {
+               return sameServer(candidate, server);
+           });
+}
+
+// Links on a server without an account fall back to the default server
+const std::string &MastodonClientPool::resolveServer(const std::string &server) const {
+    for (auto &candidate : servers) {
+        if (sameServer(candidate, server)) {
+            return candidate;
+        }
+    }
+    return servers.front();
+}
+
+template <class Accept>
+MastodonClient *MastodonClientPool::walk(const std::string &hashtag, Accept accept) const {
+    uint64_t point = digest64(hashtag);
+    auto start = std::lower_bound(ring.begin(), ring.end(), std::make_pair(point, std::size_t{0}));
+    for (std::size_t i = 0; i < ring.size(); ++i) {
+        auto iter = start + static_cast<std::ptrdiff_t>(i);
+        if (iter >= ring.end()) {
+            iter -= static_cast<std::ptrdiff_t>(ring.size());
+        }
+        if (accept(iter->second)) {
+            return clients[iter->second].get();
+        }
+    }
+    return nullptr;
+}
+
+std::string MastodonClientPool::placeLink(const std::string &hashtag) const {
+    MastodonClient *client = walk(hashtag, [this](std::size_t index) {
+        return canSend(*clients[index], RateLimiter::STATUSES);
+    });
+    if (client == nullptr) {
+        // Every account is throttled or unhealthy, place the link on its home account anyway
+        client = walk(hashtag, [](std::size_t) { return true; });
+    }
+    return client->getServer();
+}
+
+MastodonClient *MastodonClientPool::homeClient(const std::string &server, const std::string &hashtag) const {
+    const std::string &resolved = resolveServer(server);
+    return walk(hashtag, [this, &resolved](std::size_t index) { return servers[index] == resolved; });
+}
+
+MastodonClient *MastodonClientPool::clientFor(const std::string &server, const std::string &hashtag,
+                                              RateLimiter::Endpoint endpoint) const {
+    const std::string &resolved = resolveServer(server);
+    MastodonClient *client = walk(hashtag, [this, &resolved, endpoint](std::size_t index) {
+        return servers[index] == resolved && canSend(*clients[index], endpoint);
+    });
+    return client != nullptr ? client : homeClient(server, hashtag);
+}
+
+const std::vector<std::unique_ptr<MastodonClient>> &MastodonClientPool::getClients() const {
+    return clients;
+}
+
+const MastodonConfig &MastodonClientPool::getConfig() const {
+    return config;
+}
+
+Metrics &MastodonClientPool::getMetrics() {
+    return *metrics;
+}
@@ -0,0 +1,115 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_MASTODON_CLIENT_POOL_H__
+#define __COMMS_MASTODON_TRANSPORT_MASTODON_CLIENT_POOL_H__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IComponentSdkBase.h"
+#include "MastodonClient.h"
+#include "MastodonConfig.h"
+#include "Metrics.h"
+#include "RateLimiter.h"
+#include "TimelineState.h"
+
+/**
+ * @brief One client per configured account, and the placement of links on them.
+ *
+ * Accounts are placed on a consistent hash ring, and a link's home account is the first one
+ * on its server clockwise from the hash of its hashtag. Adding or removing an account only
+ * moves the links next to it on the ring. While the home account is throttled or unhealthy,
+ * the link's requests go to the next account on the same server that is not, and return
+ * once it recovers. The clients of a server share their timeline state, so moving a link
+ * neither replays its timeline nor delivers a status twice.
+ *
+ * The links are placed on a server when they are created, which is recorded in the link
+ * address because the hashtag can only be fetched from that server.
+ */
+class MastodonClientPool {
+public:
+    // Creates the client of an account, sharing the timeline state of its server and the
+    // metrics of the pool
+    using ClientFactory = std::function<std::unique_ptr<MastodonClient>(
+        const MastodonAccount &account, std::shared_ptr<TimelineState> timelineState,
+        std::shared_ptr<Metrics> metrics)>;
+
+    /**
+     * @param accounts The accounts to create clients for, at least one. The first account's
+     *        server is used for link addresses that do not name one.
+     * @param sdk The SDK used to persist timeline cursors, may be null to disable persistence.
+     * @param config Tuning parameters shared by every client.
+     * @param makeClient Creates the client of each account, a MastodonClient if null. Tests
+     *        use it to stand in for the server.
+     */
+    MastodonClientPool(const std::vector<MastodonAccount> &accounts, IComponentSdkBase *sdk,
+                       const MastodonConfig &config, ClientFactory makeClient = nullptr);
+
+    /**
+     * @brief Chooses the server a new link posts on, placing it on the first account from the
+     * hash of its hashtag that can post right now.
+     *
+     * @return The server URL to record in the link address.
+     */
+    std::string placeLink(const std::string &hashtag) const;
+
+    /**
+     * @brief The account a link is placed on regardless of its health. Streams of the
+     * hashtag run on this client.
+     *
+     * @param server The server from the link address, empty for the default server.
+     */
+    MastodonClient *homeClient(const std::string &server, const std::string &hashtag) const;
+
+    /**
+     * @brief The client a link's requests to an endpoint class should go through right now.
+     *
+     * @param server The server from the link address, empty for the default server.
+     */
+    MastodonClient *clientFor(const std::string &server, const std::string &hashtag,
+                              RateLimiter::Endpoint endpoint) const;
+
+    // true if an account is configured on the server, which may be empty for the default
+    bool hasServer(const std::string &server) const;
+
+    const std::vector<std::unique_ptr<MastodonClient>> &getClients() const;
+    const MastodonConfig &getConfig() const;
+    Metrics &getMetrics();
+
+private:
+    static std::string normalizeServer(const std::string &server);
+    static bool sameServer(const std::string &normalized, const std::string &server);
+    // Called for every request, so it returns one of servers rather than building a string
+    const std::string &resolveServer(const std::string &server) const;
+    // The first client clockwise from the hashtag's point on the ring that is accepted.
+    // Accept is called with a client index and takes the place of a std::function, which
+    // would allocate for its captures on every request.
+    template <class Accept>
+    MastodonClient *walk(const std::string &hashtag, Accept accept) const;
+
+    MastodonConfig config;
+    std::shared_ptr<Metrics> metrics;
+    std::vector<std::string> servers;  // Normalized server of each client
+    std::vector<std::unique_ptr<MastodonClient>> clients;
+    std::vector<std::pair<uint64_t, std::size_t>> ring;  // Sorted (point, client) pairs
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_MASTODON_CLIENT_POOL_H__
@@ -0,0 +1,110 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MastodonConfig.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include "log.h"
+
+// Most threads a pool of the transport is allowed to start
+static const int maxThreads = 256;
+
+void to_json(nlohmann::json &destJson, const MastodonAccount &srcAccount) {
+    destJson = nlohmann::json{{"server", srcAccount.server}};
+}
+
+void from_json(const nlohmann::json &srcJson, MastodonAccount &destAccount) {
+    // Required
+    srcJson.at("server").get_to(destAccount.server);
+    srcJson.at("accessToken").get_to(destAccount.accessToken);
+}
+
+void to_json(nlohmann::json &destJson, const MastodonConfig &srcConfig) {
+    destJson = nlohmann::json{
+        // clang-format off
+        {"maxConcurrentDownloads", srcConfig.maxConcurrentDownloads},
+        {"maxConcurrentTimelineRequests", srcConfig.maxConcurrentTimelineRequests},
+        {"maxTimelinePages", srcConfig.maxTimelinePages},
+        {"seenIndexMaxBytes", srcConfig.seenIndexMaxBytes},
+        {"timelineValidatorEntries", srcConfig.timelineValidatorEntries},
+        {"mediaCacheMaxBytes", srcConfig.mediaCacheMaxBytes},
+        {"streaming", srcConfig.streaming},
+        {"streamReconnectMaxSeconds", srcConfig.streamReconnectMaxSeconds},
+        {"adaptivePolling", srcConfig.adaptivePolling},
+        {"pollMinIntervalMs", srcConfig.pollMinIntervalMs},
+        {"pollMaxIntervalMs", srcConfig.pollMaxIntervalMs},
+        {"pollRequestsPerMinute", srcConfig.pollRequestsPerMinute},
+        {"workerThreads", srcConfig.workerThreads},
+        {"maxConcurrentUploads", srcConfig.maxConcurrentUploads},
+        {"mediaProcessingTimeoutSeconds", srcConfig.mediaProcessingTimeoutSeconds},
+        {"retryInitialDelayMs", srcConfig.retryInitialDelayMs},
+        {"retryMaxDelayMs", srcConfig.retryMaxDelayMs},
+        {"retryMaxElapsedMs", srcConfig.retryMaxElapsedMs},
+        {"postBatchWindowMs", srcConfig.postBatchWindowMs},
+        {"spoolDirectory", srcConfig.spoolDirectory},
+        {"maxStatusCharacters", srcConfig.maxStatusCharacters},
+        {"debugLogging", srcConfig.debugLogging},
+        {"curlTraceSampleEvery", srcConfig.curlTraceSampleEvery},
+        {"metricsIntervalSeconds", srcConfig.metricsIntervalSeconds},
+        {"accounts", srcConfig.accounts},
+        // clang-format on
+    };
+}
+
+// Reads an optional integer option and clamps it to [low, high], so that a negative or
+// oversized value cannot turn into an enormous count or size once it is cast to an unsigned type
+static void readBounded(const nlohmann::json &srcJson, const char *key, int &value, int low,
+                        int high = std::numeric_limits<int>::max()) {
+    int read = srcJson.value(key, value);
+    int bounded = std::min(std::max(read, low), high);
+    if (bounded != read) {
+        logWarning("mastodonOptions: " + std::string(key) + " " + std::to_string(read) + " is out of range, using " +
+                   std::to_string(bounded));
+    }
+    value = bounded;
+}
+
+void from_json(const nlohmann::json &srcJson, MastodonConfig &destConfig) {
+    // Optional
+    readBounded(srcJson, "maxConcurrentDownloads", destConfig.maxConcurrentDownloads, 1);
+    readBounded(srcJson, "maxConcurrentTimelineRequests", destConfig.maxConcurrentTimelineRequests, 1);
+    readBounded(srcJson, "maxTimelinePages", destConfig.maxTimelinePages, 1);
+    readBounded(srcJson, "seenIndexMaxBytes", destConfig.seenIndexMaxBytes, 0);
+    readBounded(srcJson, "timelineValidatorEntries", destConfig.timelineValidatorEntries, 0);
+    readBounded(srcJson, "mediaCacheMaxBytes", destConfig.mediaCacheMaxBytes, 0);
+    destConfig.streaming = srcJson.value("streaming", destConfig.streaming);
+    readBounded(srcJson, "streamReconnectMaxSeconds", destConfig.streamReconnectMaxSeconds, 1);
+    destConfig.adaptivePolling = srcJson.value("adaptivePolling", destConfig.adaptivePolling);
+    readBounded(srcJson, "pollMinIntervalMs", destConfig.pollMinIntervalMs, 1);
+    readBounded(srcJson, "pollMaxIntervalMs", destConfig.pollMaxIntervalMs, destConfig.pollMinIntervalMs);
+    readBounded(srcJson, "pollRequestsPerMinute", destConfig.pollRequestsPerMinute, 0);
+    readBounded(srcJson, "workerThreads", destConfig.workerThreads, 1, maxThreads);
+    readBounded(srcJson, "maxConcurrentUploads", destConfig.maxConcurrentUploads, 1, maxThreads);
+    readBounded(srcJson, "mediaProcessingTimeoutSeconds", destConfig.mediaProcessingTimeoutSeconds, 0);
+    readBounded(srcJson, "retryInitialDelayMs", destConfig.retryInitialDelayMs, 0);
+    readBounded(srcJson, "retryMaxDelayMs", destConfig.retryMaxDelayMs, destConfig.retryInitialDelayMs);
+    readBounded(srcJson, "retryMaxElapsedMs", destConfig.retryMaxElapsedMs, 0);
+    readBounded(srcJson, "postBatchWindowMs", destConfig.postBatchWindowMs, 0);
+    readBounded(srcJson, "maxStatusCharacters", destConfig.maxStatusCharacters, 1);
+    destConfig.spoolDirectory = srcJson.value("spoolDirectory", destConfig.spoolDirectory);
+    destConfig.debugLogging = srcJson.value("debugLogging", destConfig.debugLogging);
+    readBounded(srcJson, "curlTraceSampleEvery", destConfig.curlTraceSampleEvery, 0);
+    readBounded(srcJson, "metricsIntervalSeconds", destConfig.metricsIntervalSeconds, 0);
+    destConfig.accounts = srcJson.value("accounts", destConfig.accounts);
+}
@@ -0,0 +1,131 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_MASTODON_CONFIG_H__
+#define __COMMS_MASTODON_TRANSPORT_MASTODON_CONFIG_H__
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A Mastodon account the transport can post and fetch through.
+ */
+struct MastodonAccount {
+    std::string server;       // Server URL, e.g. https://mastodon.social
+    std::string accessToken;  // API access token of the account on that server
+};
+
+/**
+ * @brief Optional tuning parameters for the Mastodon transport. Every field has a default so
+ * the transport works unchanged when the mastodonOptions parameter is not provided.
+ */
+struct MastodonConfig {
+    // Maximum number of media downloads in flight at once while fetching a timeline page
+    int maxConcurrentDownloads{8};
+
+    // Maximum number of timeline requests in flight at once when fetching several links
+    int maxConcurrentTimelineRequests{8};
+
+    // Maximum number of timeline pages followed in a single fetch when catching up on a burst
+    int maxTimelinePages{5};
+
+    // Memory ceiling in bytes for the index of already delivered statuses, shared by all links
+    int seenIndexMaxBytes{1 << 20};
+
+    // Timeline URLs whose ETag and Last-Modified validators are remembered, so that polling a
+    // timeline with nothing new gets an empty 304 response. 0 to send no conditional requests.
+    int timelineValidatorEntries{256};
+
+    // Memory ceiling in bytes for the attachments of statuses held back because another of
+    // their attachments failed to download, so that the retry only downloads what is missing
+    int mediaCacheMaxBytes{16 << 20};
+
+    // Receive statuses over the hashtag streaming API as they are posted instead of waiting
+    // for the next fetch. Fetches still run to catch up whenever a stream is not connected.
+    bool streaming{false};
+
+    // Upper bound in seconds on the exponential backoff between stream reconnect attempts
+    int streamReconnectMaxSeconds{60};
+
+    // Poll the timelines on a schedule of the transport's own rather than only when a fetch
+    // action runs. A hashtag is polled every pollMinIntervalMs while it brings new statuses
+    // and backs off exponentially to every pollMaxIntervalMs while it is quiet. Wildcard fetch
+    // actions then only poll the hashtags that are due.
+    bool adaptivePolling{false};
+    int pollMinIntervalMs{2000};
+    int pollMaxIntervalMs{60000};
+
+    // Hashtag polls allowed per minute over all links when adaptivePolling is on, the busiest
+    // hashtags going first when more are due. 0 for no limit besides the server's.
+    int pollRequestsPerMinute{60};
+
+    // Number of threads that run post and fetch actions. Actions on one link run in order,
+    // actions on different links run in parallel.
+    int workerThreads{4};
+
+    // Maximum number of media uploads in flight at once. Uploads start when content is
+    // enqueued so that they overlap the status posts of earlier actions.
+    int maxConcurrentUploads{2};
+
+    // How long to wait for the server to finish processing an uploaded attachment
+    int mediaProcessingTimeoutSeconds{60};
+
+    // Backoff before the first retry of a post that failed with a transient error, doubled
+    // with jitter for each further attempt up to retryMaxDelayMs. The number of attempts is
+    // bounded by the maxTries field of the link address, and a post is no longer retried once
+    // retryMaxElapsedMs have passed since its first attempt (0 for no limit).
+    int retryInitialDelayMs{1000};
+    int retryMaxDelayMs{60000};
+    int retryMaxElapsedMs{300000};
+
+    // Hold text posts back for this long so that the text of several actions on a link is
+    // posted as one status, 0 to post every action on its own. Framed statuses are split
+    // back into their packages on receive whatever this is set to.
+    int postBatchWindowMs{0};
+
+    // Most characters in a status, used to decide how many packages fit in one until the
+    // server has reported its own limit
+    int maxStatusCharacters{500};
+
+    // Directory holding a spool file per link with the content enqueued and not yet posted,
+    // which is posted again when the link is next loaded after a restart or crash. Empty to
+    // keep enqueued content in memory only.
+    std::string spoolDirectory;
+
+    // Write debug messages, false to skip formatting and logging them on busy links
+    bool debugLogging{true};
+
+    // Log curl's verbose trace of one request in this many, e.g. 1 traces every request and
+    // 100 one in a hundred. 0 turns tracing off so requests pay nothing for it.
+    int curlTraceSampleEvery{0};
+
+    // Interval at which request, deduplication and link metrics are reported, 0 to disable
+    int metricsIntervalSeconds{60};
+
+    // Accounts in addition to the one given by the mastodonServer and accessToken parameters.
+    // Links are spread across all of them, each account bringing its own rate limits.
+    std::vector<MastodonAccount> accounts;
+};
+
+// Enable automatic conversion to/from json. Access tokens are left out of the JSON written,
+// which is only used for logging.
+void to_json(nlohmann::json &destJson, const MastodonAccount &srcAccount);
+void from_json(const nlohmann::json &srcJson, MastodonAccount &destAccount);
+void to_json(nlohmann::json &destJson, const MastodonConfig &srcConfig);
+void from_json(const nlohmann::json &srcJson, MastodonConfig &destConfig);
+
+#endif  // __COMMS_MASTODON_TRANSPORT_MASTODON_CONFIG_H__
@@ -0,0 +1,258 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MastodonStream.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+// A connection that stayed up this long is considered healthy and resets the backoff
+static const std::chrono::seconds healthyConnection{60};
+
+MastodonStream::MastodonStream(HandleFactory handleFactory, StatusHandler statusHandler,
+                               int reconnectMaxSeconds) :
+    handleFactory(std::move(handleFactory)),
+    statusHandler(std::move(statusHandler)),
+    reconnectMaxSeconds(std::max(1, reconnectMaxSeconds)) {
+    multi = curl_multi_init();
+    if (!multi) {
+        throw curl_exception(CURLE_FAILED_INIT);
+    }
+    thread = std::thread(&MastodonStream::run, this);
+}
+
+MastodonStream::~MastodonStream() {
+    running = false;
+    curl_multi_wakeup(multi);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    curl_multi_cleanup(multi);
+}
+
+void MastodonStream::subscribe(const std::string &hashtag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &subscription = subscriptions[hashtag];
+        if (!subscription) {
+            subscription = std::make_unique<Subscription>();
+            subscription->stream = this;
+            subscription->hashtag = hashtag;
+            LOG_DEBUG("MastodonStream::subscribe: streaming " + hashtag);
+        }
+        ++subscription->subscribers;
+    }
+    curl_multi_wakeup(multi);
+}
+
+void MastodonStream::unsubscribe(const std::string &hashtag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = subscriptions.find(hashtag);
+        if (iter == subscriptions.end() || iter->second->subscribers == 0) {
+            return;
+        }
+        // The stream thread closes the connection once the count reaches zero
+        --iter->second->subscribers;
+    }
+    curl_multi_wakeup(multi);
+}
+
+bool MastodonStream::isLive(const std::string &hashtag, uint64_t &generation) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = subscriptions.find(hashtag);
+    if (iter == subscriptions.end() || !iter->second->live) {
+        return false;
+    }
+    generation = iter->second->generation;
+    return true;
+}
+
+size_t MastodonStream::onData(char *contents, size_t size, size_t nmemb, void *userp) {
+    size_t totalSize = size * nmemb;
+    Subscription &subscription = *static_cast<Subscription *>(userp);
+    MastodonStream &stream = *subscription.stream;
+
+    if (!subscription.live) {
+        long httpCode = 0;
+        curl_easy_getinfo(static_cast<CURL *>(*subscription.curl), CURLINFO_RESPONSE_CODE, &httpCode);
+        if (httpCode != 200) {
+            logError("MastodonStream::onData: unexpected HTTP status " + std::to_string(httpCode) +
+                     " streaming " + subscription.hashtag);
+            return 0;  // Abort the transfer, it will be retried after a backoff
+        }
+
+        std::lock_guard<std::mutex> lock(stream.mutex);
+        subscription.live = true;
+        ++subscription.generation;
+        subscription.connectedAt = std::chrono::steady_clock::now();
+        logInfo("MastodonStream::onData: connected to stream for " + subscription.hashtag);
+    }
+
+    subscription.lineBuffer.append(contents, totalSize);
+    size_t start = 0;
+    size_t end;
+    while ((end = subscription.lineBuffer.find('\n', start)) != std::string::npos) {
+        stream.processLine(subscription, subscription.lineBuffer.substr(start, end - start));
+        start = end + 1;
+    }
+    subscription.lineBuffer.erase(0, start);
+    return totalSize;
+}
+
+/**
+ * @brief Parses one line of a server-sent event stream, dispatching the event at the blank
+ * line that terminates it.
+ */
+void MastodonStream::processLine(Subscription &subscription, const std::string &rawLine) {
+    std::string line = rawLine;
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+
+    if (line.empty()) {
+        if (subscription.event == "update" && !subscription.data.empty()) {
+            statusHandler(subscription.hashtag, subscription.data);
+        }
+        subscription.event.clear();
+        subscription.data.clear();
+        return;
+    }
+
+    // Lines starting with a colon are comments, Mastodon sends them as heartbeats
+    if (line[0] == ':') {
+        return;
+    }
+
+    size_t colon = line.find(':');
+    std::string field = line.substr(0, colon);
+    std::string value;
+    if (colon != std::string::npos) {
+        value = line.substr(colon + 1);
+        if (!value.empty() && value[0] == ' ') {
+            value.erase(0, 1);
+        }
+    }
+
+    if (field == "event") {
+        subscription.event = value;
+    } else if (field == "data") {
+        if (!subscription.data.empty()) {
+            subscription.data += '\n';
+        }
+        subscription.data += value;
+    }
+}
+
+/**
+ * @brief Opens the stream of a subscription. Called on the stream thread with the mutex held.
+ */
+void MastodonStream::connect(Subscription &subscription) {
+    try {
+        subscription.curl = std::make_unique<CurlPool::Handle>(handleFactory(subscription.hashtag));
+        CurlWrap &curl = **subscription.curl;
+        curl.setopt(CURLOPT_WRITEFUNCTION, onData);
+        curl.setopt(CURLOPT_WRITEDATA, static_cast<void *>(&subscription));
+        curl.setopt(CURLOPT_PRIVATE, static_cast<void *>(&subscription));
+        if (curl_multi_add_handle(multi, curl) != CURLM_OK) {
+            throw curl_exception(CURLE_FAILED_INIT);
+        }
+    } catch (curl_exception &e) {
+        logError("MastodonStream::connect: failed to open stream for " + subscription.hashtag +
+                 ": " + std::string(e.what()));
+        subscription.curl.reset();
+        disconnect(subscription, true);
+    }
+}
+
+/**
+ * @brief Closes the stream of a subscription, scheduling a reconnect if requested. Called on
+ * the stream thread with the mutex held.
+ */
+void MastodonStream::disconnect(Subscription &subscription, bool retry) {
+    auto now = std::chrono::steady_clock::now();
+    if (subscription.curl) {
+        curl_multi_remove_handle(multi, **subscription.curl);
+        subscription.curl.reset();
+    }
+
+    if (subscription.live) {
+        logWarning("MastodonStream::disconnect: stream for " + subscription.hashtag + " closed");
+        if (now - subscription.connectedAt >= healthyConnection) {
+            subscription.backoffSeconds = 1;
+        }
+    }
+    subscription.live = false;
+    subscription.lineBuffer.clear();
+    subscription.event.clear();
+    subscription.data.clear();
+
+    if (retry) {
+        subscription.retryAt = now + std::chrono::seconds(subscription.backoffSeconds);
+        subscription.backoffSeconds = std::min(subscription.backoffSeconds * 2, reconnectMaxSeconds);
+    }
+}
+
+void MastodonStream::run() {
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto now = std::chrono::steady_clock::now();
+            for (auto iter = subscriptions.begin(); iter != subscriptions.end();) {
+                Subscription &subscription = *iter->second;
+                if (subscription.subscribers == 0) {
+                    disconnect(subscription, false);
+                    iter = subscriptions.erase(iter);
+                    continue;
+                }
+                if (!subscription.curl && now >= subscription.retryAt) {
+                    connect(subscription);
+                }
+                ++iter;
+            }
+        }
+
+        int runningHandles = 0;
+        curl_multi_perform(multi, &runningHandles);
+
+        int queued = 0;
+        CURLMsg *msg = NULL;
+        while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            void *userp = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &userp);
+            Subscription &subscription = *static_cast<Subscription *>(userp);
+            if (msg->data.result != CURLE_OK) {
+                logWarning("MastodonStream::run: stream for " + subscription.hashtag +
+                           " failed: " + std::string(curl_easy_strerror(msg->data.result)));
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            disconnect(subscription, true);
+        }
+
+        // Wake at least once a second to reconnect streams whose backoff has expired
+        curl_multi_poll(multi, NULL, 0, 1000, NULL);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : subscriptions) {
+        disconnect(*entry.second, false);
+    }
+}
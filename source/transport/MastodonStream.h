@@ -0,0 +1,111 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_MASTODON_STREAM_H__
+#define __COMMS_MASTODON_TRANSPORT_MASTODON_STREAM_H__
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "curlwrap.h"
+
+/**
+ * @brief Subscribes to Mastodon's server-sent event streams for a set of hashtags.
+ *
+ * A single background thread drives one long-lived request per subscribed hashtag through a
+ * curl multi handle. Each "update" event is passed to the status handler as soon as it
+ * arrives. Dropped streams are reconnected with exponential backoff. Every successful
+ * connection starts a new generation. Callers use the generation to tell whether statuses
+ * may have been missed while the stream was down.
+ */
+class MastodonStream {
+public:
+    // Creates a request for the stream of a hashtag with the URL and credentials already set
+    using HandleFactory = std::function<CurlPool::Handle(const std::string &hashtag)>;
+    // Called on the stream thread with the JSON of each status posted to a hashtag
+    using StatusHandler =
+        std::function<void(const std::string &hashtag, const std::string &statusJson)>;
+
+    MastodonStream(HandleFactory handleFactory, StatusHandler statusHandler,
+                   int reconnectMaxSeconds);
+    ~MastodonStream();
+
+    /**
+     * @brief Start streaming a hashtag. Subscriptions are reference counted so that links
+     * sharing a hashtag share a stream.
+     */
+    void subscribe(const std::string &hashtag);
+
+    /**
+     * @brief Release a subscription, closing the stream once no subscriber remains.
+     */
+    void unsubscribe(const std::string &hashtag);
+
+    /**
+     * @brief Check whether the stream of a hashtag is currently connected.
+     *
+     * @param hashtag The hashtag to check.
+     * @param generation Set to the generation of the current connection if connected.
+     * @return true if the stream is connected.
+     */
+    bool isLive(const std::string &hashtag, uint64_t &generation) const;
+
+    // Disable copying or moving
+    MastodonStream(const MastodonStream &) = delete;
+    MastodonStream &operator=(const MastodonStream &) = delete;
+
+private:
+    struct Subscription {
+        MastodonStream *stream;
+        std::string hashtag;
+        int subscribers{0};
+        std::unique_ptr<CurlPool::Handle> curl;
+        bool live{false};
+        uint64_t generation{0};
+        int backoffSeconds{1};
+        std::chrono::steady_clock::time_point retryAt;
+        std::chrono::steady_clock::time_point connectedAt;
+
+        // Server-sent event parser state
+        std::string lineBuffer;
+        std::string event;
+        std::string data;
+    };
+
+    static size_t onData(char *contents, size_t size, size_t nmemb, void *userp);
+    void processLine(Subscription &subscription, const std::string &line);
+    void connect(Subscription &subscription);
+    void disconnect(Subscription &subscription, bool retry);
+    void run();
+
+    HandleFactory handleFactory;
+    StatusHandler statusHandler;
+    int reconnectMaxSeconds;
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Subscription>> subscriptions;
+    CURLM *multi;
+    std::atomic<bool> running{true};
+    std::thread thread;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_MASTODON_STREAM_H__
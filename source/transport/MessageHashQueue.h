@@ -18,22 +18,38 @@
 #ifndef __COMMS_TWOSIX_TRANSPORT_MESSAGE_HASH_QUEUE_H__
 #define __COMMS_TWOSIX_TRANSPORT_MESSAGE_HASH_QUEUE_H__
 
-#include <cinttypes>
-#include <deque>
+#include <cstdint>
 #include <string>
-#include <vector>
 
+#include "HashRing.h"
+
+/**
+ * @brief Insertion-ordered set of message digests, used to recognize messages we posted
+ *        when they come back on a fetch.
+ *
+ * Messages are reduced to a 64-bit XXH64 digest, which is stable across platforms and runs,
+ * and kept in a HashRing so every operation takes constant time. When the queue is full the
+ * oldest digest is evicted. A message added again while its digest is still present is only
+ * recorded once.
+ */
 class MessageHashQueue {
 public:
-    std::size_t addMessage(const std::string &message);
-    void removeHash(std::size_t hash);
+    static const std::size_t defaultCapacity{1024};
+
+    explicit MessageHashQueue(std::size_t capacity = defaultCapacity);
+
+    std::uint64_t addMessage(const std::string &message);
+    void removeHash(std::uint64_t hash);
     bool findAndRemoveMessage(const std::string &message);
+    bool containsMessage(const std::string &message) const;
 
-private:
-    static const std::deque<std::size_t>::size_type max{1024};
-    static std::size_t hash(const std::string &message);
+    std::size_t size() const;
+    std::size_t capacity() const;
+
+    static std::uint64_t hash(const std::string &message);
 
-    std::deque<std::size_t> queue;
+private:
+    HashRing ring;
 };
 
-#endif  // __COMMS_TWOSIX_TRANSPORT_MESSAGE_HASH_QUEUE_H__
\ No newline at end of file
+#endif  // __COMMS_TWOSIX_TRANSPORT_MESSAGE_HASH_QUEUE_H__
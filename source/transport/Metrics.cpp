@@ -0,0 +1,259 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Metrics.h"
+
+#include <algorithm>
+
+static const char *requestName(Metrics::Request request) {
+    switch (request) {
+        case Metrics::POST_STATUS:
+            return "postStatus";
+        case Metrics::UPLOAD_MEDIA:
+            return "uploadMedia";
+        case Metrics::POLL_MEDIA:
+            return "pollMedia";
+        case Metrics::FETCH_TIMELINE:
+            return "fetchTimeline";
+        case Metrics::DOWNLOAD_IMAGE:
+            return "downloadImage";
+        default:
+            return "unknown";
+    }
+}
+
+static const char *failureName(Metrics::Failure failure) {
+    switch (failure) {
+        case Metrics::CURL_ERROR:
+            return "curlError";
+        case Metrics::RATE_LIMITED:
+            return "rateLimited";
+        case Metrics::CLIENT_ERROR:
+            return "clientError";
+        case Metrics::SERVER_ERROR:
+            return "serverError";
+        default:
+            return "unknown";
+    }
+}
+
+void Metrics::Histogram::record(int64_t micros) {
+    micros = std::max<int64_t>(0, micros);
+    int bucket = 0;
+    while (bucket < numBuckets - 1 && (int64_t{1} << bucket) <= micros) {
+        ++bucket;
+    }
+    ++buckets[bucket];
+    ++count;
+    sumMicros += micros;
+    maxMicros = std::max(maxMicros, micros);
+}
+
+int64_t Metrics::Histogram::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < numBuckets; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return std::min(int64_t{1} << bucket, maxMicros);
+        }
+    }
+    return maxMicros;
+}
+
+Metrics::Metrics() : intervalStart(std::chrono::steady_clock::now()) {}
+
+// Reads a phase timestamp, which curl reports as microseconds since the start of the transfer
+static int64_t transferTime(CURL *curl, CURLINFO info) {
+    curl_off_t micros = 0;
+    if (curl_easy_getinfo(curl, info, &micros) != CURLE_OK) {
+        return 0;
+    }
+    return static_cast<int64_t>(micros);
+}
+
+void Metrics::recordRequest(Request request, CURL *curl, CURLcode code, long httpCode) {
+    // Timestamps are cumulative, a phase that did not happen (e.g. on a reused connection)
+    // has the same timestamp as the one before it
+    int64_t nameLookup = transferTime(curl, CURLINFO_NAMELOOKUP_TIME_T);
+    int64_t connect = std::max(nameLookup, transferTime(curl, CURLINFO_CONNECT_TIME_T));
+    int64_t appConnect = std::max(connect, transferTime(curl, CURLINFO_APPCONNECT_TIME_T));
+    int64_t preTransfer = std::max(appConnect, transferTime(curl, CURLINFO_PRETRANSFER_TIME_T));
+    int64_t startTransfer = std::max(preTransfer, transferTime(curl, CURLINFO_STARTTRANSFER_TIME_T));
+    int64_t total = std::max(startTransfer, transferTime(curl, CURLINFO_TOTAL_TIME_T));
+    curl_off_t bytesOut = 0;
+    curl_off_t bytesIn = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytesOut);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytesIn);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    RequestStats &stats = current.requests[request];
+    ++stats.count;
+    stats.bytesOut += static_cast<uint64_t>(std::max<curl_off_t>(0, bytesOut));
+    stats.bytesIn += static_cast<uint64_t>(std::max<curl_off_t>(0, bytesIn));
+    if (code != CURLE_OK) {
+        ++stats.failures[CURL_ERROR];
+    } else if (httpCode == 429) {
+        ++stats.failures[RATE_LIMITED];
+    } else if (httpCode >= 500) {
+        ++stats.failures[SERVER_ERROR];
+    } else if (httpCode >= 400) {
+        ++stats.failures[CLIENT_ERROR];
+    } else if (httpCode == 304) {
+        ++stats.notModified;
+    }
+    stats.total.record(total);
+    stats.dns.record(nameLookup);
+    stats.connect.record(connect - nameLookup);
+    stats.tls.record(appConnect - connect);
+    stats.server.record(startTransfer - preTransfer);
+    stats.download.record(total - startTransfer);
+}
+
+void Metrics::recordDedup(bool hit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++(hit ? current.dedupHits : current.dedupMisses);
+}
+
+void Metrics::recordEcho() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++current.echoes;
+}
+
+void Metrics::recordMediaCacheHit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++current.mediaCacheHits;
+}
+
+void Metrics::recordPost(const std::string &linkId, bool success, std::chrono::microseconds elapsed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    LinkStats &stats = current.links[linkId];
+    ++(success ? stats.postsSent : stats.postsFailed);
+    stats.postTime.record(elapsed.count());
+}
+
+void Metrics::recordRetry(const std::string &linkId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++current.links[linkId].retries;
+}
+
+void Metrics::recordReceived(const std::string &linkId, std::size_t items) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current.links[linkId].itemsReceived += items;
+}
+
+void Metrics::setQueueDepth(const std::string &linkId, std::size_t depth) {
+    std::lock_guard<std::mutex> lock(mutex);
+    LinkStats &stats = current.links[linkId];
+    stats.queueDepth = depth;
+    stats.maxQueueDepth = std::max<uint64_t>(stats.maxQueueDepth, depth);
+}
+
+void Metrics::removeLink(const std::string &linkId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    current.links.erase(linkId);
+}
+
+Metrics::Snapshot Metrics::collect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    Snapshot snapshot = std::move(current);
+    snapshot.interval = std::chrono::duration_cast<std::chrono::milliseconds>(now - intervalStart);
+
+    current = Snapshot{};
+    for (auto &link : snapshot.links) {
+        if (link.second.queueDepth != 0) {
+            LinkStats &stats = current.links[link.first];
+            stats.queueDepth = link.second.queueDepth;
+            stats.maxQueueDepth = link.second.queueDepth;
+        }
+    }
+    intervalStart = now;
+    return snapshot;
+}
+
+static nlohmann::json histogramJson(const Metrics::Histogram &histogram) {
+    auto ms = [](int64_t micros) { return static_cast<double>(micros) / 1000.0; };
+    return nlohmann::json{
+        {"mean", ms(histogram.sumMicros / static_cast<int64_t>(histogram.count))},
+        {"p50", ms(histogram.percentile(0.5))},
+        {"p90", ms(histogram.percentile(0.9))},
+        {"p99", ms(histogram.percentile(0.99))},
+        {"max", ms(histogram.maxMicros)},
+    };
+}
+
+void to_json(nlohmann::json &destJson, const Metrics::Snapshot &snapshot) {
+    destJson = nlohmann::json{{"intervalMs", snapshot.interval.count()}};
+
+    nlohmann::json requests = nlohmann::json::object();
+    for (int i = 0; i < Metrics::NUM_REQUESTS; ++i) {
+        const Metrics::RequestStats &stats = snapshot.requests[i];
+        if (stats.count == 0) {
+            continue;
+        }
+        nlohmann::json failures = nlohmann::json::object();
+        for (int j = 0; j < Metrics::NUM_FAILURES; ++j) {
+            if (stats.failures[j] != 0) {
+                failures[failureName(static_cast<Metrics::Failure>(j))] = stats.failures[j];
+            }
+        }
+        requests[requestName(static_cast<Metrics::Request>(i))] = {
+            {"count", stats.count},
+            {"failures", failures},
+            {"notModified", stats.notModified},
+            {"bytesOut", stats.bytesOut},
+            {"bytesIn", stats.bytesIn},
+            {"totalMs", histogramJson(stats.total)},
+            {"dnsMs", histogramJson(stats.dns)},
+            {"connectMs", histogramJson(stats.connect)},
+            {"tlsMs", histogramJson(stats.tls)},
+            {"serverMs", histogramJson(stats.server)},
+            {"downloadMs", histogramJson(stats.download)},
+        };
+    }
+    destJson["requests"] = requests;
+
+    nlohmann::json links = nlohmann::json::object();
+    for (auto &link : snapshot.links) {
+        const Metrics::LinkStats &stats = link.second;
+        nlohmann::json linkJson = {
+            {"postsSent", stats.postsSent},
+            {"postsFailed", stats.postsFailed},
+            {"retries", stats.retries},
+            {"itemsReceived", stats.itemsReceived},
+            {"queueDepth", stats.queueDepth},
+            {"maxQueueDepth", stats.maxQueueDepth},
+        };
+        if (stats.postTime.count != 0) {
+            linkJson["postMs"] = histogramJson(stats.postTime);
+        }
+        links[link.first] = linkJson;
+    }
+    destJson["links"] = links;
+
+    uint64_t lookups = snapshot.dedupHits + snapshot.dedupMisses;
+    destJson["dedup"] = {
+        {"hits", snapshot.dedupHits},
+        {"misses", snapshot.dedupMisses},
+        {"hitRate", lookups == 0 ? 0.0 : static_cast<double>(snapshot.dedupHits) / lookups},
+        {"echoes", snapshot.echoes},
+    };
+    destJson["mediaCacheHits"] = snapshot.mediaCacheHits;
+}
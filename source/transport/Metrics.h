@@ -0,0 +1,135 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_METRICS_H__
+#define __COMMS_MASTODON_TRANSPORT_METRICS_H__
+
+#include <curl/curl.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+
+/**
+ * @brief Counters and latency histograms for the requests the transport makes and the
+ * actions its links run.
+ *
+ * Requests are recorded per endpoint with the phase breakdown curl measures for them, so the
+ * time of a post or fetch can be split between DNS, connecting, TLS, waiting for the server and
+ * receiving the response. Links record their posts, retries, received items and the depth of
+ * their content queue. collect() returns everything recorded since the previous call, which
+ * the plugin passes to a sink on a fixed interval.
+ *
+ * Every method is thread-safe.
+ */
+class Metrics {
+public:
+    enum Request { POST_STATUS, UPLOAD_MEDIA, POLL_MEDIA, FETCH_TIMELINE, DOWNLOAD_IMAGE, NUM_REQUESTS };
+    enum Failure { CURL_ERROR, RATE_LIMITED, CLIENT_ERROR, SERVER_ERROR, NUM_FAILURES };
+
+    /**
+     * @brief Latency distribution in power-of-two buckets of microseconds. Percentiles are
+     * reported as the upper bound of the bucket they fall in, so they are accurate to a factor
+     * of two, which is enough to tell network time from server time.
+     */
+    struct Histogram {
+        static const int numBuckets = 40;
+        uint64_t buckets[numBuckets] = {};  // buckets[i] counts values below 2^i microseconds
+        uint64_t count = 0;
+        int64_t sumMicros = 0;
+        int64_t maxMicros = 0;
+
+        void record(int64_t micros);
+        int64_t percentile(double fraction) const;
+    };
+
+    struct RequestStats {
+        uint64_t count = 0;
+        uint64_t failures[NUM_FAILURES] = {};
+        uint64_t notModified = 0;  // 304 responses to conditional requests
+        uint64_t bytesOut = 0;
+        uint64_t bytesIn = 0;
+        Histogram total;
+        Histogram dns;       // Name resolution
+        Histogram connect;   // TCP connect after resolution
+        Histogram tls;       // TLS handshake after connecting
+        Histogram server;    // Sending the request and waiting for the first response byte
+        Histogram download;  // Receiving the response
+    };
+
+    struct LinkStats {
+        uint64_t postsSent = 0;
+        uint64_t postsFailed = 0;
+        uint64_t retries = 0;
+        uint64_t itemsReceived = 0;
+        uint64_t queueDepth = 0;     // Actions enqueued and not yet posted or dequeued
+        uint64_t maxQueueDepth = 0;  // Highest queue depth during the interval
+        Histogram postTime;          // Time of each post attempt, including the upload wait
+    };
+
+    struct Snapshot {
+        std::chrono::milliseconds interval{0};
+        RequestStats requests[NUM_REQUESTS];
+        std::map<std::string, LinkStats> links;
+        uint64_t dedupHits = 0;    // Statuses skipped because they were already delivered
+        uint64_t dedupMisses = 0;  // Statuses delivered for the first time
+        uint64_t echoes = 0;       // Statuses we posted ourselves, dropped before delivery
+        uint64_t mediaCacheHits = 0;  // Attachments kept from an earlier attempt instead of downloaded
+    };
+
+    using Sink = std::function<void(const Snapshot &snapshot)>;
+
+    Metrics();
+
+    /**
+     * @brief Records a completed or failed request, reading its timings and sizes from curl.
+     *
+     * @param request The endpoint the request was sent to.
+     * @param curl The easy handle the request ran on.
+     * @param code The result of the transfer.
+     * @param httpCode The HTTP status of the response, 0 if there was none.
+     */
+    void recordRequest(Request request, CURL *curl, CURLcode code, long httpCode);
+
+    void recordDedup(bool hit);
+    void recordEcho();
+    void recordMediaCacheHit();
+    void recordPost(const std::string &linkId, bool success, std::chrono::microseconds elapsed);
+    void recordRetry(const std::string &linkId);
+    void recordReceived(const std::string &linkId, std::size_t items);
+    void setQueueDepth(const std::string &linkId, std::size_t depth);
+    void removeLink(const std::string &linkId);
+
+    /**
+     * @brief Returns everything recorded since the previous call and starts a new interval.
+     * Queue depths are current values and carry over.
+     */
+    Snapshot collect();
+
+private:
+    mutable std::mutex mutex;
+    Snapshot current;
+    std::chrono::steady_clock::time_point intervalStart;
+};
+
+// Summarizes a snapshot, with times in milliseconds. Endpoints without requests are left out.
+void to_json(nlohmann::json &destJson, const Metrics::Snapshot &snapshot);
+
+#endif  // __COMMS_MASTODON_TRANSPORT_METRICS_H__
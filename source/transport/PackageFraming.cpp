@@ -0,0 +1,83 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PackageFraming.h"
+
+namespace framing {
+
+static const char marker = '~';
+static const char separator = ':';
+
+std::size_t frameSize(std::size_t packageSize) {
+    return std::to_string(packageSize).size() + 1 + packageSize;
+}
+
+std::string frame(const std::vector<std::string_view> &packages) {
+    std::size_t size = emptySize;
+    for (auto package : packages) {
+        size += frameSize(package.size());
+    }
+
+    std::string text;
+    text.reserve(size);
+    text += marker;
+    for (auto package : packages) {
+        text.append(std::to_string(package.size())).append(1, separator).append(package);
+    }
+    return text;
+}
+
+std::string single(std::string_view package) {
+    std::string text;
+    if (!package.empty() && package.front() == marker) {
+        text.reserve(escapeSize + package.size());
+        text += marker;
+    }
+    text.append(package);
+    return text;
+}
+
+bool unframe(std::string_view text, std::vector<std::string_view> &packages) {
+    packages.clear();
+    if (text.size() < 2 || text.front() != marker) {
+        return false;
+    }
+    if (text[1] == marker) {
+        packages.push_back(text.substr(1));
+        return true;
+    }
+
+    std::size_t pos = 1;
+    while (pos < text.size()) {
+        std::size_t length = 0;
+        std::size_t digits = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && digits < 10) {
+            length = length * 10 + static_cast<std::size_t>(text[pos] - '0');
+            ++pos;
+            ++digits;
+        }
+        if (digits == 0 || pos >= text.size() || text[pos] != separator || text.size() - pos - 1 < length) {
+            packages.clear();
+            return false;
+        }
+        ++pos;
+        packages.push_back(text.substr(pos, length));
+        pos += length;
+    }
+    return !packages.empty();
+}
+
+}  // namespace framing
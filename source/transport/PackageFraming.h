@@ -0,0 +1,63 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_PACKAGE_FRAMING_H__
+#define __COMMS_MASTODON_TRANSPORT_PACKAGE_FRAMING_H__
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Framing of several text packages into the text of one status.
+ *
+ * A framed status is a '~' followed by each package as its decimal length, a ':' and its
+ * bytes, e.g. "~5:hello3:abc". A status holding a single package is posted as the package
+ * itself, unless it starts with '~', in which case another '~' is put in front of it, e.g.
+ * "~~5:ab". A framed status never has a second '~', so each kind of status is told apart
+ * whatever the encoding of its packages. Digits and the two markers pass through Mastodon's
+ * rendering of status text unchanged.
+ */
+namespace framing {
+
+// Characters a package of the given size adds to a framed status
+std::size_t frameSize(std::size_t packageSize);
+
+// Characters a framed status of no packages takes, which is the leading marker
+constexpr std::size_t emptySize = 1;
+
+// Characters a single package may add when it is escaped
+constexpr std::size_t escapeSize = 1;
+
+std::string frame(const std::vector<std::string_view> &packages);
+
+// The text of a status holding just one package
+std::string single(std::string_view package);
+
+/**
+ * @brief Splits a framed or escaped status back into its packages.
+ *
+ * @param text The status text.
+ * @param packages Set to views into text, one per package.
+ * @return false if the text is neither a well-formed framed status nor an escaped package,
+ *         in which case it is a single package.
+ */
+bool unframe(std::string_view text, std::vector<std::string_view> &packages);
+
+}  // namespace framing
+
+#endif  // __COMMS_MASTODON_TRANSPORT_PACKAGE_FRAMING_H__
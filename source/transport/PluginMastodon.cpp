@@ -16,13 +16,20 @@
 
 #include "PluginMastodon.h"
 
+#include <algorithm>
 #include <chrono>
+#include <exception>
+#include <future>
+#include <limits>
 #include <nlohmann/json.hpp>
 
+#include "ActionTable.h"
 #include "JsonTypes.h"
 #include "Link.h"
 #include "LinkAddress.h"
 #include "MastodonClient.h"
+#include "MastodonClientPool.h"
+#include "MastodonConfig.h"
 #include "log.h"
 
 namespace std {
@@ -93,32 +100,83 @@ PluginMastodon::PluginMastodon(ITransportSdk *sdk):
         "Enter Mastodon API access token:",
         true
     ).handle;
+
+    optionsHandle = sdk->requestPluginUserInput(
+        "mastodonOptions",
+        "Enter optional Mastodon transport tuning options as JSON (leave empty for defaults):",
+        true
+    ).handle;
+}
+
+PluginMastodon::~PluginMastodon() {
+    // The workers, destroyed first, then run the failures the links queue
+    for (auto &entry : *links.getMap()) {
+        entry.second->shutdown();
+    }
 }
 
 ComponentStatus PluginMastodon::onUserInputReceived(RaceHandle handle, bool answered, const std::string &response) {
     TRACE_METHOD(handle, answered, response);
 
-    if (!answered) {
-        logDebug(logPrefix + "User input not answered for handle: " + std::to_string(handle));
+    if (handle == optionsHandle) {
+        // Tuning options are optional, fall back to the defaults if they are missing or invalid
+        optionsReceived = true;
+        if (answered && !response.empty()) {
+            try {
+                config = nlohmann::json::parse(response);
+                setDebugLogging(config.debugLogging);
+                LOG_DEBUG(logPrefix + "Mastodon options received: " + nlohmann::json(config).dump());
+            } catch (nlohmann::json::exception &err) {
+                logError(logPrefix + "Invalid mastodonOptions, using defaults: " + err.what());
+            }
+        }
+    } else if (!answered) {
+        LOG_DEBUG(logPrefix + "User input not answered for handle: " + std::to_string(handle));
         return COMPONENT_ERROR;
-    }
-
-    if (handle == mastodonServerHandle) {
+    } else if (handle == mastodonServerHandle) {
         mastodonServer = response;
         serverReceived = true;
-        logDebug(logPrefix + "Mastodon server received: " + mastodonServer);
+        LOG_DEBUG(logPrefix + "Mastodon server received: " + mastodonServer);
     } else if (handle == accessTokenHandle) {
         accessToken = response;
         tokenReceived = true;
-        logDebug(logPrefix + "Access token received.");
+        LOG_DEBUG(logPrefix + "Access token received.");
     } else {
         logError(logPrefix + "Unexpected handle received: " + std::to_string(handle));
         return COMPONENT_ERROR;
     }
 
-    if (serverReceived && tokenReceived && !mastodonClient) {
-        logDebug(logPrefix + "Initializing MastodonClient with server: " + mastodonServer);
-        mastodonClient = std::make_unique<MastodonClient>(mastodonServer, accessToken);
+    if (serverReceived && tokenReceived && optionsReceived && !clients) {
+        LOG_DEBUG(logPrefix + "Initializing MastodonClient with server: " + mastodonServer + " and " +
+                 std::to_string(config.accounts.size()) + " more accounts");
+        std::vector<MastodonAccount> accounts = {{mastodonServer, accessToken}};
+        accounts.insert(accounts.end(), config.accounts.begin(), config.accounts.end());
+        clients = std::make_unique<MastodonClientPool>(accounts, sdk, config);
+        fetchWorkers = std::make_unique<WorkerPool>(std::max<std::size_t>(1, accounts.size() - 1));
+        workers = std::make_unique<WorkerPool>(static_cast<std::size_t>(config.workerThreads));
+        scheduleMetricsReport();
+        // The limits size the mtu reported for each link. They are read on the workers, one strand
+        // per account, so that startup does not wait on the servers; until they arrive links
+        // report the channel's mtu.
+        const auto &accountClients = clients->getClients();
+        for (std::size_t i = 0; i < accountClients.size(); ++i) {
+            MastodonClient *client = accountClients[i].get();
+            workers->post("instance " + std::to_string(i), [client] { client->fetchInstanceLimits(); });
+        }
+        if (config.streaming) {
+            for (auto &client : clients->getClients()) {
+                client->startStreaming(
+                    [this](const std::string &hashtag, std::vector<MastodonContent> results) {
+                        onStreamedContent(hashtag, results);
+                    });
+            }
+        }
+        if (config.adaptivePolling) {
+            poller = std::make_unique<PollScheduler>(std::chrono::milliseconds(config.pollMinIntervalMs),
+                                                     std::chrono::milliseconds(config.pollMaxIntervalMs),
+                                                     config.pollRequestsPerMinute);
+            schedulePoll(std::chrono::milliseconds(config.pollMinIntervalMs));
+        }
         sdk->updateState(COMPONENT_STATE_STARTED);
     }
 
@@ -144,16 +202,62 @@ TransportProperties PluginMastodon::getTransportProperties() {
     };
 }
 
+/**
+ * @brief Lowers the expected performance of one direction of a link to what the server's
+ * remaining rate limit budget allows.
+ *
+ * @param propertySet The expected send or receive properties to adjust.
+ * @param budget The budget of the endpoint class used for that direction.
+ * @param bytesPerRequest The most content a single request can carry.
+ */
+static void applyRateBudget(LinkPropertySet &propertySet, const RateLimiter::Budget &budget,
+                            int64_t bytesPerRequest) {
+    if (!budget.known || budget.untilReset.count() <= 0) {
+        return;
+    }
+
+    if (budget.remaining <= 0) {
+        // Nothing can be sent until the window resets
+        int waitMs = static_cast<int>(budget.untilReset.count());
+        propertySet.latency_ms = std::max(propertySet.latency_ms, waitMs);
+        return;
+    }
+
+    if (bytesPerRequest > 0) {
+        int64_t bps = budget.remaining * bytesPerRequest * 8 * 1000 / budget.untilReset.count();
+        // Just before a reset the budget spread over a few milliseconds exceeds an int
+        bps = std::min<int64_t>(bps, std::numeric_limits<int>::max());
+        if (propertySet.bandwidth_bps < 0 || bps < propertySet.bandwidth_bps) {
+            propertySet.bandwidth_bps = static_cast<int>(bps);
+        }
+    }
+}
+
 /**
  * Retrieves the properties of a specific link identified by the given LinkID.
  *
+ * The expected bandwidth and latency are capped by the rate limit budget the server has
+ * reported to the account the link currently uses: posting is limited by the statuses
+ * budget, fetching by the timelines budget.
+ *
  * @param linkId The identifier of the link whose properties are to be retrieved.
  * @return A LinkProperties object containing the properties of the specified link.
  * @throws std::exception If the linkId does not exist or the properties cannot be retrieved.
  */
 LinkProperties PluginMastodon::getLinkProperties(const LinkID &linkId) {
     TRACE_METHOD(linkId);
-    return links.get(linkId)->getProperties();
+    auto link = links.get(linkId);
+    LinkProperties properties = link->getProperties();
+    if (clients) {
+        // One status per post, and up to one full page of statuses per timeline request
+        applyRateBudget(properties.expected.send,
+                        link->getClient(RateLimiter::STATUSES)->getRateBudget(RateLimiter::STATUSES),
+                        properties.mtu);
+        applyRateBudget(properties.expected.receive,
+                        link->getClient(RateLimiter::TIMELINES)->getRateBudget(RateLimiter::TIMELINES),
+                        static_cast<int64_t>(properties.mtu) * 40);
+    }
+    return properties;
 }
 
 /**
@@ -226,6 +330,7 @@ ComponentStatus PluginMastodon::postLinkCreate(const std::string &logPrefix,
     }
 
     links.add(link);
+    link->getHomeClient()->subscribe(link->getHashtag());
     sdk->onLinkStatusChanged(handle, linkId, linkStatus, {});
 
     return COMPONENT_OK;
@@ -245,7 +350,12 @@ ComponentStatus PluginMastodon::postLinkCreate(const std::string &logPrefix,
  */
 std::shared_ptr<Link> PluginMastodon::createLinkInstance(
     const LinkID &linkId, const LinkAddress &address, const LinkProperties &properties) {
-    auto link = std::make_shared<Link>(linkId, address, properties, sdk, mastodonClient.get());
+    if (!clients->hasServer(address.server)) {
+        logWarning("PluginMastodon::createLinkInstance: no account on " + address.server + " for link " + linkId +
+                   ", using the default server");
+    }
+    auto link = std::make_shared<Link>(linkId, address, properties, sdk, clients.get(),
+                                       workers.get());
     link->start();
     return link;
 }
@@ -277,10 +387,11 @@ ComponentStatus PluginMastodon::createLink(RaceHandle handle, const LinkID &link
 
     LinkAddress address;
     address.hashtag = "pqrstuv" + std::to_string(nextAvailableHashTag++);
+    address.server = clients->placeLink("#" + address.hashtag);
     std::chrono::duration<double> sinceEpoch = std::chrono::high_resolution_clock::now().time_since_epoch();
     address.timestamp = sinceEpoch.count();
 
-    logDebug(logPrefix + "Generated link address: " + address.hashtag + ", timestamp: " + std::to_string(address.timestamp));
+    LOG_DEBUG(logPrefix + "Generated link address: " + address.hashtag + ", timestamp: " + std::to_string(address.timestamp));
 
     LinkProperties properties = defaultLinkProperties;
     auto link = createLinkInstance(linkId, address, properties);
@@ -307,9 +418,9 @@ ComponentStatus PluginMastodon::loadLinkAddress(RaceHandle handle, const LinkID
         return COMPONENT_OK;
     }
 
-    logDebug(logPrefix + "Parsing link address: " + linkAddress);
+    LOG_DEBUG(logPrefix + "Parsing link address: " + linkAddress);
     LinkAddress address = nlohmann::json::parse(linkAddress);
-    logDebug(logPrefix + "Parsed link address: hashtag=" + address.hashtag +
+    LOG_DEBUG(logPrefix + "Parsed link address: hashtag=" + address.hashtag +
              ", maxTries=" + std::to_string(address.maxTries) +
              ", timestamp=" + std::to_string(address.timestamp));
 
@@ -391,6 +502,7 @@ ComponentStatus PluginMastodon::destroyLink(RaceHandle handle,
         return COMPONENT_ERROR;
     }
 
+    link->getHomeClient()->unsubscribe(link->getHashtag());
     link->shutdown();
 
     return COMPONENT_OK;
@@ -415,7 +527,9 @@ ComponentStatus PluginMastodon::destroyLink(RaceHandle handle,
  * Possible action types:
  * - ACTION_FETCH: Returns an empty vector.
  * - ACTION_POST: Returns a vector with encoding parameters including the link ID,
- *   content type, and other relevant details.
+ *   content type, and other relevant details. An "images" count in the action JSON asks
+ *   for that many image fragments, all attached to one status, up to the number of
+ *   attachments the server allows.
  *
  * Error Handling:
  * - Logs an error if the action type is unrecognized.
@@ -435,45 +549,45 @@ std::vector<EncodingParameters> PluginMastodon::getActionParams(
 
         auto actionJson = nlohmann::json::parse(action.json);
         ActionJson actionParams = actionJson;
-        std::string contentType = "text/plain"; // Default to text
-        
+        bool withText = true;  // Default to text
+        bool withImages = false;
+
         // Check for content type hints in the action JSON
         if (actionJson.contains("contentType")) {
             std::string typeHint = actionJson["contentType"].get<std::string>();
             if (typeHint == "image" || typeHint == "jpg" || typeHint == "jpeg") {
-                contentType = "image/jpeg";
-                logDebug(logPrefix + "Detected image content type from action JSON");
+                withText = false;
+                withImages = true;
+                LOG_DEBUG(logPrefix + "Detected image content type from action JSON");
             } else if (typeHint == "text") {
-                contentType = "text/plain";
-                logDebug(logPrefix + "Detected text content type from action JSON");
+                LOG_DEBUG(logPrefix + "Detected text content type from action JSON");
             } else if (typeHint == "mixed" || typeHint == "text+image") {
-                // Support both text and image in a single post
-                // IMPORTANT: Order matters for message fragmentation!
-                // Text must be first, image second - this order must match fetch() ordering
-                logDebug(logPrefix + "Detected mixed content type from action JSON");
-                switch (actionParams.type) {
-                    case ACTION_FETCH:
-                        return {};
-                    case ACTION_POST:
-                        logDebug(logPrefix + "Returning encoding parameters for both text and image");
-                        return {
-                            {actionParams.linkId, "text/plain", true, {}},   // Fragment 0: text
-                            {actionParams.linkId, "image/jpeg", true, {}}    // Fragment 1: image
-                        };
-                    default:
-                        logError(logPrefix +
-                                 "Unrecognized action type: " + nlohmann::json(actionParams.type).dump());
-                        break;
-                }
+                // Support both text and images in a single post
+                withImages = true;
+                LOG_DEBUG(logPrefix + "Detected mixed content type from action JSON");
             }
         }
-        
+
         switch (actionParams.type) {
             case ACTION_FETCH:
                 return {};
-            case ACTION_POST:
-                logDebug(logPrefix + "Returning encoding parameters with content type: " + contentType);
-                return {{actionParams.linkId, contentType, true, {}}};
+            case ACTION_POST: {
+                // IMPORTANT: Order matters for message fragmentation!
+                // Text must be first, images second - this order must match fetch() ordering
+                std::vector<EncodingParameters> params;
+                if (withText) {
+                    params.push_back({actionParams.linkId, "text/plain", true, encodingJson(actionParams.linkId, "text/plain")});
+                }
+                if (withImages) {
+                    int images = imagesPerPost(actionParams.linkId, actionJson.value("images", 1));
+                    std::string imageJson = encodingJson(actionParams.linkId, "image/jpeg");
+                    for (int i = 0; i < images; ++i) {
+                        params.push_back({actionParams.linkId, "image/jpeg", true, imageJson});
+                    }
+                }
+                LOG_DEBUG(logPrefix + "Returning " + std::to_string(params.size()) + " encoding parameters");
+                return params;
+            }
             default:
                 logError(logPrefix +
                          "Unrecognized action type: " + nlohmann::json(actionParams.type).dump());
@@ -489,6 +603,51 @@ std::vector<EncodingParameters> PluginMastodon::getActionParams(
     return {};
 }
 
+/**
+ * @brief Describes to the encoder how much content of a type one post on a link can carry.
+ *
+ * Text is limited by the characters the link's server allows in a status less the hashtag,
+ * images by the server's upload size limit.
+ *
+ * @param linkId The link the content is for.
+ * @param contentType The MIME type the encoder produces.
+ * @return The encoding parameters JSON, e.g. {"maxBytes":470}, or an empty object if the
+ *         link is unknown.
+ */
+std::string PluginMastodon::encodingJson(const LinkID &linkId, const std::string &contentType) {
+    std::shared_ptr<Link> link;
+    try {
+        link = links.get(linkId);
+    } catch (std::out_of_range &) {
+        return "{}";
+    }
+
+    EncodingParamsJson params;
+    params.maxBytes = contentType == "image/jpeg" ?
+                          static_cast<int>(std::min<int64_t>(link->getHomeClient()->getInstanceLimits().imageSizeLimit,
+                                                             std::numeric_limits<int>::max())) :
+                          static_cast<int>(link->getStatusRoom());
+    return nlohmann::json(params).dump();
+}
+
+/**
+ * @brief The number of images a post action asks for, limited to the attachments the link's
+ * server allows on one status.
+ *
+ * @param linkId The link the action posts on.
+ * @param requested The "images" count of the action JSON.
+ * @return At least one image.
+ */
+int PluginMastodon::imagesPerPost(const LinkID &linkId, int requested) {
+    int maxImages = InstanceLimits().maxMediaAttachments;
+    try {
+        maxImages = links.get(linkId)->getHomeClient()->getInstanceLimits().maxMediaAttachments;
+    } catch (std::out_of_range &) {
+        // Content for an unknown link is rejected when it is enqueued
+    }
+    return std::max(1, std::min(requested, maxImages));
+}
+
 /**
  * @brief Enqueues content for processing based on the specified action and encoding parameters.
  * 
@@ -512,7 +671,7 @@ ComponentStatus PluginMastodon::enqueueContent(
     TRACE_METHOD(params.linkId, action.actionId, action.json, content.size());
 
     if (content.empty()) {
-        logDebug(logPrefix + "Skipping enqueue content. Content size is 0.");
+        LOG_DEBUG(logPrefix + "Skipping enqueue content. Content size is 0.");
         return COMPONENT_OK;
     }
 
@@ -522,34 +681,33 @@ ComponentStatus PluginMastodon::enqueueContent(
             return COMPONENT_ERROR;
         }
 
-        logDebug(logPrefix + "Parsing action JSON: " + action.json);
+        LOG_DEBUG(logPrefix + "Parsing action JSON: " + action.json);
         auto actionJson = nlohmann::json::parse(action.json);
         ActionJson actionParams = actionJson;
 
         LinkID linkId = params.linkId;
         // Special case: we have "background" content that has no data, so we do not care which link we send it on
         if (params.linkId == "") {
-                    logDebug(logPrefix + "Link ID is empty for POST action. Using first available link.");
-                    if (links.size() == 0) {
+                    LOG_DEBUG(logPrefix + "Link ID is empty for POST action. Using first available link.");
+                    LinkMap::Snapshot linkMap = links.getMap();
+                    if (linkMap->empty()) {
                         logError(logPrefix + "No links available to enqueue content. Doing nothing.");
                         return COMPONENT_ERROR;
                     }
-                    auto firstLink = links.getMap().begin()->second;
+                    auto firstLink = linkMap->begin()->second;
                     linkId = firstLink->getId();
         }
-        actionToLinkIdMap[action.actionId] = linkId;
-        
-        // Store content type information for this action
-        contentTypeMap[action.actionId] = params.type;
-        logDebug(logPrefix + "Stored content type '" + params.type + "' for action ID: " + std::to_string(action.actionId));
+        // Store the link and content type information for this action
+        actions.record(action.actionId, linkId, params.type);
+        LOG_DEBUG(logPrefix + "Stored content type '" + params.type + "' for action ID: " + std::to_string(action.actionId));
         
         switch (actionParams.type) {
             case ACTION_FETCH:
-                logDebug(logPrefix + "Action type is FETCH. No content to enqueue.");
+                LOG_DEBUG(logPrefix + "Action type is FETCH. No content to enqueue.");
                 return COMPONENT_OK;
 
             case ACTION_POST:
-                logDebug(logPrefix + "Action type is POST. Enqueuing content for link ID: " + linkId);
+                LOG_DEBUG(logPrefix + "Action type is POST. Enqueuing content for link ID: " + linkId);
                 return links.get(linkId)->enqueueContent(action.actionId, content, params.type);
 
             default:
@@ -590,13 +748,15 @@ ComponentStatus PluginMastodon::dequeueContent(const Action &action) {
         auto actionJson = nlohmann::json::parse(action.json);
         ActionJson actionParams = actionJson;
         
-        LinkID linkId = actionParams.linkId == "*" ? actionToLinkIdMap.at(action.actionId) :
-                                                     actionParams.linkId;
-        actionToLinkIdMap.erase(action.actionId);
-        
-        // Clean up content type tracking
-        contentTypeMap.erase(action.actionId);
-        
+        // Clean up the action's tracking, which also gives the link of a wildcard action
+        ActionTable::Entry entry;
+        bool enqueued = actions.take(action.actionId, entry);
+        if (actionParams.linkId == "*" && !enqueued) {
+            logError(logPrefix + "No link known for wildcard action ID: " + std::to_string(action.actionId));
+            return COMPONENT_ERROR;
+        }
+        LinkID linkId = actionParams.linkId == "*" ? entry.linkId : actionParams.linkId;
+
         switch (actionParams.type) {
             case ACTION_POST:
                 return links.get(linkId)->dequeueContent(action.actionId);
@@ -618,16 +778,20 @@ ComponentStatus PluginMastodon::dequeueContent(const Action &action) {
  * @param handles A vector of RaceHandles representing message send calls associated with content enqueued for the action. If the action succeeds, they are considered SENT, if it fails they are FAILED and requeued for sending by Raceboat.ACTION_FETCH
  * @param action The Action object containing details about the operation to perform.
  *               Includes an action ID, JSON parameters, and type.
- * @return ComponentStatus indicating the result of the operation:
- *         - COMPONENT_OK: Operation succeeded.
- *         - COMPONENT_ERROR: Operation encountered a non-fatal error.
- *         - COMPONENT_FATAL: Operation encountered a fatal error.
+ * @return ComponentStatus indicating whether the operation was accepted:
+ *         - COMPONENT_OK: Operation was queued, or skipped because there was nothing to do.
+ *         - COMPONENT_ERROR: Operation was invalid.
+ *
+ * Posts and fetches run on the worker pool and this method returns as soon as they are
+ * queued. Results are reported through onPackageStatusChanged and onReceive. Actions on
+ * the same link run in the order they were requested, actions on different links run in
+ * parallel. A fatal error from a queued action moves the component to the failed state.
  *
  * The function supports two types of actions:
  * - ACTION_FETCH: Fetches data from one or more links. If the link ID is "*", it fetches
  *   data from all links. Otherwise, it fetches data from the specified link.
  * - ACTION_POST: Posts data to a specific link. If the link ID is "*", it attempts to
- *   retrieve the link ID from the actionToLinkIdMap. If no link exists for the wildcard
+ *   retrieve the link ID from the action table. If no link exists for the wildcard
  *   action, the operation is skipped.
  *
  * If an unrecognized action type is provided, an error is logged and COMPONENT_ERROR is returned.
@@ -650,54 +814,46 @@ ComponentStatus PluginMastodon::doAction(const std::vector<RaceHandle> &handles,
 
         switch (actionParams.type) {
             case ACTION_FETCH:
-                // this map shouldn't contain anything in the fetch case, but just in case, erase it
-                actionToLinkIdMap.erase(action.actionId);
-                contentTypeMap.erase(action.actionId);
-
-                // This exemplar treats wildcard fetches as a fetch on EVERY link
-                // Real transports which do NOT "fetch" for all links in a single action
-                // (e.g. checking multiple subforums) may need to round-robin fetch for
-                // a single link at a time
+                // the table shouldn't contain anything in the fetch case, but just in case, erase it
+                actions.erase(action.actionId);
+
+                // This exemplar treats wildcard fetches as a fetch on EVERY link. The
+                // timelines of all links are read in one parallel batch and the results are
+                // demultiplexed back to the links by hashtag. With adaptive polling, links the
+                // poller does not find due are skipped.
                 if (actionParams.linkId == "*") {
-                    ComponentStatus status = COMPONENT_OK;
                     logInfo(logPrefix + "Fetching from all links");
-                    auto linkMap = links.getMap();
-                    logInfo(logPrefix + "links: " + std::to_string(linkMap.size()));
-                    for (auto &link : linkMap) {
-                        logInfo(logPrefix + "Fetching from link " + link.first);
-                        ComponentStatus thisStatus = link.second->fetch();
-                        if (thisStatus == COMPONENT_FATAL) {
-                            return COMPONENT_FATAL;
-                        } else if (thisStatus != COMPONENT_OK) {
-                            // propagate error status, but continue because it's not fatal
-                            status = thisStatus;
-                        }
-                    }
-                    return status;
+                    LinkMap::Snapshot linkMap = links.getMap();
+                    logInfo(logPrefix + "links: " + std::to_string(linkMap->size()));
+                    runAction(linkId, [this, linkMap] { return fetchAll(*linkMap); });
                 } else {
                     logInfo(logPrefix + "Fetching from single link");
-                    return links.get(linkId)->fetch();
+                    auto link = links.get(linkId);
+                    runAction(linkId, [link] { return link->fetch(); });
                 }
+                return COMPONENT_OK;
 
-            case ACTION_POST:
+            case ACTION_POST: {
+                // Clean up the action's tracking, which also gives the link of a wildcard action
+                ActionTable::Entry entry;
+                bool enqueued = actions.take(action.actionId, entry);
                 if (linkId == "*") {
-                    auto it = actionToLinkIdMap.find(action.actionId);
-                    if (it == actionToLinkIdMap.end()) {
+                    if (!enqueued) {
                         logInfo(logPrefix +
                                 "Skipping action because no link exists for wildcard action");
-                        contentTypeMap.erase(action.actionId);
                         return COMPONENT_OK;
-                    } else {
-                        linkId = it->second;
                     }
+                    linkId = entry.linkId;
                 }
-                
-                // Clean up tracking maps
-                actionToLinkIdMap.erase(action.actionId);
-                contentTypeMap.erase(action.actionId);
-                
+
                 // Post the content (Link will determine content type from queued data)
-                return links.get(linkId)->post(std::move(handles), action.actionId);
+                {
+                    auto link = links.get(linkId);
+                    uint64_t actionId = action.actionId;
+                    runAction(linkId, [link, handles, actionId] { return link->post(handles, actionId); });
+                }
+                return COMPONENT_OK;
+            }
 
             default:
                 logError(logPrefix +
@@ -711,6 +867,225 @@ ComponentStatus PluginMastodon::doAction(const std::vector<RaceHandle> &handles,
     return COMPONENT_ERROR;
 }
 
+/**
+ * @brief Queues an action on the worker pool.
+ *
+ * @param strand The link ID the action belongs to, or "*" for wildcard fetches.
+ * @param action The action to run.
+ */
+void PluginMastodon::runAction(const std::string &strand,
+                               std::function<ComponentStatus()> action) {
+    workers->post(strand, [this, strand, action = std::move(action)] {
+        TRACE_METHOD(strand);
+        ComponentStatus status = action();
+        if (status == COMPONENT_FATAL) {
+            logError(logPrefix + "action failed fatally");
+            sdk->updateState(COMPONENT_STATE_FAILED);
+        } else if (status != COMPONENT_OK) {
+            logWarning(logPrefix + "action failed");
+        }
+    });
+}
+
+void PluginMastodon::setMetricsSink(Metrics::Sink sink) {
+    metricsSink = std::move(sink);
+}
+
+/**
+ * @brief Reports the metrics collected since the last report to the sink once the interval
+ * has passed, then schedules the next report.
+ */
+void PluginMastodon::scheduleMetricsReport() {
+    if (config.metricsIntervalSeconds <= 0) {
+        return;
+    }
+    workers->postAfter("metrics", std::chrono::seconds(config.metricsIntervalSeconds), [this] {
+        Metrics::Snapshot snapshot = clients->getMetrics().collect();
+        if (metricsSink) {
+            metricsSink(snapshot);
+        } else {
+            logInfo("PluginMastodon::metrics: " + nlohmann::json(snapshot).dump());
+        }
+        scheduleMetricsReport();
+    });
+}
+
+/**
+ * @brief Polls the links whose hashtags are due, then schedules the next poll.
+ *
+ * Polls run on the strand of wildcard fetches so that the two never search a timeline at the
+ * same time.
+ */
+void PluginMastodon::schedulePoll(std::chrono::milliseconds delay) {
+    workers->postAfter("*", delay, [this] {
+        // Polling stops only on a fatal error. The hashtags of a poll that throws were taken
+        // from the poller without being recorded, so they are handed back to be polled again
+        // after the minimum interval.
+        try {
+            LinkMap::Snapshot linkMap = links.getMap();
+            if (fetchAll(*linkMap) == COMPONENT_FATAL) {
+                logError("PluginMastodon::schedulePoll: poll failed fatally");
+                sdk->updateState(COMPONENT_STATE_FAILED);
+                return;
+            }
+        } catch (std::exception &err) {
+            logError(std::string("PluginMastodon::schedulePoll: poll failed: ") + err.what());
+            poller->returnUnrecorded(PollScheduler::Clock::now());
+        } catch (...) {
+            logError("PluginMastodon::schedulePoll: poll failed with an unknown exception");
+            poller->returnUnrecorded(PollScheduler::Clock::now());
+        }
+        schedulePoll(poller->untilNextPoll(PollScheduler::Clock::now()));
+    });
+}
+
+/**
+ * @brief Fetches new content for a set of links with one batched search per account.
+ *
+ * Links that share a hashtag are searched once and all receive the results. The searches of
+ * different accounts run in parallel. With adaptive polling, only the hashtags the poller
+ * finds due are searched. If a search throws, the results of the others are delivered before
+ * its exception is rethrown.
+ *
+ * @param linkMap The links to fetch for.
+ * @return COMPONENT_FATAL if any link reported a fatal error, COMPONENT_ERROR if any link
+ *         reported a non-fatal error, COMPONENT_OK otherwise.
+ */
+ComponentStatus PluginMastodon::fetchAll(const LinkMap::Map &linkMap) {
+    TRACE_METHOD(linkMap.size());
+
+    // The hashtags each account searches, and the links of each hashtag
+    struct Batch {
+        MastodonClient *client;
+        std::vector<std::string> hashtags;
+        std::vector<std::vector<MastodonContent>> results;
+        std::chrono::microseconds elapsed{0};
+        std::exception_ptr failure;
+    };
+    std::vector<Batch> batches;
+    std::vector<std::string> hashtags;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Link>>> linksByHashtag;
+    for (auto &link : linkMap) {
+        const std::string &hashtag = link.second->getHashtag();
+        if (!link.second->getHomeClient()->needsPoll(hashtag)) {
+            // Caught up through the stream
+            continue;
+        }
+        auto &hashtagLinks = linksByHashtag[hashtag];
+        if (hashtagLinks.empty()) {
+            hashtags.push_back(hashtag);
+        }
+        hashtagLinks.push_back(link.second);
+    }
+    if (poller) {
+        hashtags = poller->takeDue(hashtags, PollScheduler::Clock::now());
+    }
+    for (auto &hashtag : hashtags) {
+        MastodonClient *client = linksByHashtag[hashtag].front()->getClient(RateLimiter::TIMELINES);
+        auto batch = std::find_if(batches.begin(), batches.end(),
+                                  [client](const Batch &batch) { return batch.client == client; });
+        if (batch == batches.end()) {
+            batch = batches.insert(batches.end(), Batch{client, {}, {}, {}});
+        }
+        batch->hashtags.push_back(hashtag);
+    }
+
+    // The first batch runs on this thread, the others on the fetch pool alongside it. A batch
+    // that throws keeps its exception, so that the batches that succeeded are still delivered.
+    auto search = [](Batch &batch) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            batch.results = batch.client->searchStatusesBatch(batch.hashtags);
+        } catch (...) {
+            batch.failure = std::current_exception();
+        }
+        batch.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    };
+    std::vector<std::future<void>> searches;
+    for (size_t i = 1; i < batches.size(); ++i) {
+        Batch *batch = &batches[i];
+        auto done = std::make_shared<std::promise<void>>();
+        searches.push_back(done->get_future());
+        fetchWorkers->post("search " + std::to_string(i), [search, batch, done] {
+            search(*batch);
+            done->set_value();
+        });
+    }
+    if (!batches.empty()) {
+        search(batches.front());
+    }
+    // The other searches write into batches, so every one is waited for before reading them
+    for (auto &pending : searches) {
+        pending.wait();
+    }
+
+    // The searches that succeeded have already moved their cursors and marked their statuses
+    // seen, so their results are delivered even if another batch failed
+    ComponentStatus status = COMPONENT_OK;
+    std::exception_ptr failure;
+    auto polled = PollScheduler::Clock::now();
+    for (auto &batch : batches) {
+        if (batch.failure) {
+            if (!failure) {
+                failure = batch.failure;
+            }
+            continue;
+        }
+        for (size_t i = 0; i < batch.hashtags.size(); ++i) {
+            if (poller) {
+                poller->recordPoll(batch.hashtags[i], batch.results[i].size(), polled);
+            }
+            auto &hashtagLinks = linksByHashtag[batch.hashtags[i]];
+            for (size_t j = 0; j < hashtagLinks.size(); ++j) {
+                logInfo(logPrefix + "Fetched " + std::to_string(batch.results[i].size()) +
+                        " items for link " + hashtagLinks[j]->getId());
+                hashtagLinks[j]->recordFetchTime(batch.elapsed);
+                // Links sharing a hashtag all read the same buffers
+                ComponentStatus thisStatus = hashtagLinks[j]->receive(batch.results[i]);
+                if (thisStatus == COMPONENT_FATAL) {
+                    return COMPONENT_FATAL;
+                } else if (thisStatus != COMPONENT_OK) {
+                    // propagate error status, but continue because it's not fatal
+                    status = thisStatus;
+                }
+            }
+        }
+    }
+    if (failure) {
+        // The failed batches' hashtags are polled again after the minimum interval
+        if (poller) {
+            poller->returnUnrecorded(PollScheduler::Clock::now());
+        }
+        std::rethrow_exception(failure);
+    }
+    return status;
+}
+
+/**
+ * @brief Delivers content pushed by a hashtag stream to every link on that hashtag.
+ *
+ * @param hashtag The hashtag the content was posted to.
+ * @param results The content of the new status.
+ */
+void PluginMastodon::onStreamedContent(const std::string &hashtag,
+                                       const std::vector<MastodonContent> &results) {
+    TRACE_METHOD(hashtag);
+
+    std::vector<std::shared_ptr<Link>> hashtagLinks;
+    LinkMap::Snapshot linkMap = links.getMap();
+    for (auto &link : *linkMap) {
+        if (link.second->getHashtag() == hashtag) {
+            hashtagLinks.push_back(link.second);
+        }
+    }
+
+    for (auto &link : hashtagLinks) {
+        logInfo(logPrefix + "Streamed " + std::to_string(results.size()) + " items for link " +
+                link->getId());
+        link->receive(results);
+    }
+}
+
 #ifndef TESTBUILD
 /**
  * @brief Creates a transport component based on the specified transport type.
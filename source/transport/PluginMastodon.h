@@ -25,12 +25,21 @@
 
 #include <algorithm>
 
+#include "ActionTable.h"
 #include "LinkMap.h"
+#include "MastodonClientPool.h"
+#include "MastodonConfig.h"
+#include "Metrics.h"
+#include "PollScheduler.h"
+#include "WorkerPool.h"
 
 class PluginMastodon : public ITransportComponent {
 public:
     explicit PluginMastodon(ITransportSdk *sdk);
 
+    // Shuts down the links left, so that posts they still hold are reported failed
+    virtual ~PluginMastodon() override;
+
     virtual ComponentStatus onUserInputReceived(RaceHandle handle, bool answered,
                                                 const std::string &response) override;
 
@@ -61,6 +70,12 @@ public:
     virtual ComponentStatus doAction(const std::vector<RaceHandle> &handles,
                                      const Action &action) override;
 
+    /**
+     * @brief Replaces where periodic metrics are reported, by default the SDK log. Must be
+     * called before the plugin is initialized.
+     */
+    void setMetricsSink(Metrics::Sink sink);
+
 protected:
     virtual std::shared_ptr<Link> createLinkInstance(const LinkID &linkId,
                                                      const LinkAddress &address,
@@ -73,24 +88,45 @@ private:
     LinkProperties defaultLinkProperties;
 
     LinkMap links;
-    std::unique_ptr<MastodonClient> mastodonClient;
+    std::unique_ptr<MastodonClientPool> clients;  // One client per account
 
     RaceHandle mastodonServerHandle;
     RaceHandle accessTokenHandle;
+    RaceHandle optionsHandle;
 
     bool serverReceived = false;
     bool tokenReceived = false;
+    bool optionsReceived = false;
 
     std::string mastodonServer;  // Stores the Mastodon server hostname
     std::string accessToken;     // Stores the Mastodon API access token
+    MastodonConfig config;       // Optional tuning parameters
+
+    ActionTable actions;  // Link and content type of each action with enqueued content
 
-    std::unordered_map<uint64_t, LinkID> actionToLinkIdMap;
-    std::unordered_map<uint64_t, std::string> contentTypeMap;  // Maps action ID to content type
+    std::unique_ptr<PollScheduler> poller;  // Set when config.adaptivePolling is on
 
     std::atomic<int64_t> nextAvailableHashTag{0};
 
+    Metrics::Sink metricsSink;
+
+    // Runs the searches of every account but the first while a fetch action waits on them.
+    // Separate from workers so that a fetch never waits on a task queued behind it.
+    std::unique_ptr<WorkerPool> fetchWorkers;
+
+    // Runs actions off the SDK thread. Declared last so queued actions finish before the
+    // client and links they use are destroyed.
+    std::unique_ptr<WorkerPool> workers;
+
     bool preLinkCreate(const std::string &logPrefix, RaceHandle handle, const LinkID &linkId,
                        LinkSide invalidRoleLinkSide);
+    ComponentStatus fetchAll(const LinkMap::Map &linkMap);
+    void runAction(const std::string &strand, std::function<ComponentStatus()> action);
+    void scheduleMetricsReport();
+    void schedulePoll(std::chrono::milliseconds delay);
+    void onStreamedContent(const std::string &hashtag, const std::vector<MastodonContent> &results);
+    std::string encodingJson(const LinkID &linkId, const std::string &contentType);
+    int imagesPerPost(const LinkID &linkId, int requested);
     ComponentStatus postLinkCreate(const std::string &logPrefix, RaceHandle handle,
                                    const LinkID &linkId, const std::shared_ptr<Link> &link,
                                    LinkStatus linkStatus);
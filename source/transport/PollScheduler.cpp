@@ -0,0 +1,143 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PollScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Time constant in seconds over which arrivals count towards the arrival rate
+static const double arrivalRateSeconds = 30;
+
+// Seconds of budget that may be spent at once, e.g. to poll every hashtag on startup
+static const double burstSeconds = 10;
+
+PollScheduler::PollScheduler(std::chrono::milliseconds minInterval,
+                             std::chrono::milliseconds maxInterval, int requestsPerMinute) :
+    minInterval(std::max(minInterval, std::chrono::milliseconds(1))),
+    maxInterval(std::max(maxInterval, this->minInterval)),
+    tokensPerMs(std::max(requestsPerMinute, 0) / 60000.0),
+    capacity(std::max(1.0, tokensPerMs * burstSeconds * 1000)),
+    tokens(capacity),
+    refilledAt(Clock::now()) {}
+
+std::vector<std::string> PollScheduler::takeDue(const std::vector<std::string> &candidates,
+                                                Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill(now);
+
+    std::map<std::string, Hashtag> current;
+    std::vector<std::map<std::string, Hashtag>::iterator> due;
+    for (auto &hashtag : candidates) {
+        auto iter = hashtags.find(hashtag);
+        auto inserted = current.emplace(hashtag, iter != hashtags.end() ? iter->second : Hashtag{{}, {}, minInterval});
+        if (inserted.second && inserted.first->second.dueAt <= now) {
+            due.push_back(inserted.first);
+        }
+    }
+    hashtags.swap(current);
+
+    // The busiest first, then the longest overdue
+    std::sort(due.begin(), due.end(), [](const auto &a, const auto &b) {
+        if (a->second.arrivalRate != b->second.arrivalRate) {
+            return a->second.arrivalRate > b->second.arrivalRate;
+        }
+        return a->second.dueAt < b->second.dueAt;
+    });
+    if (tokensPerMs > 0) {
+        due.resize(std::min(due.size(), static_cast<std::size_t>(tokens)));
+        tokens -= static_cast<double>(due.size());
+    }
+
+    std::vector<std::string> polled;
+    for (auto &iter : due) {
+        // Not due again until the poll has completed and been recorded
+        iter->second.dueAt = now + maxInterval;
+        iter->second.taken = true;
+        polled.push_back(iter->first);
+    }
+    return polled;
+}
+
+void PollScheduler::recordPoll(const std::string &hashtag, std::size_t arrivals,
+                               Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = hashtags.find(hashtag);
+    if (iter == hashtags.end()) {
+        return;
+    }
+    Hashtag &state = iter->second;
+
+    // Arrivals decay exponentially with age, wherever the polls fell in between
+    if (state.lastPolled != Clock::time_point()) {
+        double seconds = std::chrono::duration<double>(now - state.lastPolled).count();
+        state.arrivalRate *= std::exp(-seconds / arrivalRateSeconds);
+    }
+    state.arrivalRate += arrivals / arrivalRateSeconds;
+    state.lastPolled = now;
+    state.taken = false;
+
+    // A quiet hashtag backs off, but no further than the mean time between its arrivals,
+    // which stretches as the rate decays
+    std::chrono::milliseconds ceiling = maxInterval;
+    if (state.arrivalRate > 0) {
+        ceiling = std::min(ceiling, std::chrono::milliseconds(static_cast<int64_t>(1000 / state.arrivalRate)));
+    }
+    state.interval = arrivals > 0 ? minInterval : std::clamp(state.interval * 2, minInterval, std::max(ceiling, minInterval));
+    state.dueAt = now + state.interval;
+}
+
+void PollScheduler::returnUnrecorded(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &hashtag : hashtags) {
+        if (hashtag.second.taken) {
+            hashtag.second.taken = false;
+            hashtag.second.dueAt = now + minInterval;
+        }
+    }
+}
+
+std::chrono::milliseconds PollScheduler::untilNextPoll(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill(now);
+
+    // New hashtags are only seen by takeDue, so it is called at least every minimum interval
+    Clock::time_point next = now + minInterval;
+    for (auto &hashtag : hashtags) {
+        next = std::min(next, hashtag.second.dueAt);
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now);
+    if (tokensPerMs > 0 && tokens < 1) {
+        auto refillWait = std::chrono::milliseconds(static_cast<int64_t>((1 - tokens) / tokensPerMs) + 1);
+        wait = std::max(wait, refillWait);
+    }
+    return std::max(wait, std::chrono::milliseconds(0));
+}
+
+double PollScheduler::getArrivalRate(const std::string &hashtag) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = hashtags.find(hashtag);
+    return iter != hashtags.end() ? iter->second.arrivalRate : 0;
+}
+
+void PollScheduler::refill(Clock::time_point now) {
+    if (now <= refilledAt) {
+        return;
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - refilledAt).count();
+    tokens = std::min(capacity, tokens + elapsedMs * tokensPerMs);
+    refilledAt = now;
+}
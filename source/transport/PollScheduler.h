@@ -0,0 +1,117 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_POLL_SCHEDULER_H__
+#define __COMMS_MASTODON_TRANSPORT_POLL_SCHEDULER_H__
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Decides which hashtags are polled, so that busy hashtags are polled often and quiet
+ * ones back off, within a request budget shared by all of them.
+ *
+ * A hashtag is polled again after its interval. A poll that brings new statuses resets the
+ * interval to the minimum, an empty one doubles it up to the maximum. The doubling also stops
+ * at the mean time between arrivals, from a rate in which arrivals decay over half a minute,
+ * so a busy hashtag keeps being polled quickly through a short lull. Polls take a token from
+ * a bucket refilled at the budgeted rate. When more hashtags are due than there are tokens,
+ * the ones with the highest arrival rate go first and the others stay due. Thread-safe.
+ */
+class PollScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param minInterval Interval of a hashtag with new statuses on its last poll.
+     * @param maxInterval Longest a quiet hashtag goes without a poll, budget permitting.
+     * @param requestsPerMinute Polls allowed per minute over all hashtags, 0 for no limit.
+     */
+    PollScheduler(std::chrono::milliseconds minInterval, std::chrono::milliseconds maxInterval,
+                  int requestsPerMinute);
+
+    /**
+     * @brief Picks the hashtags to poll now out of the ones that can be, and charges them to
+     * the budget.
+     *
+     * Hashtags seen for the first time are due at once. Hashtags no longer passed in are
+     * forgotten, e.g. when their last link is destroyed or a stream covers them.
+     *
+     * @param hashtags Every hashtag that could be polled.
+     * @param now The current time.
+     * @return The hashtags to poll, most active first.
+     */
+    std::vector<std::string> takeDue(const std::vector<std::string> &hashtags, Clock::time_point now);
+
+    /**
+     * @brief Records a completed poll and schedules the next one.
+     *
+     * @param hashtag The hashtag polled.
+     * @param arrivals The number of new items the poll delivered.
+     * @param now The time the poll completed.
+     */
+    void recordPoll(const std::string &hashtag, std::size_t arrivals, Clock::time_point now);
+
+    /**
+     * @brief Makes the hashtags taken by takeDue but not yet passed to recordPoll due again
+     * after the minimum interval, e.g. when their poll threw before it could be recorded.
+     *
+     * The tokens they were charged are not refunded, as their requests may have reached the
+     * server before the poll failed.
+     *
+     * @param now The current time.
+     */
+    void returnUnrecorded(Clock::time_point now);
+
+    /**
+     * @brief How long to wait before calling takeDue again: until the next hashtag is due,
+     * or the budget has a token for it, but at most the minimum interval so that new hashtags
+     * are polled promptly.
+     */
+    std::chrono::milliseconds untilNextPoll(Clock::time_point now);
+
+    /**
+     * @brief The smoothed rate of new items on a hashtag in items per second, 0 if unknown.
+     */
+    double getArrivalRate(const std::string &hashtag) const;
+
+private:
+    struct Hashtag {
+        Clock::time_point dueAt;       // Time of the next poll, the epoch until the first one
+        Clock::time_point lastPolled;  // The epoch until the first poll
+        std::chrono::milliseconds interval;
+        double arrivalRate = 0;        // Items per second, arrivals decaying with age
+        bool taken = false;            // Returned by takeDue and not recorded since
+    };
+
+    // Adds the tokens earned since the last refill
+    void refill(Clock::time_point now);
+
+    const std::chrono::milliseconds minInterval;
+    const std::chrono::milliseconds maxInterval;
+    const double tokensPerMs;  // 0 for no limit
+    const double capacity;     // Largest burst of polls
+
+    mutable std::mutex mutex;
+    std::map<std::string, Hashtag> hashtags;
+    double tokens;
+    Clock::time_point refilledAt;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_POLL_SCHEDULER_H__
@@ -0,0 +1,143 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "log.h"
+
+// Below this fraction of the limit the remaining requests are spread over the window
+static const double paceBelowFraction = 0.25;
+
+// Waiting for a reset is re-checked at least this often in case the headers were wrong
+static const std::chrono::seconds maxWait{60};
+
+static const char *endpointName(RateLimiter::Endpoint endpoint) {
+    switch (endpoint) {
+        case RateLimiter::STATUSES:
+            return "statuses";
+        case RateLimiter::MEDIA:
+            return "media";
+        case RateLimiter::TIMELINES:
+            return "timelines";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief Parses the ISO 8601 timestamp of X-RateLimit-Reset, e.g. 2024-01-01T00:05:00.000Z,
+ * into a steady clock deadline.
+ */
+static bool parseResetTime(const std::string &value, std::chrono::steady_clock::time_point &resetAt) {
+    std::tm tm{};
+    if (strptime(value.c_str(), "%Y-%m-%dT%H:%M:%S", &tm) == nullptr) {
+        return false;
+    }
+    auto reset = std::chrono::system_clock::from_time_t(timegm(&tm));
+    resetAt = std::chrono::steady_clock::now() +
+              std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  reset - std::chrono::system_clock::now()) +
+              std::chrono::seconds(1);  // The timestamp is truncated to whole seconds
+    return true;
+}
+
+void RateLimiter::acquire(Endpoint endpoint) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Bucket &bucket = buckets[endpoint];
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        if (!bucket.known) {
+            return;
+        }
+        if (now >= bucket.resetAt) {
+            // A new window has started, assume the full limit until the server says otherwise.
+            // After a 429 without a limit header, one request is let through to learn it.
+            bucket.remaining = std::max(bucket.limit, 1);
+            bucket.resetAt = now + maxWait;
+        }
+
+        auto wakeAt = bucket.resetAt;
+        if (bucket.remaining > 0) {
+            if (now >= bucket.nextAllowed) {
+                --bucket.remaining;
+                if (bucket.remaining < bucket.limit * paceBelowFraction && bucket.remaining > 0) {
+                    bucket.nextAllowed = now + (bucket.resetAt - now) / (bucket.remaining + 1);
+                }
+                return;
+            }
+            wakeAt = bucket.nextAllowed;
+        } else {
+            LOG_DEBUG(std::string("RateLimiter::acquire: ") + endpointName(endpoint) +
+                     " budget exhausted, waiting for reset");
+        }
+        changed.wait_until(lock, std::min(wakeAt, now + maxWait));
+    }
+}
+
+void RateLimiter::update(Endpoint endpoint, const std::map<std::string, std::string> &headers,
+                         long httpCode) {
+    auto limit = headers.find("x-ratelimit-limit");
+    auto remaining = headers.find("x-ratelimit-remaining");
+    auto reset = headers.find("x-ratelimit-reset");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Bucket &bucket = buckets[endpoint];
+    try {
+        if (limit != headers.end()) {
+            bucket.limit = std::stoi(limit->second);
+            bucket.known = true;
+        }
+        if (remaining != headers.end()) {
+            bucket.remaining = std::stoi(remaining->second);
+        }
+    } catch (std::exception &e) {
+        logWarning(std::string("RateLimiter::update: invalid rate limit header: ") + e.what());
+    }
+    if (reset != headers.end() && !parseResetTime(reset->second, bucket.resetAt)) {
+        logWarning("RateLimiter::update: invalid reset time: " + reset->second);
+    }
+
+    if (httpCode == 429) {
+        logWarning(std::string("RateLimiter::update: rate limited on ") + endpointName(endpoint));
+        bucket.known = true;
+        bucket.remaining = 0;
+        if (reset == headers.end()) {
+            bucket.resetAt = std::chrono::steady_clock::now() + maxWait;
+        }
+    }
+
+    changed.notify_all();
+}
+
+RateLimiter::Budget RateLimiter::getBudget(Endpoint endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Bucket &bucket = buckets[endpoint];
+    Budget budget;
+    budget.known = bucket.known;
+    budget.limit = bucket.limit;
+    auto now = std::chrono::steady_clock::now();
+    if (now >= bucket.resetAt) {
+        budget.remaining = bucket.limit;
+    } else {
+        budget.remaining = bucket.remaining;
+        budget.untilReset =
+            std::chrono::duration_cast<std::chrono::milliseconds>(bucket.resetAt - now);
+    }
+    return budget;
+}
@@ -0,0 +1,80 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_RATE_LIMITER_H__
+#define __COMMS_MASTODON_TRANSPORT_RATE_LIMITER_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Paces requests to stay within the rate limits a Mastodon server advertises.
+ *
+ * Each endpoint class has a bucket whose limit, remaining count and reset time are taken
+ * from the X-RateLimit-Limit, X-RateLimit-Remaining and X-RateLimit-Reset headers of its
+ * responses. A request takes a token from its bucket before it is sent. Once the bucket is
+ * empty, requests wait for the reset instead of being rejected with 429. While the bucket is
+ * low, the remaining tokens are spread evenly over the rest of the window so a burst cannot
+ * drain it early. Until a server has answered, requests are not limited.
+ */
+class RateLimiter {
+public:
+    enum Endpoint { STATUSES, MEDIA, TIMELINES, NUM_ENDPOINTS };
+
+    struct Budget {
+        bool known = false;    // false until the server has reported a limit
+        int limit = 0;         // Requests allowed per window
+        int remaining = 0;     // Requests left in the current window
+        std::chrono::milliseconds untilReset{0};
+    };
+
+    /**
+     * @brief Waits until a request to the endpoint class may be sent and takes a token.
+     */
+    void acquire(Endpoint endpoint);
+
+    /**
+     * @brief Updates a bucket from the headers of a response.
+     *
+     * @param endpoint The endpoint class the request was sent to.
+     * @param headers The response headers, keyed by lower-cased name.
+     * @param httpCode The HTTP status of the response. 429 empties the bucket.
+     */
+    void update(Endpoint endpoint, const std::map<std::string, std::string> &headers, long httpCode);
+
+    /**
+     * @brief The budget currently left for an endpoint class.
+     */
+    Budget getBudget(Endpoint endpoint) const;
+
+private:
+    struct Bucket {
+        bool known = false;
+        int limit = 0;
+        int remaining = 0;
+        std::chrono::steady_clock::time_point resetAt;
+        std::chrono::steady_clock::time_point nextAllowed;  // Earliest time for the next paced request
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    Bucket buckets[NUM_ENDPOINTS];
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_RATE_LIMITER_H__
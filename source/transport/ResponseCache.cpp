@@ -0,0 +1,98 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ResponseCache.h"
+
+ValidatorCache::ValidatorCache(std::size_t maxEntries) : maxEntries(maxEntries) {}
+
+bool ValidatorCache::get(const std::string &url, Validators &validators) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = byUrl.find(url);
+    if (iter == byUrl.end()) {
+        return false;
+    }
+    entries.splice(entries.begin(), entries, iter->second);
+    validators = iter->second->second;
+    return true;
+}
+
+void ValidatorCache::put(const std::string &url, Validators validators) {
+    if (maxEntries == 0 || (validators.etag.empty() && validators.lastModified.empty())) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = byUrl.find(url);
+    if (iter != byUrl.end()) {
+        iter->second->second = std::move(validators);
+        entries.splice(entries.begin(), entries, iter->second);
+        return;
+    }
+
+    entries.emplace_front(url, std::move(validators));
+    byUrl[url] = entries.begin();
+    if (entries.size() > maxEntries) {
+        byUrl.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void ValidatorCache::erase(const std::string &url) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = byUrl.find(url);
+    if (iter != byUrl.end()) {
+        entries.erase(iter->second);
+        byUrl.erase(iter);
+    }
+}
+
+MediaCache::MediaCache(std::size_t maxBytes) : maxBytes(maxBytes) {}
+
+void MediaCache::put(const std::string &attachmentId, std::vector<uint8_t> &&data) {
+    if (attachmentId.empty() || data.size() > maxBytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = byId.find(attachmentId);
+    if (iter != byId.end()) {
+        bytes -= iter->second->second.size();
+        entries.erase(iter->second);
+        byId.erase(iter);
+    }
+
+    bytes += data.size();
+    entries.emplace_front(attachmentId, std::move(data));
+    byId[attachmentId] = entries.begin();
+    while (bytes > maxBytes) {
+        bytes -= entries.back().second.size();
+        byId.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+bool MediaCache::take(const std::string &attachmentId, std::vector<uint8_t> &data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = byId.find(attachmentId);
+    if (iter == byId.end()) {
+        return false;
+    }
+    data = std::move(iter->second->second);
+    bytes -= data.size();
+    entries.erase(iter->second);
+    byId.erase(iter);
+    return true;
+}
@@ -0,0 +1,91 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_RESPONSE_CACHE_H__
+#define __COMMS_MASTODON_TRANSPORT_RESPONSE_CACHE_H__
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The ETag and Last-Modified validators of recent responses, keyed by request URL, so
+ * that a repeated request can be made conditional.
+ *
+ * Holds a bounded number of URLs and evicts the least recently used. Thread-safe.
+ */
+class ValidatorCache {
+public:
+    struct Validators {
+        std::string etag;          // Sent back as If-None-Match
+        std::string lastModified;  // Sent back as If-Modified-Since
+    };
+
+    /**
+     * @param maxEntries Most URLs remembered, 0 to remember none.
+     */
+    explicit ValidatorCache(std::size_t maxEntries);
+
+    // Finds the validators of a URL and marks it as recently used
+    bool get(const std::string &url, Validators &validators);
+    // Remembers the validators of a URL, does nothing if both are empty
+    void put(const std::string &url, Validators validators);
+    void erase(const std::string &url);
+
+private:
+    using Entry = std::pair<std::string, Validators>;
+
+    std::size_t maxEntries;
+    std::mutex mutex;
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byUrl;
+};
+
+/**
+ * @brief Downloaded attachments kept until the status they belong to is delivered, keyed by
+ * attachment ID.
+ *
+ * A status is only delivered once every one of its attachments has downloaded. When one
+ * fails, the others are kept here so the retry on the next poll only downloads what is still
+ * missing. Images are moved in and out, never copied. The cache holds at most a fixed number
+ * of bytes and evicts the least recently stored. Thread-safe.
+ */
+class MediaCache {
+public:
+    /**
+     * @param maxBytes Most image bytes held, 0 to hold none.
+     */
+    explicit MediaCache(std::size_t maxBytes);
+
+    // Keeps an image, unless it is larger than the whole cache
+    void put(const std::string &attachmentId, std::vector<uint8_t> &&data);
+    // Removes an image from the cache and returns it, false if it is not there
+    bool take(const std::string &attachmentId, std::vector<uint8_t> &data);
+
+private:
+    using Entry = std::pair<std::string, std::vector<uint8_t>>;
+
+    std::size_t maxBytes;
+    std::mutex mutex;
+    std::size_t bytes = 0;
+    std::list<Entry> entries;  // Most recently stored first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byId;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_RESPONSE_CACHE_H__
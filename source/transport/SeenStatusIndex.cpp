@@ -0,0 +1,54 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SeenStatusIndex.h"
+
+#include "Digest.h"
+
+SeenStatusIndex::SeenStatusIndex(std::size_t maxBytes) : ring(HashRing::capacityForBytes(maxBytes)) {}
+
+/**
+ * @brief Combines the hashtag and status ID into one key. Mastodon status IDs are numeric
+ * snowflakes and are used directly, other ID formats are hashed.
+ */
+std::uint64_t SeenStatusIndex::key(const std::string &hashtag, const std::string &statusId) {
+    std::uint64_t id = 0;
+    bool numeric = !statusId.empty() && statusId.size() <= 19 &&
+                   statusId.find_first_not_of("0123456789") == std::string::npos;
+    if (numeric) {
+        id = std::stoull(statusId);
+    } else {
+        id = digest64(statusId);
+    }
+    std::uint64_t tag = digest64(hashtag);
+    return id ^ (tag * 0x9e3779b97f4a7c15ULL);
+}
+
+bool SeenStatusIndex::contains(const std::string &hashtag, const std::string &statusId) const {
+    return ring.contains(key(hashtag, statusId));
+}
+
+bool SeenStatusIndex::insert(const std::string &hashtag, const std::string &statusId) {
+    return ring.insert(key(hashtag, statusId));
+}
+
+std::size_t SeenStatusIndex::size() const {
+    return ring.size();
+}
+
+std::size_t SeenStatusIndex::memoryBytes() const {
+    return ring.memoryBytes();
+}
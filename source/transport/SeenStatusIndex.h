@@ -0,0 +1,50 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_SEEN_STATUS_INDEX_H__
+#define __COMMS_MASTODON_TRANSPORT_SEEN_STATUS_INDEX_H__
+
+#include <cstdint>
+#include <string>
+
+#include "HashRing.h"
+
+/**
+ * @brief Memory-capped record of the statuses already delivered for each hashtag.
+ *
+ * Each (hashtag, status ID) pair is reduced to a single 64-bit key held in a HashRing sized
+ * from a byte budget, so memory use is fixed at construction no matter how long the process
+ * runs. The oldest entries are evicted first. Those statuses are behind the per-hashtag
+ * timeline cursor and are not requested again.
+ */
+class SeenStatusIndex {
+public:
+    explicit SeenStatusIndex(std::size_t maxBytes);
+
+    bool contains(const std::string &hashtag, const std::string &statusId) const;
+    // Returns false if the status was already recorded
+    bool insert(const std::string &hashtag, const std::string &statusId);
+
+    std::size_t size() const;
+    std::size_t memoryBytes() const;
+
+private:
+    static std::uint64_t key(const std::string &hashtag, const std::string &statusId);
+
+    HashRing ring;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_SEEN_STATUS_INDEX_H__
@@ -0,0 +1,307 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "Spool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include "Digest.h"
+#include "log.h"
+
+namespace {
+
+const uint32_t recordMagic = 0x4c50534d;  // "MSPL"
+
+// Precedes the data of every record. The check covers the fields before it, so a header that
+// was only partly written is never taken for a record.
+struct RecordHeader {
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint64_t actionId;
+    uint64_t size;
+    uint64_t check;
+};
+static_assert(sizeof(RecordHeader) == 32, "records are read back with the same layout");
+
+uint64_t headerCheck(const RecordHeader &header) {
+    return digest64(std::string_view(reinterpret_cast<const char *>(&header), offsetof(RecordHeader, check)));
+}
+
+bool writeAll(int fd, const void *data, uint64_t size, uint64_t offset) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<uint64_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, void *data, uint64_t size, uint64_t offset) {
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t count = pread(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= static_cast<uint64_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+int openFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open spool " + path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+}  // namespace
+
+std::shared_ptr<Spool> Spool::open(const std::string &path) {
+    static std::mutex openMutex;
+    static std::map<std::string, std::weak_ptr<Spool>> openSpools;
+
+    std::lock_guard<std::mutex> lock(openMutex);
+    std::weak_ptr<Spool> &entry = openSpools[path];
+    std::shared_ptr<Spool> spool = entry.lock();
+    if (!spool) {
+        try {
+            spool = std::make_shared<Spool>(path);
+        } catch (...) {
+            openSpools.erase(path);
+            throw;
+        }
+        entry = spool;
+    }
+
+    // Forget the spools that have since been closed
+    for (auto iter = openSpools.begin(); iter != openSpools.end();) {
+        iter = iter->second.expired() ? openSpools.erase(iter) : std::next(iter);
+    }
+    return spool;
+}
+
+Spool::Spool(const std::string &path) : path(path) {
+    std::size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos && slash > 0) {
+        // Only the last level is created, like the SDK's makeDir
+        mkdir(path.substr(0, slash).c_str(), 0700);
+    }
+    fd = openFile(path);
+    try {
+        load();
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+Spool::~Spool() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (live.empty()) {
+        unlink(path.c_str());
+    }
+    close(fd);
+}
+
+uint64_t Spool::newAction() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextActionId++;
+}
+
+bool Spool::appendText(uint64_t actionId, const std::vector<uint8_t> &text) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t offset = 0;
+    return append(TEXT, actionId, text.data(), text.size(), offset);
+}
+
+bool Spool::appendImage(uint64_t actionId, const std::vector<uint8_t> &image, Image &stored) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!append(IMAGE, actionId, image.data(), image.size(), stored.offset)) {
+        return false;
+    }
+    stored.size = image.size();
+    return true;
+}
+
+void Spool::remove(uint64_t actionId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (live.erase(actionId) == 0) {
+        return;
+    }
+
+    // Nothing left to replay, so the file can start over instead of recording the removal
+    if (live.empty()) {
+        if (ftruncate(fd, 0) == 0) {
+            end = 0;
+            return;
+        }
+        logWarning("Spool::remove: cannot truncate " + path + ": " + std::strerror(errno));
+    }
+    uint64_t offset = 0;
+    append(REMOVE, actionId, nullptr, 0, offset);
+}
+
+std::shared_ptr<const std::vector<uint8_t>> Spool::readImage(const Image &image) const {
+    // Stored records are never rewritten while their action is live, so no lock is needed
+    auto data = std::make_shared<std::vector<uint8_t>>(image.size);
+    if (!readAll(fd, data->data(), image.size, image.offset)) {
+        logError("Spool::readImage: cannot read " + std::to_string(image.size) + " bytes from " + path);
+        return nullptr;
+    }
+    return data;
+}
+
+std::vector<Spool::Action> Spool::takeReplay() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::move(replay);
+}
+
+bool Spool::append(RecordKind kind, uint64_t actionId, const uint8_t *data, uint64_t size, uint64_t &dataOffset) {
+    RecordHeader header{};
+    header.magic = recordMagic;
+    header.kind = kind;
+    header.actionId = actionId;
+    header.size = size;
+    header.check = headerCheck(header);
+
+    dataOffset = end + sizeof(header);
+    if (!writeAll(fd, &header, sizeof(header), end) || !writeAll(fd, data, size, dataOffset)) {
+        logError("Spool::append: cannot write to " + path + ": " + std::strerror(errno));
+        // Drop whatever part was written so the next record starts in the right place
+        if (ftruncate(fd, static_cast<off_t>(end)) != 0) {
+            logError("Spool::append: cannot truncate " + path + ": " + std::strerror(errno));
+        }
+        return false;
+    }
+    end = dataOffset + size;
+    if (kind != REMOVE) {
+        live.insert(actionId);
+    }
+    return true;
+}
+
+void Spool::load() {
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        throw std::runtime_error("cannot read spool " + path + ": " + std::strerror(errno));
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+
+    std::map<uint64_t, Action> actions;
+    bool dropped = false;  // Finished actions or a torn record
+    uint64_t offset = 0;
+    while (offset < fileSize) {
+        RecordHeader header{};
+        if (fileSize - offset < sizeof(header) || !readAll(fd, &header, sizeof(header), offset) ||
+            header.magic != recordMagic || header.check != headerCheck(header) ||
+            header.size > fileSize - offset - sizeof(header)) {
+            logWarning("Spool::load: dropping a torn record at " + std::to_string(offset) + " of " + path);
+            dropped = true;
+            break;
+        }
+
+        uint64_t dataOffset = offset + sizeof(header);
+        Action &action = actions[header.actionId];
+        action.id = header.actionId;
+        if (header.kind == TEXT) {
+            action.text.resize(header.size);
+            if (!readAll(fd, action.text.data(), header.size, dataOffset)) {
+                throw std::runtime_error("cannot read spool " + path + ": " + std::strerror(errno));
+            }
+            action.hasText = true;
+        } else if (header.kind == IMAGE) {
+            action.images.push_back({dataOffset, header.size});
+        } else {
+            actions.erase(header.actionId);
+            dropped = true;
+        }
+        nextActionId = std::max(nextActionId, header.actionId + 1);
+        offset = dataOffset + header.size;
+    }
+    end = offset;
+
+    if (dropped) {
+        rewrite(actions);
+    }
+    for (auto &action : actions) {
+        live.insert(action.first);
+        replay.push_back(std::move(action.second));
+    }
+}
+
+void Spool::rewrite(std::map<uint64_t, Action> &actions) {
+    // The live records are copied to a new file that then replaces the old one, so a crash
+    // during compaction leaves one of the two intact
+    const std::string compacted = path + ".compact";
+    int oldFd = fd;
+    fd = openFile(compacted);
+    end = 0;
+    if (ftruncate(fd, 0) != 0) {
+        close(fd);
+        fd = oldFd;
+        throw std::runtime_error("cannot truncate spool " + compacted + ": " + std::strerror(errno));
+    }
+
+    bool ok = true;
+    for (auto &entry : actions) {
+        Action &action = entry.second;
+        uint64_t offset = 0;
+        if (action.hasText) {
+            ok = ok && append(TEXT, action.id, action.text.data(), action.text.size(), offset);
+        }
+        for (auto &image : action.images) {
+            std::vector<uint8_t> data(image.size);
+            ok = ok && readAll(oldFd, data.data(), image.size, image.offset) &&
+                 append(IMAGE, action.id, data.data(), data.size(), offset);
+            image.offset = offset;
+        }
+    }
+    live.clear();
+
+    if (!ok || rename(compacted.c_str(), path.c_str()) != 0) {
+        std::string error = std::strerror(errno);
+        close(fd);
+        unlink(compacted.c_str());
+        fd = oldFd;
+        throw std::runtime_error("cannot compact spool " + path + ": " + error);
+    }
+    close(oldFd);
+}
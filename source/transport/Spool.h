@@ -0,0 +1,121 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef __COMMS_MASTODON_TRANSPORT_SPOOL_H__
+#define __COMMS_MASTODON_TRANSPORT_SPOOL_H__
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Append-only file holding the content a link has enqueued and not yet posted, so that
+ * it survives a restart or crash.
+ *
+ * Each fragment of an action is appended as a record when it is enqueued, and a removal
+ * record marks the action done once it has been posted, dequeued or has failed for good.
+ * Records are written straight to the file, so they survive the process but are not synced
+ * to stable storage. A record torn by a crash is detected by its header checksum and length
+ * and dropped when the spool is opened again.
+ *
+ * Images are read back from the file when they are uploaded rather than kept in memory while
+ * they wait. Opening the spool rewrites it without the records of finished actions, and it
+ * is truncated whenever the last live action is removed.
+ *
+ * Every method is thread-safe.
+ */
+class Spool {
+public:
+    // Where an image is stored in the file
+    struct Image {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // An action found in the file when it was opened
+    struct Action {
+        uint64_t id = 0;
+        bool hasText = false;
+        std::vector<uint8_t> text;
+        std::vector<Image> images;  // In the order they were enqueued
+    };
+
+    /**
+     * @brief Opens the spool at path, creating it and its directory if needed, and reads
+     * back the actions it still holds.
+     *
+     * @throws std::runtime_error If the file cannot be opened or compacted.
+     */
+    explicit Spool(const std::string &path);
+
+    /**
+     * @brief Opens the spool at path, or returns the one already open there. Links with the
+     * same address share their spool instead of writing over each other's records.
+     *
+     * @throws std::runtime_error If the file cannot be opened or compacted.
+     */
+    static std::shared_ptr<Spool> open(const std::string &path);
+
+    // Deletes the file if no action is left in it
+    ~Spool();
+
+    Spool(const Spool &) = delete;
+    Spool &operator=(const Spool &) = delete;
+
+    // A new action ID, unique within the file
+    uint64_t newAction();
+
+    // Appends the text of an action, false if it could not be written
+    bool appendText(uint64_t actionId, const std::vector<uint8_t> &text);
+
+    // Appends an image of an action and sets where it was stored, false if it could not be written
+    bool appendImage(uint64_t actionId, const std::vector<uint8_t> &image, Image &stored);
+
+    // Marks an action done, its records are dropped on the next compaction
+    void remove(uint64_t actionId);
+
+    // Reads an image back from the file, null if it cannot be read
+    std::shared_ptr<const std::vector<uint8_t>> readImage(const Image &image) const;
+
+    // The actions that were in the file when it was opened, in the order they were enqueued.
+    // They remain live until removed.
+    std::vector<Action> takeReplay();
+
+private:
+    enum RecordKind : uint8_t { TEXT = 1, IMAGE = 2, REMOVE = 3 };
+
+    // Called with the mutex held. Sets the offset of the data in the file.
+    bool append(RecordKind kind, uint64_t actionId, const uint8_t *data, uint64_t size, uint64_t &dataOffset);
+    // Reads the file, keeping the live actions, then rewrites it if anything was dropped
+    void load();
+    void rewrite(std::map<uint64_t, Action> &actions);
+
+    std::string path;
+    int fd = -1;
+    uint64_t end = 0;  // Where the next record is written
+    uint64_t nextActionId = 1;
+
+    mutable std::mutex mutex;
+    std::set<uint64_t> live;  // Actions not yet removed
+    std::vector<Action> replay;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_SPOOL_H__
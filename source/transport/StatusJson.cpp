@@ -0,0 +1,172 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "StatusJson.h"
+
+#include <nlohmann/json.hpp>
+
+/**
+ * @brief SAX handler that collects the fields of the statuses found at a fixed depth.
+ *
+ * Depth 1 is a top-level object and depth 2 an object inside a top-level array. Only the
+ * string values of interest are copied out; everything else is skipped as it is read.
+ */
+class StatusSaxHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    StatusSaxHandler(std::size_t statusDepth, std::vector<StatusFields> &statuses) :
+        statusDepth(statusDepth), statuses(statuses) {}
+
+    bool null() override {
+        return true;
+    }
+    bool boolean(bool) override {
+        return true;
+    }
+    bool number_integer(number_integer_t) override {
+        return true;
+    }
+    bool number_unsigned(number_unsigned_t) override {
+        return true;
+    }
+    bool number_float(number_float_t, const string_t &) override {
+        return true;
+    }
+    bool binary(binary_t &) override {
+        return true;
+    }
+
+    bool string(string_t &value) override {
+        if (inStatus && depth == statusDepth) {
+            if (keyAt(depth) == "id") {
+                status.id = std::move(value);
+            } else if (keyAt(depth) == "content") {
+                status.content = std::move(value);
+                status.hasContent = true;
+            }
+        } else if (inMedia && depth == statusDepth + 2) {
+            if (keyAt(depth) == "type") {
+                mediaType = std::move(value);
+            } else if (keyAt(depth) == "id") {
+                media.id = std::move(value);
+            } else if (keyAt(depth) == "url") {
+                media.url = std::move(value);
+            }
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        ++depth;
+        if (depth == statusDepth && isArrayAt(depth - 1)) {
+            inStatus = true;
+            status = StatusFields();
+        } else if (inStatus && depth == statusDepth + 2 && isArrayAt(depth - 1) &&
+                   keyAt(statusDepth) == "media_attachments") {
+            inMedia = true;
+            mediaType.clear();
+            media = ImageAttachment();
+        }
+        pushContainer(false);
+        return true;
+    }
+
+    bool end_object() override {
+        if (inMedia && depth == statusDepth + 2) {
+            inMedia = false;
+            if (mediaType == "image" && !media.url.empty()) {
+                status.images.push_back(std::move(media));
+            }
+        } else if (inStatus && depth == statusDepth) {
+            inStatus = false;
+            statuses.push_back(std::move(status));
+        }
+        popContainer();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        ++depth;
+        pushContainer(true);
+        return true;
+    }
+
+    bool end_array() override {
+        popContainer();
+        return true;
+    }
+
+    bool key(string_t &value) override {
+        keys[depth] = std::move(value);
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override {
+        return false;
+    }
+
+private:
+    // Containers are indexed by depth, the document itself is depth 0
+    void pushContainer(bool isArray) {
+        if (containers.size() <= depth) {
+            containers.resize(depth + 1);
+            keys.resize(depth + 1);
+        }
+        containers[depth] = isArray;
+        keys[depth].clear();
+    }
+
+    void popContainer() {
+        --depth;
+    }
+
+    bool isArrayAt(std::size_t level) const {
+        // The top-level object of a single status has no container around it
+        return level == 0 ? statusDepth == 1 : containers[level];
+    }
+
+    const std::string &keyAt(std::size_t level) const {
+        return keys[level];
+    }
+
+    std::size_t statusDepth;
+    std::vector<StatusFields> &statuses;
+
+    std::size_t depth = 0;
+    std::vector<bool> containers{false};
+    std::vector<std::string> keys{std::string()};
+
+    bool inStatus = false;
+    StatusFields status;
+    bool inMedia = false;
+    std::string mediaType;
+    ImageAttachment media;
+};
+
+bool parseTimelineJson(const std::string &json, std::vector<StatusFields> &statuses) {
+    statuses.clear();
+    StatusSaxHandler handler(2, statuses);
+    return nlohmann::json::sax_parse(json, &handler);
+}
+
+bool parseStatusJson(const std::string &json, StatusFields &status) {
+    std::vector<StatusFields> statuses;
+    StatusSaxHandler handler(1, statuses);
+    if (!nlohmann::json::sax_parse(json, &handler) || statuses.size() != 1) {
+        return false;
+    }
+    status = std::move(statuses.front());
+    return true;
+}
@@ -0,0 +1,66 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_STATUS_JSON_H__
+#define __COMMS_MASTODON_TRANSPORT_STATUS_JSON_H__
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief An image attached to a status.
+ */
+struct ImageAttachment {
+    std::string id;   // Attachment ID, empty if the server did not give one
+    std::string url;
+};
+
+/**
+ * @brief The fields of a Mastodon status that the transport reads.
+ */
+struct StatusFields {
+    std::string id;
+    std::string content;  // HTML content, valid if hasContent
+    bool hasContent = false;
+    std::vector<ImageAttachment> images;  // The image attachments that have a URL
+};
+
+/**
+ * @brief Parses a timeline response, an array of statuses, without building a document.
+ *
+ * The JSON is read with a SAX handler that keeps only the id, content and image attachment
+ * IDs and URLs of each status, so the accounts, cards, emojis and other fields of a page are never
+ * materialized.
+ *
+ * Only the document is avoided: the parser reads a body that has already been received in
+ * full, because nlohmann's SAX interface pulls its input and cannot be fed from curl's write callback.
+ * Peak memory is therefore still the whole response body plus the fields kept.
+ *
+ * @param json The response body.
+ * @param statuses Set to the statuses in the order they appear.
+ * @return false if the JSON is malformed.
+ */
+bool parseTimelineJson(const std::string &json, std::vector<StatusFields> &statuses);
+
+/**
+ * @brief Parses a single status, e.g. the payload of a streaming update event, in the same
+ * way as parseTimelineJson.
+ *
+ * @return false if the JSON is malformed or is not an object.
+ */
+bool parseStatusJson(const std::string &json, StatusFields &status);
+
+#endif  // __COMMS_MASTODON_TRANSPORT_STATUS_JSON_H__
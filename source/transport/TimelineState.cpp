@@ -0,0 +1,131 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "TimelineState.h"
+
+#include "Digest.h"
+#include "PersistentStorageHelpers.h"
+#include "log.h"
+
+// Statuses remembered per hashtag for recognizing our own posts on fetch. A link posts one
+// status at a time, so this covers far more posts than can be in flight.
+static const std::size_t ownPostsCapacity = 256;
+
+TimelineState::TimelineState(IComponentSdkBase *sdk, std::size_t seenIndexMaxBytes) :
+    sdk(sdk), seenStatuses(seenIndexMaxBytes) {}
+
+uint64_t TimelineState::getCursor(const std::string &hashtag) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return loadCursor(hashtag);
+}
+
+void TimelineState::saveCursor(const std::string &hashtag, uint64_t statusId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // A search and the stream may finish in either order, the cursor only moves forward. It
+    // is compared with the persisted cursor even if it was never read.
+    uint64_t &cursor = loadCursor(hashtag);
+    if (statusId <= cursor) {
+        return;
+    }
+    cursor = statusId;
+    if (sdk != nullptr && !psh::saveValue(sdk, cursorKey(hashtag), statusId)) {
+        logWarning("TimelineState::saveCursor: failed to persist cursor for " + hashtag);
+    }
+}
+
+uint64_t &TimelineState::loadCursor(const std::string &hashtag) {
+    auto iter = cursorsByHashtag.find(hashtag);
+    if (iter != cursorsByHashtag.end()) {
+        return iter->second;
+    }
+
+    uint64_t cursor = 0;
+    if (sdk != nullptr) {
+        cursor = psh::readValue<uint64_t>(sdk, cursorKey(hashtag), 0);
+    }
+    return cursorsByHashtag[hashtag] = cursor;
+}
+
+std::string TimelineState::cursorKey(const std::string &hashtag) {
+    return "mastodonCursor-" + (hashtag.rfind("#", 0) == 0 ? hashtag.substr(1) : hashtag);
+}
+
+bool TimelineState::isSeen(const std::string &hashtag, const std::string &statusId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seenStatuses.contains(hashtag, statusId);
+}
+
+bool TimelineState::markSeen(const std::string &hashtag, const std::string &statusId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seenStatuses.insert(hashtag, statusId);
+}
+
+bool TimelineState::isOwnPost(const std::string &hashtag, const std::string &statusId) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = ownPosts.find(hashtag);
+    return iter != ownPosts.end() && iter->second.statusIds.containsMessage(statusId);
+}
+
+// The image count seeds the digest, so that image-only posts only match statuses with as many images
+static uint64_t inFlightKey(std::string_view text, std::size_t mediaCount) {
+    return digest64(text, mediaCount);
+}
+
+void TimelineState::beginOwnPost(const std::string &hashtag, std::string_view text, std::size_t mediaCount) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto record = ownPosts.find(hashtag);
+    if (record != ownPosts.end()) {
+        record->second.inFlight.insert(inFlightKey(text, mediaCount));
+    }
+}
+
+void TimelineState::endOwnPost(const std::string &hashtag, std::string_view text, std::size_t mediaCount,
+                               const std::string &statusId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto record = ownPosts.find(hashtag);
+    if (record == ownPosts.end()) {
+        // Released by its last link while the post was in flight
+        return;
+    }
+    OwnPosts &posts = record->second;
+    auto iter = posts.inFlight.find(inFlightKey(text, mediaCount));
+    if (iter != posts.inFlight.end()) {
+        posts.inFlight.erase(iter);
+    }
+    if (!statusId.empty()) {
+        posts.statusIds.addMessage(statusId);
+    }
+}
+
+bool TimelineState::isOwnPostInFlight(const std::string &hashtag, std::string_view text,
+                                      std::size_t mediaCount) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = ownPosts.find(hashtag);
+    return iter != ownPosts.end() && iter->second.inFlight.count(inFlightKey(text, mediaCount)) != 0;
+}
+
+void TimelineState::retainOwnPosts(const std::string &hashtag) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++ownPosts.try_emplace(hashtag, ownPostsCapacity).first->second.links;
+}
+
+void TimelineState::releaseOwnPosts(const std::string &hashtag) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = ownPosts.find(hashtag);
+    if (iter != ownPosts.end() && --iter->second.links <= 0) {
+        ownPosts.erase(iter);
+    }
+}
@@ -0,0 +1,92 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef __COMMS_MASTODON_TRANSPORT_TIMELINE_STATE_H__
+#define __COMMS_MASTODON_TRANSPORT_TIMELINE_STATE_H__
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "IComponentSdkBase.h"
+#include "MessageHashQueue.h"
+#include "SeenStatusIndex.h"
+
+/**
+ * @brief What has been delivered and posted on the hashtags of one server: the index of seen
+ * statuses, the timeline cursors and our own posts.
+ *
+ * Every client of the server shares one instance, so a link can move between accounts
+ * without a status being delivered twice or its timeline being replayed. Thread-safe.
+ */
+class TimelineState {
+public:
+    /**
+     * @param sdk The SDK used to persist timeline cursors, may be null to disable persistence.
+     * @param seenIndexMaxBytes Memory ceiling for the index of seen statuses.
+     */
+    TimelineState(IComponentSdkBase *sdk, std::size_t seenIndexMaxBytes);
+
+    // The newest status delivered on the hashtag, 0 if none. Read from storage on first use.
+    uint64_t getCursor(const std::string &hashtag);
+    // Moves the cursor forward and persists it, does nothing if statusId is not newer
+    void saveCursor(const std::string &hashtag, uint64_t statusId);
+
+    bool isSeen(const std::string &hashtag, const std::string &statusId) const;
+    bool markSeen(const std::string &hashtag, const std::string &statusId);  // false if already seen
+
+    // Our own posts come back on every fetch of the hashtag. They are recorded by the ID the
+    // server returned once the post succeeded, so a peer posting the same text is still
+    // delivered.
+    bool isOwnPost(const std::string &hashtag, const std::string &statusId) const;
+
+    // The stream may deliver a post before the server's answer to it. Until the post ends, a
+    // status on the hashtag with the same text and number of images may be ours, and is held
+    // back rather than delivered. The post is recorded by its ID if statusId is not empty. Both
+    // do nothing on a hashtag no link retains.
+    void beginOwnPost(const std::string &hashtag, std::string_view text, std::size_t mediaCount);
+    void endOwnPost(const std::string &hashtag, std::string_view text, std::size_t mediaCount,
+                    const std::string &statusId);
+    bool isOwnPostInFlight(const std::string &hashtag, std::string_view text, std::size_t mediaCount) const;
+
+    // Every link on a hashtag retains its record of own posts while it is open, and the record
+    // is dropped once the last of them releases it
+    void retainOwnPosts(const std::string &hashtag);
+    void releaseOwnPosts(const std::string &hashtag);
+
+private:
+    struct OwnPosts {
+        MessageHashQueue statusIds;    // IDs the server returned for our posts
+        std::multiset<uint64_t> inFlight;  // Digests of the text and image count of posts not yet answered
+        int links = 0;               // Links on the hashtag that retain the record
+        explicit OwnPosts(std::size_t capacity) : statusIds(capacity) {}
+    };
+
+    static std::string cursorKey(const std::string &hashtag);
+    // The cursor of a hashtag, read from storage the first time. Called with the mutex held.
+    uint64_t &loadCursor(const std::string &hashtag);
+
+    IComponentSdkBase *sdk;
+    mutable std::mutex mutex;
+    SeenStatusIndex seenStatuses;                      // Bounded record of delivered statuses
+    std::map<std::string, uint64_t> cursorsByHashtag;  // Newest delivered status ID per hashtag
+    std::map<std::string, OwnPosts> ownPosts;
+};
+
+#endif  // __COMMS_MASTODON_TRANSPORT_TIMELINE_STATE_H__
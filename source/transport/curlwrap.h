@@ -21,14 +21,21 @@
 #include <curl/curl.h>
 
 #include <exception>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-class curl_exception : std::exception {
+class curl_exception : public std::exception {
 public:
     explicit curl_exception(CURLcode code_) : code(code_) {}
     const char *what() const noexcept override {
         return curl_easy_strerror(code);
     }
+    CURLcode getCode() const noexcept {
+        return code;
+    }
 
 private:
     CURLcode code;
@@ -39,6 +46,7 @@ public:
     CurlWrap() {
         curl = curl_easy_init();
         form = NULL;
+        headers = NULL;
         if (!curl) {
             throw curl_exception(CURLE_FAILED_INIT);
         }
@@ -49,6 +57,23 @@ public:
             if (form != NULL) {
                 curl_mime_free(form);
             }
+            if (headers != NULL) {
+                curl_slist_free_all(headers);
+            }
+        }
+    }
+
+    // Restore the handle to its default options so it can be reused for another
+    // request. Live connections, the DNS cache and TLS session IDs are kept.
+    void reset() {
+        curl_easy_reset(curl);
+        if (form != NULL) {
+            curl_mime_free(form);
+            form = NULL;
+        }
+        if (headers != NULL) {
+            curl_slist_free_all(headers);
+            headers = NULL;
         }
     }
 
@@ -89,6 +114,36 @@ public:
         curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
     }
 
+    // Create an empty form owned by this handle. The caller adds its parts and
+    // the form is freed on reset() or destruction.
+    curl_mime *createForm() {
+        if (form != NULL) {
+            curl_mime_free(form);
+        }
+        form = curl_mime_init(curl);
+        curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
+        return form;
+    }
+
+    // Take ownership of a header list and attach it to the request
+    void setHeaders(struct curl_slist *list) {
+        if (headers != NULL) {
+            curl_slist_free_all(headers);
+        }
+        headers = list;
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    }
+
+    // Attach a header list shared between requests, which must outlive the request. curl
+    // only reads the list, so one list can be used by requests on several threads.
+    void setSharedHeaders(const struct curl_slist *list) {
+        if (headers != NULL) {
+            curl_slist_free_all(headers);
+            headers = NULL;
+        }
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    }
+
     // Allows instances to be implicitly converted to
     // the underlying pointer for using the API directly
     operator CURL *() {
@@ -104,6 +159,201 @@ public:
 private:
     CURL *curl;
     curl_mime *form;
+    struct curl_slist *headers;
+};
+
+// Wraps a CURLSH share object so the DNS cache and TLS sessions are shared by
+// every handle attached to it. libcurl requires explicit locking when a share
+// object is used from more than one thread. The connection cache is not shared,
+// as libcurl does not support that across concurrent threads: each pooled easy
+// handle keeps its own connections, and a multi handle has its own cache.
+class CurlShare {
+public:
+    CurlShare() {
+        share = curl_share_init();
+        if (!share) {
+            throw curl_exception(CURLE_FAILED_INIT);
+        }
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+    ~CurlShare() {
+        curl_share_cleanup(share);
+    }
+
+    operator CURLSH *() {
+        return share;
+    }
+
+    // Disable copying or moving
+    CurlShare(const CurlShare &) = delete;
+    CurlShare &operator=(const CurlShare &) = delete;
+    CurlShare(CurlShare &&) = delete;
+    CurlShare &operator=(CurlShare &&) = delete;
+
+private:
+    static void lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr) {
+        static_cast<CurlShare *>(userptr)->mutexes[data].lock();
+    }
+    static void unlock(CURL *, curl_lock_data data, void *userptr) {
+        static_cast<CurlShare *>(userptr)->mutexes[data].unlock();
+    }
+
+    CURLSH *share;
+    std::mutex mutexes[CURL_LOCK_DATA_LAST];
+};
+
+// Thread-safe pool of reusable easy handles attached to a common share object.
+// Handles are returned to the pool when the lease goes out of scope, so
+// back-to-back requests to the same host reuse warm keep-alive connections
+// instead of paying for a new TCP and TLS handshake each time.
+class CurlPool {
+public:
+    class Handle {
+    public:
+        Handle(CurlPool *pool_, std::unique_ptr<CurlWrap> curl_) :
+            pool(pool_), curl(std::move(curl_)) {}
+        ~Handle() {
+            if (curl) {
+                pool->release(std::move(curl));
+            }
+        }
+
+        CurlWrap &operator*() {
+            return *curl;
+        }
+        CurlWrap *operator->() {
+            return curl.get();
+        }
+        operator CURL *() {
+            return *curl;
+        }
+
+        Handle(Handle &&) = default;
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+        Handle &operator=(Handle &&) = delete;
+
+    private:
+        CurlPool *pool;
+        std::unique_ptr<CurlWrap> curl;
+    };
+
+    explicit CurlPool(std::size_t maxIdle_ = 8) : maxIdle(maxIdle_) {}
+
+    Handle acquire() {
+        std::unique_ptr<CurlWrap> curl;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty()) {
+                curl = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if (!curl) {
+            curl = std::make_unique<CurlWrap>();
+        }
+        curl->setopt(CURLOPT_SHARE, static_cast<CURLSH *>(share));
+        return Handle(this, std::move(curl));
+    }
+
+    // Disable copying or moving
+    CurlPool(const CurlPool &) = delete;
+    CurlPool &operator=(const CurlPool &) = delete;
+    CurlPool(CurlPool &&) = delete;
+    CurlPool &operator=(CurlPool &&) = delete;
+
+private:
+    void release(std::unique_ptr<CurlWrap> curl) {
+        curl->reset();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.size() < maxIdle) {
+            idle.push_back(std::move(curl));
+        }
+    }
+
+    // Declared first so that it outlives every pooled handle
+    CurlShare share;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<CurlWrap>> idle;
+    std::size_t maxIdle;
+};
+
+// Wraps a multi handle used to drive several easy handles concurrently. Transfers to the same
+// host are multiplexed over a single HTTP/2 connection where the server supports it.
+class CurlMulti {
+public:
+    CurlMulti() {
+        multi = curl_multi_init();
+        if (!multi) {
+            throw curl_exception(CURLE_FAILED_INIT);
+        }
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    }
+    ~CurlMulti() {
+        curl_multi_cleanup(multi);
+    }
+
+    // Run every handle to completion with at most maxConcurrent transfers in flight. The
+    // returned result codes are in the same order as the input handles.
+    std::vector<CURLcode> performAll(const std::vector<CURL *> &handles, std::size_t maxConcurrent) {
+        std::vector<CURLcode> results(handles.size(), CURLE_FAILED_INIT);
+        std::unordered_map<CURL *, std::size_t> inFlight;
+        std::size_t next = 0;
+        if (maxConcurrent == 0) {
+            maxConcurrent = 1;
+        }
+
+        while (next < handles.size() || !inFlight.empty()) {
+            while (next < handles.size() && inFlight.size() < maxConcurrent) {
+                if (curl_multi_add_handle(multi, handles[next]) == CURLM_OK) {
+                    inFlight[handles[next]] = next;
+                }
+                ++next;
+            }
+
+            int running = 0;
+            if (curl_multi_perform(multi, &running) != CURLM_OK) {
+                break;
+            }
+
+            int queued = 0;
+            CURLMsg *msg = NULL;
+            while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                auto iter = inFlight.find(msg->easy_handle);
+                if (iter != inFlight.end()) {
+                    results[iter->second] = msg->data.result;
+                    inFlight.erase(iter);
+                }
+                curl_multi_remove_handle(multi, msg->easy_handle);
+            }
+
+            if (running > 0 && curl_multi_poll(multi, NULL, 0, 1000, NULL) != CURLM_OK) {
+                break;
+            }
+        }
+
+        // Only reached with transfers outstanding if the multi interface failed
+        for (auto &entry : inFlight) {
+            curl_multi_remove_handle(multi, entry.first);
+        }
+        return results;
+    }
+
+    // Disable copying or moving
+    CurlMulti(const CurlMulti &) = delete;
+    CurlMulti &operator=(const CurlMulti &) = delete;
+    CurlMulti(CurlMulti &&) = delete;
+    CurlMulti &operator=(CurlMulti &&) = delete;
+
+private:
+    CURLM *multi;
 };
 
 #endif
@@ -0,0 +1,162 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "base64.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+RawData randomData(std::size_t size, unsigned seed) {
+    std::mt19937 random(seed);
+    RawData data(size);
+    for (auto &byte : data) {
+        byte = static_cast<std::uint8_t>(random());
+    }
+    return data;
+}
+
+// Sizes around the block sizes of every implementation, and one well past them
+std::vector<std::size_t> testSizes() {
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = 0; size <= 100; ++size) {
+        sizes.push_back(size);
+    }
+    sizes.push_back(1000);
+    sizes.push_back(4099);
+    return sizes;
+}
+
+class Base64Isa : public testing::TestWithParam<base64::Isa> {
+protected:
+    void SetUp() override {
+        original = base64::activeIsa();
+        if (!base64::useIsa(GetParam())) {
+            GTEST_SKIP() << "not supported on this CPU";
+        }
+    }
+
+    void TearDown() override {
+        base64::useIsa(original);
+    }
+
+    // Runs fn with the scalar implementation selected
+    template <typename Fn>
+    auto scalar(Fn fn) {
+        base64::useIsa(base64::Isa::SCALAR);
+        auto result = fn();
+        base64::useIsa(GetParam());
+        return result;
+    }
+
+    base64::Isa original = base64::Isa::SCALAR;
+};
+
+}  // namespace
+
+TEST(Base64, encodes_rfc4648_vectors) {
+    const std::vector<std::pair<std::string, std::string>> vectors = {
+        {"", ""},         {"f", "Zg=="},         {"fo", "Zm8="},         {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"},
+    };
+    for (auto &vector : vectors) {
+        RawData data(vector.first.begin(), vector.first.end());
+        EXPECT_EQ(base64::encode(data), vector.second);
+        EXPECT_EQ(base64::decode(vector.second), data);
+    }
+}
+
+TEST(Base64, scalar_is_always_available) {
+    base64::Isa original = base64::activeIsa();
+    EXPECT_TRUE(base64::useIsa(base64::Isa::SCALAR));
+    EXPECT_EQ(base64::activeIsa(), base64::Isa::SCALAR);
+    base64::useIsa(original);
+}
+
+TEST_P(Base64Isa, encode_matches_scalar) {
+    for (std::size_t size : testSizes()) {
+        RawData data = randomData(size, static_cast<unsigned>(size));
+        std::string expected = scalar([&] { return base64::encode(data); });
+        EXPECT_EQ(base64::encode(data), expected) << "size " << size;
+    }
+}
+
+TEST_P(Base64Isa, decode_matches_scalar) {
+    for (std::size_t size : testSizes()) {
+        RawData data = randomData(size, static_cast<unsigned>(size));
+        std::string b64 = base64::encode(data);
+        // The output buffer is exactly as large as decodedMaxLength promises
+        std::vector<std::uint8_t> out(base64::decodedMaxLength(b64.size()));
+        out.resize(base64::decode(b64.data(), b64.size(), out.data()));
+        EXPECT_EQ(RawData(out.begin(), out.end()), data) << "size " << size;
+    }
+}
+
+TEST_P(Base64Isa, decode_rejects_invalid_characters) {
+    RawData data = randomData(300, 1);
+    const std::string b64 = base64::encode(data);
+    // Positions in the leading vector blocks, in the scalar tail and in the final block
+    for (std::size_t position : {std::size_t(0), std::size_t(5), std::size_t(17), std::size_t(40),
+                                 std::size_t(130), b64.size() - 6, b64.size() - 1}) {
+        for (char bad : {'*', '\0', '\x80', '-'}) {
+            std::string corrupt = b64;
+            corrupt[position] = bad;
+            EXPECT_THROW(base64::decode(corrupt), std::invalid_argument) << "position " << position;
+        }
+    }
+}
+
+TEST_P(Base64Isa, decode_rejects_padding_before_the_end) {
+    std::string b64 = base64::encode(randomData(96, 2));
+    b64[20] = '=';
+    EXPECT_THROW(base64::decode(b64), std::invalid_argument);
+    EXPECT_THROW(base64::decode("Zg==Zm9v"), std::invalid_argument);
+    EXPECT_THROW(base64::decode("Z==="), std::invalid_argument);
+}
+
+TEST_P(Base64Isa, decode_rejects_truncated_input) {
+    EXPECT_THROW(base64::decode("Zm9"), std::invalid_argument);
+    EXPECT_THROW(base64::decode(base64::encode(randomData(100, 3)).substr(1)), std::invalid_argument);
+}
+
+TEST_P(Base64Isa, decode_accepts_every_character) {
+    std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string b64 = alphabet + alphabet + alphabet;
+    RawData expected = scalar([&] { return base64::decode(b64); });
+    EXPECT_EQ(base64::decode(b64), expected);
+    EXPECT_EQ(base64::encode(expected), b64);
+}
+
+INSTANTIATE_TEST_SUITE_P(Implementations, Base64Isa,
+                         testing::Values(base64::Isa::SCALAR, base64::Isa::SSSE3, base64::Isa::AVX2,
+                                         base64::Isa::NEON),
+                         [](const testing::TestParamInfo<base64::Isa> &info) {
+                             switch (info.param) {
+                                 case base64::Isa::SSSE3:
+                                     return std::string("SSSE3");
+                                 case base64::Isa::AVX2:
+                                     return std::string("AVX2");
+                                 case base64::Isa::NEON:
+                                     return std::string("NEON");
+                                 default:
+                                     return std::string("SCALAR");
+                             }
+                         });
@@ -0,0 +1,39 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+
+#include "Digest.h"
+#include "gtest/gtest.h"
+
+TEST(Digest, matches_xxh64_reference_values) {
+    EXPECT_EQ(digest64(""), 0xEF46DB3751D8E999ull);
+    EXPECT_EQ(digest64("a"), 0xD24EC4F1A98C6E5Bull);
+    EXPECT_EQ(digest64("abc"), 0x44BC2CF5AD770999ull);
+    // Longer than one 32-byte stripe
+    EXPECT_EQ(digest64("Nobody inspects the spammish repetition"), 0xFBCEA83C8A378BF1ull);
+}
+
+TEST(Digest, seed_selects_another_function) {
+    EXPECT_NE(digest64("abc", 1), digest64("abc"));
+    EXPECT_EQ(digest64("abc", 1), digest64("abc", 1));
+}
+
+TEST(Digest, reads_only_the_given_bytes) {
+    std::string text = "hashtag payload";
+    EXPECT_EQ(digest64(std::string_view(text).substr(0, 7)), digest64("hashtag"));
+}
@@ -0,0 +1,205 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <unordered_set>
+
+#include "HashRing.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Straightforward model of a HashRing: the ring positions in insertion order, erased keys
+// leaving their position behind until it reaches the front
+class RingModel {
+public:
+    explicit RingModel(std::size_t capacity) : capacity(capacity) {}
+
+    bool insert(std::uint64_t key) {
+        if (live.count(key) != 0) {
+            return false;
+        }
+        if (positions.size() >= capacity) {
+            popFront();
+        }
+        positions.push_back({key, true});
+        live.insert(key);
+        return true;
+    }
+
+    bool erase(std::uint64_t key) {
+        if (live.erase(key) == 0) {
+            return false;
+        }
+        for (auto &position : positions) {
+            if (position.live && position.key == key) {
+                position.live = false;
+            }
+        }
+        while (!positions.empty() && !positions.front().live) {
+            positions.pop_front();
+        }
+        return true;
+    }
+
+    bool eraseThrough(std::uint64_t key) {
+        if (live.count(key) == 0) {
+            return false;
+        }
+        while (true) {
+            Position front = positions.front();
+            popFront();
+            if (front.live && front.key == key) {
+                return true;
+            }
+        }
+    }
+
+    bool contains(std::uint64_t key) const {
+        return live.count(key) != 0;
+    }
+
+    std::size_t size() const {
+        return live.size();
+    }
+
+private:
+    struct Position {
+        std::uint64_t key;
+        bool live;
+    };
+
+    void popFront() {
+        if (positions.front().live) {
+            live.erase(positions.front().key);
+        }
+        positions.pop_front();
+    }
+
+    std::size_t capacity;
+    std::deque<Position> positions;
+    std::unordered_set<std::uint64_t> live;
+};
+
+}  // namespace
+
+TEST(HashRing, capacity_has_a_minimum) {
+    EXPECT_EQ(HashRing(0).capacity(), 16u);
+    EXPECT_EQ(HashRing(100).capacity(), 100u);
+}
+
+TEST(HashRing, capacity_for_bytes_stays_within_budget) {
+    for (std::size_t bytes : {1024u, 4096u, 1u << 20}) {
+        HashRing ring(HashRing::capacityForBytes(bytes));
+        EXPECT_LE(ring.memoryBytes(), bytes);
+    }
+}
+
+TEST(HashRing, insert_reports_duplicates) {
+    HashRing ring(16);
+    EXPECT_TRUE(ring.insert(1));
+    EXPECT_FALSE(ring.insert(1));
+    EXPECT_TRUE(ring.contains(1));
+    EXPECT_FALSE(ring.contains(2));
+    EXPECT_EQ(ring.size(), 1u);
+}
+
+TEST(HashRing, evicts_oldest_key_when_full) {
+    HashRing ring(16);
+    for (std::uint64_t key = 0; key < 16; ++key) {
+        ASSERT_TRUE(ring.insert(key));
+    }
+    EXPECT_TRUE(ring.insert(100));
+    EXPECT_FALSE(ring.contains(0));
+    EXPECT_TRUE(ring.contains(1));
+    EXPECT_TRUE(ring.contains(100));
+    EXPECT_EQ(ring.size(), 16u);
+}
+
+TEST(HashRing, erase_keeps_colliding_keys_reachable) {
+    // Sequential keys fill long probe chains in a small index, so every erase shifts entries
+    // back into the hole it leaves
+    HashRing ring(16);
+    for (std::uint64_t key = 0; key < 16; ++key) {
+        ring.insert(key << 40);
+    }
+    for (std::uint64_t key = 0; key < 16; key += 2) {
+        ASSERT_TRUE(ring.erase(key << 40));
+    }
+    for (std::uint64_t key = 0; key < 16; ++key) {
+        EXPECT_EQ(ring.contains(key << 40), key % 2 == 1) << key;
+    }
+    EXPECT_EQ(ring.size(), 8u);
+}
+
+TEST(HashRing, erase_through_removes_older_keys) {
+    HashRing ring(16);
+    for (std::uint64_t key = 1; key <= 5; ++key) {
+        ring.insert(key);
+    }
+    EXPECT_TRUE(ring.eraseThrough(3));
+    EXPECT_FALSE(ring.contains(1));
+    EXPECT_FALSE(ring.contains(3));
+    EXPECT_TRUE(ring.contains(4));
+    EXPECT_EQ(ring.size(), 2u);
+    EXPECT_FALSE(ring.eraseThrough(3));
+}
+
+TEST(HashRing, clear_empties_the_ring) {
+    HashRing ring(16);
+    ring.insert(1);
+    ring.insert(2);
+    ring.clear();
+    EXPECT_EQ(ring.size(), 0u);
+    EXPECT_FALSE(ring.contains(1));
+    EXPECT_TRUE(ring.insert(1));
+}
+
+TEST(HashRing, matches_model_under_random_operations) {
+    // A small key space makes duplicates, erasures of present keys and evictions common
+    for (std::size_t capacity : {16u, 37u}) {
+        std::mt19937_64 random(capacity);
+        HashRing ring(capacity);
+        RingModel model(capacity);
+        std::vector<std::uint64_t> keys;
+        for (int i = 0; i < 96; ++i) {
+            keys.push_back(random());
+        }
+
+        for (int step = 0; step < 20000; ++step) {
+            std::uint64_t key = keys[random() % keys.size()];
+            switch (random() % 8) {
+                case 0:
+                case 1:
+                    ASSERT_EQ(ring.erase(key), model.erase(key)) << "step " << step;
+                    break;
+                case 2:
+                    ASSERT_EQ(ring.eraseThrough(key), model.eraseThrough(key)) << "step " << step;
+                    break;
+                default:
+                    ASSERT_EQ(ring.insert(key), model.insert(key)) << "step " << step;
+                    break;
+            }
+            ASSERT_EQ(ring.size(), model.size()) << "step " << step;
+            for (std::uint64_t probe : keys) {
+                ASSERT_EQ(ring.contains(probe), model.contains(probe)) << "step " << step;
+            }
+        }
+    }
+}
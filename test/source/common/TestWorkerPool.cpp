@@ -0,0 +1,213 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "WorkerPool.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(WorkerPool, tasks_on_a_strand_run_one_at_a_time_in_order) {
+    const int numStrands = 8;
+    const int perStrand = 500;
+    std::map<std::string, std::vector<int>> order;
+    std::map<std::string, std::atomic<int>> running;
+    std::atomic<bool> overlapped{false};
+    for (int s = 0; s < numStrands; ++s) {
+        order["strand " + std::to_string(s)];
+        running["strand " + std::to_string(s)] = 0;
+    }
+
+    {
+        WorkerPool pool(4);
+        for (int i = 0; i < perStrand; ++i) {
+            for (int s = 0; s < numStrands; ++s) {
+                std::string strand = "strand " + std::to_string(s);
+                auto &ran = order[strand];
+                auto &active = running[strand];
+                pool.post(strand, [&ran, &active, &overlapped, i] {
+                    if (++active != 1) {
+                        overlapped = true;
+                    }
+                    ran.push_back(i);
+                    --active;
+                });
+            }
+        }
+    }
+
+    EXPECT_FALSE(overlapped);
+    for (auto &entry : order) {
+        ASSERT_EQ(entry.second.size(), static_cast<std::size_t>(perStrand)) << entry.first;
+        for (int i = 0; i < perStrand; ++i) {
+            ASSERT_EQ(entry.second[i], i) << entry.first;
+        }
+    }
+}
+
+TEST(WorkerPool, different_strands_run_concurrently) {
+    WorkerPool pool(2);
+    std::promise<void> secondStarted;
+    auto second = secondStarted.get_future().share();
+    std::promise<bool> result;
+    auto sawSecond = result.get_future();
+    pool.post("a", [&] {
+        // Only sees "b" start if it runs alongside this task
+        result.set_value(second.wait_for(5s) == std::future_status::ready);
+    });
+    pool.post("b", [&] { secondStarted.set_value(); });
+    EXPECT_TRUE(sawSecond.get());
+}
+
+TEST(WorkerPool, task_posted_from_a_task_runs_after_it) {
+    std::vector<int> order;
+    std::promise<void> secondPosted;
+    auto posted = secondPosted.get_future().share();
+    {
+        WorkerPool pool(4);
+        pool.post("strand", [&, posted] {
+            // Task 2 is already queued, so task 3 must queue behind it
+            posted.wait();
+            pool.post("strand", [&] { order.push_back(3); });
+            order.push_back(1);
+        });
+        pool.post("strand", [&] { order.push_back(2); });
+        secondPosted.set_value();
+    }
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(WorkerPool, delayed_task_runs_after_its_delay) {
+    WorkerPool pool(2);
+    auto start = std::chrono::steady_clock::now();
+    std::promise<std::chrono::steady_clock::duration> ran;
+    auto elapsed = ran.get_future();
+    pool.postAfter("strand", 100ms, [&] { ran.set_value(std::chrono::steady_clock::now() - start); });
+
+    ASSERT_EQ(elapsed.wait_for(5s), std::future_status::ready);
+    auto waited = elapsed.get();
+    EXPECT_GE(waited, 100ms);
+    EXPECT_LT(waited, 2s);
+}
+
+TEST(WorkerPool, idle_workers_waiting_on_the_same_deadline) {
+    // Every idle worker waits for the earliest timer, and whichever wakes first removes it
+    const int numTasks = 200;
+    std::atomic<int> ran{0};
+    std::promise<void> done;
+    WorkerPool pool(8);
+    for (int i = 0; i < numTasks; ++i) {
+        pool.postAfter("strand " + std::to_string(i % 16), std::chrono::milliseconds(1 + i % 5),
+                       [&] {
+                           if (++ran == numTasks) {
+                               done.set_value();
+                           }
+                       });
+    }
+    ASSERT_EQ(done.get_future().wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(ran, numTasks);
+}
+
+TEST(WorkerPool, delayed_tasks_run_in_deadline_order) {
+    std::vector<int> order;
+    std::promise<void> done;
+    WorkerPool pool(1);
+    pool.postAfter("strand", 150ms, [&] {
+        order.push_back(3);
+        done.set_value();
+    });
+    pool.postAfter("strand", 50ms, [&] { order.push_back(1); });
+    pool.postAfter("other", 100ms, [&] { order.push_back(2); });
+    ASSERT_EQ(done.get_future().wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(WorkerPool, delayed_task_is_ordered_after_what_the_strand_already_has) {
+    std::vector<int> order;
+    std::promise<void> done;
+    WorkerPool pool(2);
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    // The delayed task becomes due while the strand is busy, and waits behind its queue
+    pool.post("strand", [&, released] {
+        released.wait();
+        order.push_back(1);
+    });
+    pool.post("strand", [&] { order.push_back(2); });
+    pool.postAfter("strand", 10ms, [&] {
+        order.push_back(3);
+        done.set_value();
+    });
+    std::this_thread::sleep_for(50ms);
+    release.set_value();
+    ASSERT_EQ(done.get_future().wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(WorkerPool, destructor_runs_queued_tasks_and_drops_undue_ones) {
+    std::atomic<int> ran{0};
+    std::atomic<bool> delayedRan{false};
+    auto start = std::chrono::steady_clock::now();
+    {
+        WorkerPool pool(2);
+        pool.postAfter("strand", std::chrono::hours(1), [&] { delayedRan = true; });
+        pool.post("strand", [&] {
+            std::this_thread::sleep_for(50ms);
+            ++ran;
+        });
+        for (int i = 0; i < 99; ++i) {
+            pool.post(i % 2 ? "strand" : "other", [&] { ++ran; });
+        }
+    }
+    EXPECT_EQ(ran, 100);
+    EXPECT_FALSE(delayedRan);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 10s);
+}
+
+TEST(WorkerPool, throwing_task_does_not_stop_its_worker_or_strand) {
+    std::vector<std::string> ran;
+    {
+        WorkerPool pool(1);
+        pool.post("strand", [] { throw std::runtime_error("failed"); });
+        pool.post("strand", [] { throw 42; });
+        pool.post("strand", [&] { ran.push_back("after"); });
+        pool.post("other", [&] { ran.push_back("other"); });
+    }
+    // Ready strands are served round robin, so only the set of tasks that ran is fixed
+    std::sort(ran.begin(), ran.end());
+    EXPECT_EQ(ran, (std::vector<std::string>{"after", "other"}));
+}
+
+TEST(WorkerPool, zero_threads_is_one_thread) {
+    std::atomic<bool> ran{false};
+    {
+        WorkerPool pool(0);
+        pool.post("strand", [&] { ran = true; });
+    }
+    EXPECT_TRUE(ran);
+}
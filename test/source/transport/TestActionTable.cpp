@@ -0,0 +1,121 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ActionTable.h"
+#include "gtest/gtest.h"
+
+TEST(ActionTable, take_returns_the_record_once) {
+    ActionTable table;
+    table.record(7, "link", "text/plain");
+    EXPECT_EQ(table.size(), 1u);
+
+    ActionTable::Entry entry;
+    ASSERT_TRUE(table.take(7, entry));
+    EXPECT_EQ(entry.linkId, "link");
+    EXPECT_EQ(entry.contentType, "text/plain");
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_FALSE(table.take(7, entry));
+}
+
+TEST(ActionTable, take_of_unknown_action_leaves_entry_alone) {
+    ActionTable table;
+    ActionTable::Entry entry{"kept", "kept"};
+    EXPECT_FALSE(table.take(1, entry));
+    EXPECT_EQ(entry.linkId, "kept");
+    EXPECT_EQ(entry.contentType, "kept");
+}
+
+TEST(ActionTable, record_replaces_earlier_record) {
+    ActionTable table;
+    table.record(1, "first link", "image/png");
+    table.record(1, "second link", "text/plain");
+    EXPECT_EQ(table.size(), 1u);
+
+    ActionTable::Entry entry;
+    ASSERT_TRUE(table.take(1, entry));
+    EXPECT_EQ(entry.linkId, "second link");
+    EXPECT_EQ(entry.contentType, "text/plain");
+}
+
+TEST(ActionTable, erase_removes_only_that_action) {
+    ActionTable table;
+    for (uint64_t id = 0; id < 100; ++id) {
+        table.record(id, "link " + std::to_string(id), "text/plain");
+    }
+    EXPECT_EQ(table.size(), 100u);
+
+    table.erase(50);
+    table.erase(50);
+    table.erase(1000);
+    EXPECT_EQ(table.size(), 99u);
+
+    ActionTable::Entry entry;
+    EXPECT_FALSE(table.take(50, entry));
+    ASSERT_TRUE(table.take(51, entry));
+    EXPECT_EQ(entry.linkId, "link 51");
+}
+
+TEST(ActionTable, long_strings_survive_pool_reuse) {
+    ActionTable table;
+    const std::string longLink(500, 'l');
+    ActionTable::Entry entry;
+    for (uint64_t id = 0; id < 1000; ++id) {
+        table.record(id, longLink + std::to_string(id), "application/octet-stream");
+        ASSERT_TRUE(table.take(id, entry));
+        ASSERT_EQ(entry.linkId, longLink + std::to_string(id));
+    }
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(ActionTable, concurrent_threads_keep_every_record) {
+    ActionTable table;
+    const int numThreads = 8;
+    const uint64_t perThread = 2000;
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < numThreads; ++thread) {
+        threads.emplace_back([&table, thread, perThread] {
+            uint64_t base = static_cast<uint64_t>(thread) * perThread;
+            std::string linkId = "link " + std::to_string(thread);
+            for (uint64_t id = base; id < base + perThread; ++id) {
+                table.record(id, linkId, "text/plain");
+            }
+            // Take back half, leaving the odd IDs
+            ActionTable::Entry entry;
+            for (uint64_t id = base; id < base + perThread; id += 2) {
+                ASSERT_TRUE(table.take(id, entry));
+                ASSERT_EQ(entry.linkId, linkId);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(table.size(), numThreads * perThread / 2);
+    ActionTable::Entry entry;
+    for (uint64_t id = 1; id < numThreads * perThread; id += 2) {
+        ASSERT_TRUE(table.take(id, entry));
+        ASSERT_EQ(entry.linkId, "link " + std::to_string(id / perThread));
+    }
+    EXPECT_EQ(table.size(), 0u);
+}
@@ -0,0 +1,102 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+#include <vector>
+
+#include "HtmlText.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// The single-pass extractor must either agree with libxml2 or leave the markup to it
+void expectMatchesLibxml2(const std::string &html) {
+    std::string text;
+    ASSERT_TRUE(extractStatusText(html, text)) << html;
+    EXPECT_EQ(text, stripHtmlWithLibxml2(html)) << html;
+}
+
+void expectFallsBack(const std::string &html) {
+    std::string text;
+    EXPECT_FALSE(extractStatusText(html, text)) << html;
+    EXPECT_NO_THROW(stripHtmlWithLibxml2(html)) << html;
+}
+
+}  // namespace
+
+TEST(HtmlText, plain_statuses_match_libxml2) {
+    expectMatchesLibxml2("<p>hello world</p>");
+    expectMatchesLibxml2("<p>aGVsbG8gd29ybGQ= <a href=\"https://a/tags/tag\" class=\"mention hashtag\" "
+                         "rel=\"tag\">#<span>tag</span></a></p>");
+    expectMatchesLibxml2("plain text without markup");
+    expectMatchesLibxml2("<p>a+b/c==</p>");
+}
+
+TEST(HtmlText, named_entities_match_libxml2) {
+    expectMatchesLibxml2("<p>&amp; &lt;tag&gt; &quot;q&quot; &apos;a&apos;</p>");
+    expectMatchesLibxml2("<p>non&nbsp;breaking</p>");
+    expectMatchesLibxml2("<p>&amp;amp;</p>");
+}
+
+TEST(HtmlText, numeric_references_match_libxml2) {
+    expectMatchesLibxml2("<p>&#65;&#x42;&#X43; &#233; &#x1F600; &#8364;</p>");
+    expectMatchesLibxml2("<p>&#39;quoted&#39;</p>");
+}
+
+TEST(HtmlText, paragraph_and_line_break_boundaries_match_libxml2) {
+    expectMatchesLibxml2("<p>first</p><p>second</p>");
+    expectMatchesLibxml2("<p>line<br>break<br/>again<br />end</p>");
+    expectMatchesLibxml2("<p>one</p>\n<p>two</p>");
+    expectMatchesLibxml2("  <p>leading whitespace</p>");
+}
+
+TEST(HtmlText, attributes_with_markup_characters_match_libxml2) {
+    expectMatchesLibxml2("<p><a href=\"https://a/?x=1&amp;y=2\" title='a > b'>link</a></p>");
+    expectMatchesLibxml2("<p><span class=\"invisible\">https://</span>example.org</p>");
+}
+
+TEST(HtmlText, non_ascii_utf8_matches_libxml2) {
+    expectMatchesLibxml2("<p>caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80 \xe6\x97\xa5\xe6\x9c\xac</p>");
+    expectMatchesLibxml2("\xc3\xa9t\xc3\xa9 without a paragraph");
+}
+
+TEST(HtmlText, empty_input_is_empty_text) {
+    std::string text = "stale";
+    ASSERT_TRUE(extractStatusText("", text));
+    EXPECT_EQ(text, "");
+    ASSERT_TRUE(extractStatusText(" \n\t", text));
+    EXPECT_EQ(text, "");
+}
+
+TEST(HtmlText, malformed_markup_falls_back_to_libxml2) {
+    expectFallsBack("<p>unterminated <a href=\"x\"");
+    expectFallsBack("<p>stray < less than</p>");
+    expectFallsBack("<p>nested <b<i>tags</i></p>");
+    expectFallsBack("</p>stray end tag first");
+    expectFallsBack("<p>unknown &entity; here</p>");
+    expectFallsBack("<p>unterminated &amp reference</p>");
+    expectFallsBack("<p>&#0; &#xD800; &#x110000;</p>");
+    expectFallsBack("<!-- comment --><p>text</p>");
+    expectFallsBack("<p>a</p><script>var x = '<p>';</script>");
+    expectFallsBack("<p>windows\r\nline ending</p>");
+}
+
+TEST(HtmlText, fallback_decodes_utf8) {
+    // Markup the extractor rejects still comes out as UTF-8, not as Latin-1 mojibake
+    std::string text = stripHtmlWithLibxml2("<!-- c --><p>caf\xc3\xa9 &eacute;</p>");
+    EXPECT_EQ(text, "caf\xc3\xa9 \xc3\xa9");
+}
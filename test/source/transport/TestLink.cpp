@@ -0,0 +1,388 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Link.h"
+#include "MastodonClientPool.h"
+#include "WorkerPool.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+
+namespace {
+
+class MockTransportSdk : public ITransportSdk {
+public:
+    MOCK_METHOD(std::string, getActivePersona, (), (override));
+    MOCK_METHOD(ComponentSdkResponse, updateState, (ComponentState state), (override));
+    MOCK_METHOD(ComponentSdkResponse, makeDir, (const std::string &directoryPath), (override));
+    MOCK_METHOD(ComponentSdkResponse, removeDir, (const std::string &directoryPath), (override));
+    MOCK_METHOD(std::vector<std::string>, listDir, (const std::string &directoryPath), (override));
+    MOCK_METHOD(std::vector<uint8_t>, readFile, (const std::string &filepath), (override));
+    MOCK_METHOD(ComponentSdkResponse, appendFile,
+                (const std::string &filepath, const std::vector<uint8_t> &data), (override));
+    MOCK_METHOD(ComponentSdkResponse, writeFile,
+                (const std::string &filepath, const std::vector<uint8_t> &data), (override));
+    MOCK_METHOD(ComponentSdkResponse, requestPluginUserInput,
+                (const std::string &key, const std::string &prompt, bool cache), (override));
+    MOCK_METHOD(ComponentSdkResponse, requestCommonUserInput, (const std::string &key), (override));
+    MOCK_METHOD(ChannelProperties, getChannelProperties, (), (override));
+    MOCK_METHOD(ComponentSdkResponse, onLinkStatusChanged,
+                (RaceHandle handle, const LinkID &linkId, LinkStatus status,
+                 const LinkParameters &params),
+                (override));
+    MOCK_METHOD(ComponentSdkResponse, onPackageStatusChanged, (RaceHandle handle, PackageStatus status),
+                (override));
+    MOCK_METHOD(ComponentSdkResponse, onEvent, (const Event &event), (override));
+    MOCK_METHOD(ComponentSdkResponse, onReceive,
+                (const LinkID &linkId, const EncodingParameters &params,
+                 const std::vector<uint8_t> &bytes),
+                (override));
+};
+
+// Answers the requests a link posts with instead of a server
+class MockMastodonClient : public MastodonClient {
+public:
+    MockMastodonClient(const MastodonAccount &account, const MastodonConfig &config,
+                       std::shared_ptr<TimelineState> timelineState, std::shared_ptr<Metrics> metrics) :
+        MastodonClient(account.server, account.accessToken, nullptr, config, std::move(timelineState),
+                       std::move(metrics)) {}
+
+    MOCK_METHOD(PostResult, postStatus, (std::string_view content, const std::string &hashtag),
+                (override));
+    MOCK_METHOD(std::shared_future<PostResult>, uploadMediaAsync, (ImageSource loadImage), (override));
+    MOCK_METHOD(PostResult, createStatus,
+                (std::string_view text, const std::string &hashtag,
+                 const std::vector<std::string> &mediaIds),
+                (override));
+};
+
+const std::string hashtag = "#linktest";
+
+PostResult sent(const std::string &id) {
+    return {true, false, id};
+}
+
+PostResult transientFailure() {
+    return {false, true, ""};
+}
+
+PostResult permanentFailure() {
+    return {false, false, ""};
+}
+
+std::vector<uint8_t> bytes(const std::string &text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+class LinkTest : public testing::Test {
+protected:
+    void SetUp() override {
+        char pattern[] = "/tmp/linktestXXXXXX";
+        ASSERT_NE(mkdtemp(pattern), nullptr);
+        dir = pattern;
+
+        config.spoolDirectory = dir;
+        config.retryInitialDelayMs = 1;
+        config.retryMaxDelayMs = 1;
+        config.retryMaxElapsedMs = 0;
+
+        ON_CALL(sdk, onPackageStatusChanged(_, _))
+            .WillByDefault([this](RaceHandle handle, PackageStatus status) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    statuses[handle].push_back(status);
+                }
+                changed.notify_all();
+                return ComponentSdkResponse{};
+            });
+    }
+
+    void TearDown() override {
+        for (auto &link : links) {
+            link->shutdown();
+        }
+        // Runs what is queued on the strands, so nothing holds the links afterwards
+        workers.reset();
+        links.clear();
+        clients.reset();
+        for (auto &file : spoolFiles()) {
+            std::remove((dir + "/" + file).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+
+    // Creates a link on the hashtag with its own pool of one account. Links created by the
+    // same test share the pool, and with it the client and the spool. The fixture owns the
+    // link, so that destroyLinks can close its spool.
+    Link *createLink(int maxTries = 5) {
+        if (!clients) {
+            clients = std::make_unique<MastodonClientPool>(
+                std::vector<MastodonAccount>{{"https://mastodon.test", "token"}}, nullptr, config,
+                [this](const MastodonAccount &account, std::shared_ptr<TimelineState> timelineState,
+                       std::shared_ptr<Metrics> metrics) {
+                    auto mock = std::make_unique<MockMastodonClient>(account, config, std::move(timelineState),
+                                                                     std::move(metrics));
+                    client = mock.get();
+                    return mock;
+                });
+            workers = std::make_unique<WorkerPool>(2);
+        }
+        LinkAddress address;
+        address.hashtag = hashtag.substr(1);
+        address.maxTries = maxTries;
+        auto link = std::make_shared<Link>(linkId, address, LinkProperties(), &sdk, clients.get(),
+                                           workers.get());
+        link->start();
+        links.push_back(link);
+        return link.get();
+    }
+
+    // Posts an action on the link's strand, as a doAction does
+    void post(Link *link, RaceHandle handle, uint64_t actionId) {
+        std::shared_ptr<Link> self = link->shared_from_this();
+        workers->post(linkId, [self, handle, actionId] { self->post({handle}, actionId); });
+    }
+
+    // Waits for what is queued on the link's strand, retries not yet due excepted
+    void drain() {
+        std::promise<void> done;
+        workers->post(linkId, [&done] { done.set_value(); });
+        ASSERT_EQ(done.get_future().wait_for(5s), std::future_status::ready);
+    }
+
+    // Waits for a handle to reach a final status, then returns every status it was given
+    std::vector<PackageStatus> waitForStatus(RaceHandle handle) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait_for(lock, 5s, [&] { return statuses.count(handle) != 0; });
+        }
+        drain();
+        std::lock_guard<std::mutex> lock(mutex);
+        return statuses[handle];
+    }
+
+    // Shuts the links down and waits for them to be destroyed, which closes the spool
+    void destroyLinks() {
+        for (auto &link : links) {
+            link->shutdown();
+        }
+        drain();
+        links.clear();
+    }
+
+    std::vector<std::string> spoolFiles() const {
+        std::vector<std::string> files;
+        DIR *listing = opendir(dir.c_str());
+        if (listing == nullptr) {
+            return files;
+        }
+        while (struct dirent *entry = readdir(listing)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") {
+                files.push_back(name);
+            }
+        }
+        closedir(listing);
+        return files;
+    }
+
+    const LinkID linkId = "link";
+    std::string dir;
+    MastodonConfig config;
+    NiceMock<MockTransportSdk> sdk;
+    std::unique_ptr<MastodonClientPool> clients;
+    MockMastodonClient *client = nullptr;
+    std::vector<std::shared_ptr<Link>> links;
+    std::unique_ptr<WorkerPool> workers;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<RaceHandle, std::vector<PackageStatus>> statuses;
+};
+
+}  // namespace
+
+TEST_F(LinkTest, sent_post_is_dequeued_and_unspooled) {
+    Link *link = createLink();
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillOnce(Return(sent("1")));
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_SENT}));
+
+    // Posting the action again finds nothing to post
+    post(link, 11, 1);
+    EXPECT_EQ(waitForStatus(11), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+
+    destroyLinks();
+    EXPECT_TRUE(spoolFiles().empty());
+}
+
+TEST_F(LinkTest, transient_failures_are_retried_until_sent) {
+    Link *link = createLink();
+    EXPECT_CALL(*client, postStatus(_, hashtag))
+        .WillOnce(Return(transientFailure()))
+        .WillOnce(Return(transientFailure()))
+        .WillOnce(Return(sent("1")));
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    // The failed attempts are not reported
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_SENT}));
+}
+
+TEST_F(LinkTest, retries_stop_at_max_tries_and_keep_the_content) {
+    Link *link = createLink(3);
+    EXPECT_CALL(*client, postStatus(_, hashtag)).Times(3).WillRepeatedly(Return(transientFailure()));
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+
+    // The content stays queued and spooled until the SDK dequeues it
+    destroyLinks();
+    EXPECT_EQ(spoolFiles().size(), 1u);
+}
+
+TEST_F(LinkTest, retries_stop_once_the_elapsed_time_runs_out) {
+    config.retryInitialDelayMs = 20;
+    config.retryMaxDelayMs = 20;
+    config.retryMaxElapsedMs = 100;
+    Link *link = createLink(1000);
+    std::atomic<int> attempts{0};
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillRepeatedly([&](std::string_view, const std::string &) {
+        ++attempts;
+        return transientFailure();
+    });
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    auto start = std::chrono::steady_clock::now();
+    post(link, 10, 1);
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 100ms);
+    // Each retry waits 10 to 20 ms
+    EXPECT_GE(attempts, 2);
+    EXPECT_LE(attempts, 12);
+}
+
+TEST_F(LinkTest, permanent_failure_is_not_retried) {
+    Link *link = createLink();
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillOnce(Return(permanentFailure()));
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+
+    // Dequeuing the failed action unspools it
+    EXPECT_EQ(link->dequeueContent(1), COMPONENT_OK);
+    destroyLinks();
+    EXPECT_TRUE(spoolFiles().empty());
+}
+
+TEST_F(LinkTest, dequeue_while_posting_drops_the_retry) {
+    Link *link = createLink();
+    std::promise<void> posting;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillOnce([&](std::string_view, const std::string &) {
+        posting.set_value();
+        released.wait();
+        return transientFailure();
+    });
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    ASSERT_EQ(posting.get_future().wait_for(5s), std::future_status::ready);
+
+    // A second post of the action in flight fails at once rather than posting it twice
+    link->post({11}, 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(statuses[11], (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+    }
+
+    EXPECT_EQ(link->dequeueContent(1), COMPONENT_OK);
+    release.set_value();
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+
+    destroyLinks();
+    EXPECT_TRUE(spoolFiles().empty());
+}
+
+TEST_F(LinkTest, shutdown_fails_a_pending_retry) {
+    config.retryInitialDelayMs = 200;
+    config.retryMaxDelayMs = 200;
+    Link *link = createLink();
+    std::promise<void> failed;
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillOnce([&](std::string_view, const std::string &) {
+        failed.set_value();
+        return transientFailure();
+    });
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    ASSERT_EQ(failed.get_future().wait_for(5s), std::future_status::ready);
+    link->shutdown();
+    // The retry runs once due, and fails without posting
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+}
+
+TEST_F(LinkTest, shutdown_fails_text_held_for_the_batch_window) {
+    config.postBatchWindowMs = 60000;
+    Link *link = createLink();
+    EXPECT_CALL(*client, postStatus(_, _)).Times(0);
+
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    post(link, 10, 1);
+    drain();
+    link->shutdown();
+    EXPECT_EQ(waitForStatus(10), (std::vector<PackageStatus>{PACKAGE_FAILED_GENERIC}));
+}
+
+TEST_F(LinkTest, replayed_post_is_unspooled_when_it_fails_for_good) {
+    Link *link = createLink();
+    ASSERT_EQ(link->enqueueContent(1, bytes("package"), "text/plain"), COMPONENT_OK);
+    // The process stops before the action is posted
+    destroyLinks();
+    ASSERT_EQ(spoolFiles().size(), 1u);
+
+    // No SDK action will dequeue what is replayed, so it is dropped after failing
+    EXPECT_CALL(*client, postStatus(_, hashtag)).WillOnce(Return(permanentFailure()));
+    createLink();
+    drain();
+    destroyLinks();
+    EXPECT_TRUE(spoolFiles().empty());
+}
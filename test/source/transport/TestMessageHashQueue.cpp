@@ -0,0 +1,72 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+
+#include "MessageHashQueue.h"
+#include "gtest/gtest.h"
+
+TEST(MessageHashQueue, hash_is_xxh64) {
+    EXPECT_EQ(MessageHashQueue::hash("abc"), 0x44BC2CF5AD770999ull);
+}
+
+TEST(MessageHashQueue, contains_added_messages) {
+    MessageHashQueue queue(16);
+    EXPECT_EQ(queue.addMessage("first"), MessageHashQueue::hash("first"));
+    EXPECT_TRUE(queue.containsMessage("first"));
+    EXPECT_FALSE(queue.containsMessage("second"));
+}
+
+TEST(MessageHashQueue, records_a_repeated_message_once) {
+    MessageHashQueue queue(16);
+    queue.addMessage("same");
+    queue.addMessage("same");
+    EXPECT_EQ(queue.size(), 1u);
+}
+
+TEST(MessageHashQueue, evicts_oldest_message_when_full) {
+    MessageHashQueue queue(16);
+    for (int i = 0; i < 17; ++i) {
+        queue.addMessage("message " + std::to_string(i));
+    }
+    EXPECT_EQ(queue.size(), queue.capacity());
+    EXPECT_FALSE(queue.containsMessage("message 0"));
+    EXPECT_TRUE(queue.containsMessage("message 16"));
+}
+
+TEST(MessageHashQueue, find_and_remove_drops_older_messages) {
+    MessageHashQueue queue(16);
+    queue.addMessage("a");
+    queue.addMessage("b");
+    queue.addMessage("c");
+    EXPECT_TRUE(queue.findAndRemoveMessage("b"));
+    EXPECT_FALSE(queue.containsMessage("a"));
+    EXPECT_FALSE(queue.containsMessage("b"));
+    EXPECT_TRUE(queue.containsMessage("c"));
+    EXPECT_FALSE(queue.findAndRemoveMessage("b"));
+}
+
+TEST(MessageHashQueue, remove_hash_drops_only_that_message) {
+    MessageHashQueue queue(16);
+    queue.addMessage("a");
+    uint64_t hash = queue.addMessage("b");
+    queue.addMessage("c");
+    queue.removeHash(hash);
+    EXPECT_TRUE(queue.containsMessage("a"));
+    EXPECT_FALSE(queue.containsMessage("b"));
+    EXPECT_TRUE(queue.containsMessage("c"));
+}
@@ -0,0 +1,109 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "PackageFraming.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::vector<std::string> unframed(std::string_view text) {
+    std::vector<std::string_view> packages;
+    EXPECT_TRUE(framing::unframe(text, packages)) << text;
+    return std::vector<std::string>(packages.begin(), packages.end());
+}
+
+bool rejects(std::string_view text) {
+    std::vector<std::string_view> packages = {"stale"};
+    bool framed = framing::unframe(text, packages);
+    return !framed && packages.empty();
+}
+
+}  // namespace
+
+TEST(PackageFraming, frames_packages_with_their_lengths) {
+    EXPECT_EQ(framing::frame({"hello", "abc"}), "~5:hello3:abc");
+    EXPECT_EQ(framing::frame({}), "~");
+}
+
+TEST(PackageFraming, round_trips_packages) {
+    std::vector<std::vector<std::string>> cases = {
+        {"a"},
+        {"hello", "abc"},
+        {""},
+        {"", "x", ""},
+        {std::string(1234, 'Q'), "+/=", std::string(9, '7')},
+        {"~5:ab", "12:", "::"},
+    };
+    for (auto &packages : cases) {
+        std::vector<std::string_view> views(packages.begin(), packages.end());
+        EXPECT_EQ(unframed(framing::frame(views)), packages);
+    }
+}
+
+TEST(PackageFraming, frame_size_matches_framed_text) {
+    std::vector<std::string> packages = {"", "a", std::string(9, 'b'), std::string(10, 'c'),
+                                         std::string(100, 'd'), std::string(12345, 'e')};
+    std::size_t expected = framing::emptySize;
+    std::vector<std::string_view> views;
+    for (auto &package : packages) {
+        expected += framing::frameSize(package.size());
+        views.push_back(package);
+        EXPECT_EQ(framing::frame(views).size(), expected);
+    }
+    EXPECT_EQ(framing::frame({}).size(), framing::emptySize);
+}
+
+TEST(PackageFraming, rejects_malformed_text) {
+    EXPECT_TRUE(rejects(""));
+    EXPECT_TRUE(rejects("~"));
+    EXPECT_TRUE(rejects("~5:ab"));
+    EXPECT_TRUE(rejects("~2:ab5:abc"));
+    EXPECT_TRUE(rejects("~5"));
+    EXPECT_TRUE(rejects("~5hello"));
+    EXPECT_TRUE(rejects("~:hello"));
+    EXPECT_TRUE(rejects("~x:hello"));
+    EXPECT_TRUE(rejects("~5:hello~3:abc"));
+    EXPECT_TRUE(rejects("5:hello"));
+    EXPECT_TRUE(rejects("aGVsbG8="));
+}
+
+TEST(PackageFraming, rejects_lengths_longer_than_ten_digits) {
+    EXPECT_TRUE(rejects("~12345678901:a"));
+    EXPECT_TRUE(rejects("~99999999999999999999:a"));
+    // Ten digits parse, but the text is far shorter than the length
+    EXPECT_TRUE(rejects("~9999999999:a"));
+    EXPECT_EQ(unframed("~0000000001:a"), std::vector<std::string>{"a"});
+}
+
+TEST(PackageFraming, single_package_is_posted_as_is) {
+    EXPECT_EQ(framing::single("aGVsbG8="), "aGVsbG8=");
+    EXPECT_EQ(framing::single(""), "");
+    EXPECT_TRUE(rejects(framing::single("aGVsbG8=")));
+}
+
+TEST(PackageFraming, single_package_starting_with_the_marker_is_escaped) {
+    // Each of these would otherwise be taken for a framed status or fail as one
+    for (std::string package : {"~", "~~", "~5:hello", "~5:hello3:abc", "~0:", "~x"}) {
+        std::string text = framing::single(package);
+        EXPECT_EQ(text.size(), package.size() + framing::escapeSize);
+        EXPECT_EQ(unframed(text), std::vector<std::string>{package}) << package;
+    }
+}
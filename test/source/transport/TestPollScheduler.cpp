@@ -0,0 +1,166 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "PollScheduler.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+using Strings = std::vector<std::string>;
+
+TEST(PollScheduler, new_hashtags_are_due_at_once) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    EXPECT_EQ(scheduler.takeDue({"a", "b"}, now), (Strings{"a", "b"}));
+    EXPECT_TRUE(scheduler.takeDue({"a", "b"}, now).empty());
+}
+
+TEST(PollScheduler, hashtag_is_not_due_again_until_its_poll_is_recorded) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    ASSERT_EQ(scheduler.takeDue({"a"}, now).size(), 1u);
+    EXPECT_TRUE(scheduler.takeDue({"a"}, now + 59s).empty());
+    EXPECT_EQ(scheduler.takeDue({"a"}, now + 60s), Strings{"a"});
+}
+
+TEST(PollScheduler, unrecorded_hashtags_are_returned_after_the_minimum_interval) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    ASSERT_EQ(scheduler.takeDue({"a", "b"}, now).size(), 2u);
+    scheduler.recordPoll("a", 0, now);
+
+    // Only the poll that was never recorded comes back
+    scheduler.returnUnrecorded(now);
+    EXPECT_EQ(scheduler.untilNextPoll(now), 1s);
+    EXPECT_TRUE(scheduler.takeDue({"a", "b"}, now + 1s - 1ms).empty());
+    EXPECT_EQ(scheduler.takeDue({"a", "b"}, now + 1s), Strings{"b"});
+
+    // Returning again once it has been recorded leaves it alone
+    scheduler.recordPoll("b", 0, now + 1s);
+    scheduler.returnUnrecorded(now + 1s);
+    EXPECT_TRUE(scheduler.takeDue({"b"}, now + 2s).empty());
+}
+
+TEST(PollScheduler, quiet_hashtag_backs_off_to_the_maximum) {
+    PollScheduler scheduler(1s, 8s, 0);
+    auto now = PollScheduler::Clock::now();
+    ASSERT_EQ(scheduler.takeDue({"a"}, now).size(), 1u);
+
+    for (auto interval : {2s, 4s, 8s, 8s, 8s}) {
+        scheduler.recordPoll("a", 0, now);
+        EXPECT_TRUE(scheduler.takeDue({"a"}, now + interval - 1ms).empty()) << interval.count();
+        now += interval;
+        EXPECT_EQ(scheduler.takeDue({"a"}, now), Strings{"a"}) << interval.count();
+    }
+
+    // New statuses bring it back to the minimum
+    scheduler.recordPoll("a", 3, now);
+    EXPECT_EQ(scheduler.takeDue({"a"}, now + 1s), Strings{"a"});
+}
+
+TEST(PollScheduler, busy_hashtag_backs_off_no_further_than_its_arrivals) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    ASSERT_EQ(scheduler.takeDue({"a"}, now).size(), 1u);
+
+    // 30 arrivals in one poll is a rate of one a second
+    scheduler.recordPoll("a", 30, now);
+    EXPECT_NEAR(scheduler.getArrivalRate("a"), 1.0, 1e-9);
+    for (int poll = 0; poll < 3; ++poll) {
+        now += 1s;
+        ASSERT_EQ(scheduler.takeDue({"a"}, now + 200ms), Strings{"a"}) << poll;
+        scheduler.recordPoll("a", 0, now);
+    }
+    EXPECT_LT(scheduler.getArrivalRate("a"), 1.0);
+    EXPECT_GT(scheduler.getArrivalRate("a"), 0.8);
+}
+
+TEST(PollScheduler, budget_limits_polls) {
+    // 60 polls a minute with a ten second burst
+    PollScheduler scheduler(1s, 60s, 60);
+    auto now = PollScheduler::Clock::now();
+    Strings hashtags;
+    for (int i = 0; i < 15; ++i) {
+        hashtags.push_back("tag" + std::to_string(i));
+    }
+
+    EXPECT_EQ(scheduler.takeDue(hashtags, now).size(), 10u);
+    EXPECT_TRUE(scheduler.takeDue(hashtags, now).empty());
+    EXPECT_GE(scheduler.untilNextPoll(now), 1000ms);
+    EXPECT_EQ(scheduler.takeDue(hashtags, now + 1001ms).size(), 1u);
+    EXPECT_EQ(scheduler.takeDue(hashtags, now + 5002ms).size(), 4u);
+}
+
+TEST(PollScheduler, busiest_hashtags_go_first_within_the_budget) {
+    PollScheduler scheduler(1s, 60s, 60);
+    auto now = PollScheduler::Clock::now();
+    Strings hashtags = {"quiet", "busy", "medium"};
+    ASSERT_EQ(scheduler.takeDue(hashtags, now).size(), 3u);
+    scheduler.recordPoll("quiet", 1, now);
+    scheduler.recordPoll("busy", 20, now);
+    scheduler.recordPoll("medium", 5, now);
+
+    // Spend the rest of the burst on hashtags that then stay in flight
+    for (int i = 0; i < 7; ++i) {
+        hashtags.push_back("filler" + std::to_string(i));
+    }
+    ASSERT_EQ(scheduler.takeDue(hashtags, now).size(), 7u);
+
+    EXPECT_EQ(scheduler.takeDue(hashtags, now + 1001ms), Strings{"busy"});
+    EXPECT_EQ(scheduler.takeDue(hashtags, now + 3002ms), (Strings{"medium", "quiet"}));
+}
+
+TEST(PollScheduler, order_is_by_arrival_rate_without_a_budget) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    Strings hashtags = {"quiet", "busy", "medium"};
+    ASSERT_EQ(scheduler.takeDue(hashtags, now).size(), 3u);
+    scheduler.recordPoll("quiet", 1, now);
+    scheduler.recordPoll("busy", 20, now);
+    scheduler.recordPoll("medium", 5, now);
+    EXPECT_EQ(scheduler.takeDue(hashtags, now + 1s), (Strings{"busy", "medium", "quiet"}));
+}
+
+TEST(PollScheduler, until_next_poll_waits_for_the_next_due_hashtag) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    EXPECT_EQ(scheduler.untilNextPoll(now), 1000ms);
+
+    ASSERT_EQ(scheduler.takeDue({"a"}, now).size(), 1u);
+    scheduler.recordPoll("a", 2, now);
+    EXPECT_EQ(scheduler.untilNextPoll(now + 400ms), 600ms);
+    EXPECT_EQ(scheduler.untilNextPoll(now + 2s), 0ms);
+}
+
+TEST(PollScheduler, forgets_hashtags_no_longer_passed_in) {
+    PollScheduler scheduler(1s, 60s, 0);
+    auto now = PollScheduler::Clock::now();
+    ASSERT_EQ(scheduler.takeDue({"a"}, now).size(), 1u);
+    scheduler.recordPoll("a", 10, now);
+    EXPECT_GT(scheduler.getArrivalRate("a"), 0);
+
+    EXPECT_TRUE(scheduler.takeDue({}, now).empty());
+    EXPECT_EQ(scheduler.getArrivalRate("a"), 0);
+
+    // Polls recorded after it was forgotten are ignored, and it is new when it comes back
+    scheduler.recordPoll("a", 10, now);
+    EXPECT_EQ(scheduler.getArrivalRate("a"), 0);
+    EXPECT_EQ(scheduler.takeDue({"a"}, now), Strings{"a"});
+}
@@ -0,0 +1,166 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <chrono>
+#include <ctime>
+#include <future>
+#include <map>
+#include <string>
+
+#include "RateLimiter.h"
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+using Headers = std::map<std::string, std::string>;
+
+namespace {
+
+// X-RateLimit-Reset for the given time from now, truncated to whole seconds like Mastodon's
+std::string resetIn(std::chrono::seconds fromNow) {
+    std::time_t reset = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() + fromNow);
+    std::tm tm{};
+    gmtime_r(&reset, &tm);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+    return text;
+}
+
+Headers limits(int limit, int remaining, std::chrono::seconds resetFromNow) {
+    return {{"x-ratelimit-limit", std::to_string(limit)},
+            {"x-ratelimit-remaining", std::to_string(remaining)},
+            {"x-ratelimit-reset", resetIn(resetFromNow)}};
+}
+
+// How long acquire blocks
+std::chrono::milliseconds timeAcquire(RateLimiter &limiter, RateLimiter::Endpoint endpoint) {
+    auto start = std::chrono::steady_clock::now();
+    limiter.acquire(endpoint);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
+}  // namespace
+
+TEST(RateLimiter, unknown_limits_do_not_limit) {
+    RateLimiter limiter;
+    for (int i = 0; i < 1000; ++i) {
+        limiter.acquire(RateLimiter::STATUSES);
+    }
+    EXPECT_FALSE(limiter.getBudget(RateLimiter::STATUSES).known);
+}
+
+TEST(RateLimiter, update_sets_the_budget_and_acquire_spends_it) {
+    RateLimiter limiter;
+    limiter.update(RateLimiter::MEDIA, limits(30, 20, 300s), 200);
+
+    auto budget = limiter.getBudget(RateLimiter::MEDIA);
+    EXPECT_TRUE(budget.known);
+    EXPECT_EQ(budget.limit, 30);
+    EXPECT_EQ(budget.remaining, 20);
+    EXPECT_GT(budget.untilReset, 299s);
+    EXPECT_LE(budget.untilReset, 302s);
+
+    EXPECT_LT(timeAcquire(limiter, RateLimiter::MEDIA), 100ms);
+    EXPECT_LT(timeAcquire(limiter, RateLimiter::MEDIA), 100ms);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::MEDIA).remaining, 18);
+
+    // Endpoint classes have their own buckets
+    EXPECT_FALSE(limiter.getBudget(RateLimiter::STATUSES).known);
+}
+
+TEST(RateLimiter, invalid_headers_are_ignored) {
+    RateLimiter limiter;
+    limiter.update(RateLimiter::STATUSES,
+                   {{"x-ratelimit-limit", "many"}, {"x-ratelimit-reset", "tomorrow"}}, 200);
+    EXPECT_FALSE(limiter.getBudget(RateLimiter::STATUSES).known);
+}
+
+TEST(RateLimiter, too_many_requests_empties_the_bucket) {
+    RateLimiter limiter;
+    limiter.update(RateLimiter::STATUSES, limits(300, 250, 300s), 200);
+    limiter.update(RateLimiter::STATUSES, {}, 429);
+
+    auto budget = limiter.getBudget(RateLimiter::STATUSES);
+    EXPECT_EQ(budget.remaining, 0);
+    EXPECT_GT(budget.untilReset, 0ms);
+}
+
+TEST(RateLimiter, too_many_requests_without_a_limit_recovers_at_the_reset) {
+    RateLimiter limiter;
+    limiter.update(RateLimiter::STATUSES, {{"x-ratelimit-reset", resetIn(1s)}}, 429);
+    EXPECT_TRUE(limiter.getBudget(RateLimiter::STATUSES).known);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::STATUSES).limit, 0);
+
+    // One request probes the new window
+    auto waited = timeAcquire(limiter, RateLimiter::STATUSES);
+    EXPECT_GE(waited, 900ms);
+    EXPECT_LT(waited, 3s);
+
+    // Its response sets the limit, until then the rest wait
+    auto next = std::async(std::launch::async, [&] { return timeAcquire(limiter, RateLimiter::STATUSES); });
+    EXPECT_EQ(next.wait_for(200ms), std::future_status::timeout);
+    limiter.update(RateLimiter::STATUSES, limits(300, 299, 300s), 200);
+    ASSERT_EQ(next.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::STATUSES).remaining, 298);
+}
+
+TEST(RateLimiter, acquire_waits_for_the_reset_when_empty) {
+    RateLimiter limiter;
+    // The reset is one second away, give or take its truncation
+    limiter.update(RateLimiter::STATUSES, limits(300, 0, 1s), 429);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::STATUSES).remaining, 0);
+
+    auto waited = timeAcquire(limiter, RateLimiter::STATUSES);
+    EXPECT_GE(waited, 900ms);
+    EXPECT_LT(waited, 3s);
+
+    // The new window is assumed to have the full limit
+    EXPECT_EQ(limiter.getBudget(RateLimiter::STATUSES).remaining, 299);
+}
+
+TEST(RateLimiter, update_wakes_waiting_requests) {
+    RateLimiter limiter;
+    // Without a reset time an empty bucket waits up to a minute
+    limiter.update(RateLimiter::TIMELINES, {{"x-ratelimit-limit", "300"}}, 429);
+
+    auto waited = std::async(std::launch::async, [&] { return timeAcquire(limiter, RateLimiter::TIMELINES); });
+    EXPECT_EQ(waited.wait_for(200ms), std::future_status::timeout);
+    limiter.update(RateLimiter::TIMELINES, limits(300, 200, 300s), 200);
+    ASSERT_EQ(waited.wait_for(5s), std::future_status::ready);
+    EXPECT_LT(waited.get(), 5s);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::TIMELINES).remaining, 199);
+}
+
+TEST(RateLimiter, low_bucket_spreads_requests_over_the_window) {
+    RateLimiter limiter;
+    // 10 of 100 left with two to three seconds to go: the next request waits a tenth of that
+    limiter.update(RateLimiter::MEDIA, limits(100, 10, 2s), 200);
+    EXPECT_LT(timeAcquire(limiter, RateLimiter::MEDIA), 100ms);
+    auto waited = timeAcquire(limiter, RateLimiter::MEDIA);
+    EXPECT_GE(waited, 150ms);
+    EXPECT_LT(waited, 1s);
+}
+
+TEST(RateLimiter, full_bucket_is_not_paced) {
+    RateLimiter limiter;
+    limiter.update(RateLimiter::MEDIA, limits(100, 90, 2s), 200);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 50; ++i) {
+        limiter.acquire(RateLimiter::MEDIA);
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 100ms);
+    EXPECT_EQ(limiter.getBudget(RateLimiter::MEDIA).remaining, 40);
+}
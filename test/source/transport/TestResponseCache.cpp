@@ -0,0 +1,185 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ResponseCache.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+bool cached(ValidatorCache &cache, const std::string &url) {
+    ValidatorCache::Validators validators;
+    return cache.get(url, validators);
+}
+
+bool cached(MediaCache &cache, const std::string &id, std::size_t size) {
+    std::vector<uint8_t> data;
+    if (!cache.take(id, data)) {
+        return false;
+    }
+    EXPECT_EQ(data.size(), size) << id;
+    cache.put(id, std::move(data));
+    return true;
+}
+
+}  // namespace
+
+TEST(ValidatorCache, returns_stored_validators) {
+    ValidatorCache cache(10);
+    cache.put("https://a/1", {"\"etag\"", ""});
+    cache.put("https://a/2", {"", "Wed, 21 Oct 2015 07:28:00 GMT"});
+
+    ValidatorCache::Validators validators;
+    ASSERT_TRUE(cache.get("https://a/1", validators));
+    EXPECT_EQ(validators.etag, "\"etag\"");
+    EXPECT_EQ(validators.lastModified, "");
+    ASSERT_TRUE(cache.get("https://a/2", validators));
+    EXPECT_EQ(validators.etag, "");
+    EXPECT_EQ(validators.lastModified, "Wed, 21 Oct 2015 07:28:00 GMT");
+    EXPECT_FALSE(cache.get("https://a/3", validators));
+}
+
+TEST(ValidatorCache, put_replaces_validators) {
+    ValidatorCache cache(10);
+    cache.put("url", {"old", "old"});
+    cache.put("url", {"new", ""});
+    ValidatorCache::Validators validators;
+    ASSERT_TRUE(cache.get("url", validators));
+    EXPECT_EQ(validators.etag, "new");
+    EXPECT_EQ(validators.lastModified, "");
+}
+
+TEST(ValidatorCache, evicts_least_recently_used) {
+    ValidatorCache cache(3);
+    cache.put("a", {"1", ""});
+    cache.put("b", {"2", ""});
+    cache.put("c", {"3", ""});
+
+    // Reading a and replacing b make c the least recently used
+    EXPECT_TRUE(cached(cache, "a"));
+    cache.put("b", {"2b", ""});
+    cache.put("d", {"4", ""});
+
+    EXPECT_FALSE(cached(cache, "c"));
+    EXPECT_TRUE(cached(cache, "a"));
+    EXPECT_TRUE(cached(cache, "b"));
+    EXPECT_TRUE(cached(cache, "d"));
+}
+
+TEST(ValidatorCache, ignores_empty_validators) {
+    ValidatorCache cache(10);
+    cache.put("url", {"", ""});
+    EXPECT_FALSE(cached(cache, "url"));
+
+    // An empty put does not forget what is already there either
+    cache.put("url", {"etag", ""});
+    cache.put("url", {"", ""});
+    EXPECT_TRUE(cached(cache, "url"));
+}
+
+TEST(ValidatorCache, zero_entries_stores_nothing) {
+    ValidatorCache cache(0);
+    cache.put("url", {"etag", "date"});
+    EXPECT_FALSE(cached(cache, "url"));
+}
+
+TEST(ValidatorCache, erase_forgets_url) {
+    ValidatorCache cache(2);
+    cache.put("a", {"1", ""});
+    cache.put("b", {"2", ""});
+    cache.erase("a");
+    cache.erase("missing");
+    EXPECT_FALSE(cached(cache, "a"));
+
+    // The erased entry no longer counts towards the limit
+    cache.put("c", {"3", ""});
+    EXPECT_TRUE(cached(cache, "b"));
+    EXPECT_TRUE(cached(cache, "c"));
+}
+
+TEST(MediaCache, take_moves_the_image_out) {
+    MediaCache cache(100);
+    std::vector<uint8_t> image(40, 7);
+    const uint8_t *buffer = image.data();
+    cache.put("1", std::move(image));
+
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(cache.take("1", data));
+    EXPECT_EQ(data, std::vector<uint8_t>(40, 7));
+    EXPECT_EQ(data.data(), buffer);
+    EXPECT_FALSE(cache.take("1", data));
+}
+
+TEST(MediaCache, evicts_least_recently_stored_beyond_byte_limit) {
+    MediaCache cache(100);
+    cache.put("a", std::vector<uint8_t>(40));
+    cache.put("b", std::vector<uint8_t>(40));
+    cache.put("c", std::vector<uint8_t>(40));
+
+    std::vector<uint8_t> data;
+    EXPECT_FALSE(cache.take("a", data));
+    EXPECT_TRUE(cached(cache, "b", 40));
+    EXPECT_TRUE(cached(cache, "c", 40));
+
+    // A large image can evict several
+    cache.put("d", std::vector<uint8_t>(90));
+    EXPECT_FALSE(cache.take("b", data));
+    EXPECT_FALSE(cache.take("c", data));
+    EXPECT_TRUE(cached(cache, "d", 90));
+}
+
+TEST(MediaCache, taken_images_free_their_bytes) {
+    MediaCache cache(100);
+    cache.put("a", std::vector<uint8_t>(60));
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(cache.take("a", data));
+    cache.put("b", std::vector<uint8_t>(60));
+    cache.put("c", std::vector<uint8_t>(40));
+    EXPECT_TRUE(cached(cache, "b", 60));
+    EXPECT_TRUE(cached(cache, "c", 40));
+}
+
+TEST(MediaCache, replaces_an_image_with_the_same_id) {
+    MediaCache cache(100);
+    cache.put("a", std::vector<uint8_t>(60));
+    cache.put("a", std::vector<uint8_t>(70));
+    cache.put("b", std::vector<uint8_t>(30));
+    EXPECT_TRUE(cached(cache, "a", 70));
+    EXPECT_TRUE(cached(cache, "b", 30));
+}
+
+TEST(MediaCache, rejects_oversize_images_and_empty_ids) {
+    MediaCache cache(100);
+    cache.put("kept", std::vector<uint8_t>(50));
+    cache.put("huge", std::vector<uint8_t>(101));
+    cache.put("", std::vector<uint8_t>(10));
+
+    std::vector<uint8_t> data;
+    EXPECT_FALSE(cache.take("huge", data));
+    EXPECT_FALSE(cache.take("", data));
+    EXPECT_TRUE(cached(cache, "kept", 50));
+}
+
+TEST(MediaCache, zero_bytes_holds_nothing) {
+    MediaCache cache(0);
+    cache.put("a", std::vector<uint8_t>(1));
+    std::vector<uint8_t> data;
+    EXPECT_FALSE(cache.take("a", data));
+}
@@ -0,0 +1,243 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Spool.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Every record is a 32 byte header followed by its data
+const uint64_t headerSize = 32;
+
+std::vector<uint8_t> bytes(const std::string &text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+class SpoolTest : public testing::Test {
+protected:
+    void SetUp() override {
+        char pattern[] = "/tmp/spooltestXXXXXX";
+        ASSERT_NE(mkdtemp(pattern), nullptr);
+        dir = pattern;
+        path = dir + "/links/link.spool";
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+        std::remove((path + ".compact").c_str());
+        rmdir((dir + "/links").c_str());
+        rmdir(dir.c_str());
+    }
+
+    bool exists() const {
+        struct stat info {};
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    uint64_t fileSize() const {
+        struct stat info {};
+        EXPECT_EQ(stat(path.c_str(), &info), 0);
+        return static_cast<uint64_t>(info.st_size);
+    }
+
+    void appendToFile(const std::string &data) const {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file << data;
+    }
+
+    std::string dir;
+    std::string path;
+};
+
+}  // namespace
+
+TEST_F(SpoolTest, replays_actions_after_reopening) {
+    Spool::Image stored;
+    std::vector<uint8_t> image = bytes("image data");
+    {
+        Spool spool(path);
+        EXPECT_TRUE(spool.takeReplay().empty());
+        uint64_t first = spool.newAction();
+        uint64_t second = spool.newAction();
+        ASSERT_TRUE(spool.appendText(first, bytes("first")));
+        ASSERT_TRUE(spool.appendImage(second, image, stored));
+        ASSERT_TRUE(spool.appendText(second, bytes("second")));
+        EXPECT_EQ(stored.size, image.size());
+    }
+
+    Spool spool(path);
+    auto replay = spool.takeReplay();
+    ASSERT_EQ(replay.size(), 2u);
+    EXPECT_TRUE(replay[0].hasText);
+    EXPECT_EQ(replay[0].text, bytes("first"));
+    EXPECT_TRUE(replay[0].images.empty());
+    EXPECT_EQ(replay[1].text, bytes("second"));
+    ASSERT_EQ(replay[1].images.size(), 1u);
+    auto read = spool.readImage(replay[1].images[0]);
+    ASSERT_NE(read, nullptr);
+    EXPECT_EQ(*read, image);
+    EXPECT_TRUE(spool.takeReplay().empty());
+
+    // New actions do not reuse the IDs found in the file
+    EXPECT_GT(spool.newAction(), replay[1].id);
+}
+
+TEST_F(SpoolTest, drops_a_torn_header) {
+    {
+        Spool spool(path);
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("kept")));
+    }
+    const uint64_t intact = fileSize();
+    appendToFile("MSPL\x01torn");
+
+    Spool spool(path);
+    auto replay = spool.takeReplay();
+    ASSERT_EQ(replay.size(), 1u);
+    EXPECT_EQ(replay[0].text, bytes("kept"));
+    EXPECT_EQ(fileSize(), intact);
+}
+
+TEST_F(SpoolTest, drops_a_record_with_torn_data) {
+    {
+        Spool spool(path);
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("kept")));
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("torn by a crash")));
+    }
+    const uint64_t intact = headerSize + 4;
+    ASSERT_EQ(truncate(path.c_str(), static_cast<off_t>(fileSize() - 3)), 0);
+
+    {
+        Spool spool(path);
+        auto replay = spool.takeReplay();
+        ASSERT_EQ(replay.size(), 1u);
+        EXPECT_EQ(replay[0].text, bytes("kept"));
+        EXPECT_EQ(fileSize(), intact);
+
+        // Records appended after recovery follow the intact ones
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("after")));
+    }
+
+    Spool spool(path);
+    auto replay = spool.takeReplay();
+    ASSERT_EQ(replay.size(), 2u);
+    EXPECT_EQ(replay[1].text, bytes("after"));
+}
+
+TEST_F(SpoolTest, drops_garbage_with_a_bad_checksum) {
+    {
+        Spool spool(path);
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("kept")));
+    }
+    const uint64_t intact = fileSize();
+    // A whole header's worth of bytes with the right magic but a wrong check
+    appendToFile(std::string("MSPL\x01\0\0\0", 8) + std::string(24, '\x7f'));
+
+    Spool spool(path);
+    ASSERT_EQ(spool.takeReplay().size(), 1u);
+    EXPECT_EQ(fileSize(), intact);
+}
+
+TEST_F(SpoolTest, compaction_keeps_only_live_actions) {
+    std::vector<uint8_t> image(1000, 0x5a);
+    uint64_t removed = 0;
+    {
+        Spool spool(path);
+        removed = spool.newAction();
+        uint64_t kept = spool.newAction();
+        Spool::Image stored;
+        ASSERT_TRUE(spool.appendText(removed, bytes("posted")));
+        ASSERT_TRUE(spool.appendImage(removed, std::vector<uint8_t>(5000, 1), stored));
+        ASSERT_TRUE(spool.appendImage(kept, image, stored));
+        ASSERT_TRUE(spool.appendText(kept, bytes("waiting")));
+        spool.remove(removed);
+    }
+
+    Spool spool(path);
+    auto replay = spool.takeReplay();
+    ASSERT_EQ(replay.size(), 1u);
+    EXPECT_NE(replay[0].id, removed);
+    EXPECT_EQ(replay[0].text, bytes("waiting"));
+    EXPECT_EQ(fileSize(), headerSize + 7 + headerSize + image.size());
+
+    // Images are found at their new offsets
+    ASSERT_EQ(replay[0].images.size(), 1u);
+    auto read = spool.readImage(replay[0].images[0]);
+    ASSERT_NE(read, nullptr);
+    EXPECT_EQ(*read, image);
+}
+
+TEST_F(SpoolTest, truncates_when_the_last_action_is_removed) {
+    Spool spool(path);
+    uint64_t first = spool.newAction();
+    uint64_t second = spool.newAction();
+    ASSERT_TRUE(spool.appendText(first, bytes("one")));
+    ASSERT_TRUE(spool.appendText(second, bytes("two")));
+
+    spool.remove(first);
+    EXPECT_EQ(fileSize(), 2 * headerSize + 6 + headerSize);
+    spool.remove(first);
+    EXPECT_EQ(fileSize(), 2 * headerSize + 6 + headerSize);
+    spool.remove(second);
+    EXPECT_EQ(fileSize(), 0u);
+
+    ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("three")));
+    EXPECT_EQ(fileSize(), headerSize + 5);
+}
+
+TEST_F(SpoolTest, deletes_the_file_when_closed_empty) {
+    {
+        Spool spool(path);
+        uint64_t action = spool.newAction();
+        ASSERT_TRUE(spool.appendText(action, bytes("done")));
+        spool.remove(action);
+    }
+    EXPECT_FALSE(exists());
+
+    {
+        Spool spool(path);
+        ASSERT_TRUE(spool.appendText(spool.newAction(), bytes("pending")));
+    }
+    EXPECT_TRUE(exists());
+}
+
+TEST_F(SpoolTest, open_shares_a_spool_per_path) {
+    auto first = Spool::open(path);
+    auto second = Spool::open(path);
+    EXPECT_EQ(first, second);
+    EXPECT_NE(Spool::open(dir + "/links/other.spool"), first);
+
+    std::weak_ptr<Spool> closed = first;
+    first.reset();
+    second.reset();
+    EXPECT_TRUE(closed.expired());
+    auto reopened = Spool::open(path);
+    EXPECT_NE(reopened, nullptr);
+}
+
+TEST_F(SpoolTest, throws_when_the_file_cannot_be_opened) {
+    EXPECT_THROW(Spool(dir + "/missing/level/link.spool"), std::runtime_error);
+}
@@ -0,0 +1,125 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+#include <vector>
+
+#include "StatusJson.h"
+#include "gtest/gtest.h"
+
+TEST(StatusJson, reads_the_fields_of_each_status) {
+    std::vector<StatusFields> statuses;
+    ASSERT_TRUE(parseTimelineJson(R"([
+        {"id": "2", "content": "<p>second</p>", "media_attachments": []},
+        {"id": "1", "content": "<p>first</p>", "sensitive": false, "replies_count": 3}
+    ])", statuses));
+    ASSERT_EQ(statuses.size(), 2u);
+    EXPECT_EQ(statuses[0].id, "2");
+    EXPECT_TRUE(statuses[0].hasContent);
+    EXPECT_EQ(statuses[0].content, "<p>second</p>");
+    EXPECT_TRUE(statuses[0].images.empty());
+    EXPECT_EQ(statuses[1].id, "1");
+    EXPECT_EQ(statuses[1].content, "<p>first</p>");
+}
+
+TEST(StatusJson, unescapes_string_fields) {
+    std::vector<StatusFields> statuses;
+    ASSERT_TRUE(parseTimelineJson(
+        R"([{"id": "1", "content": "<p>\"quoted\" a\\b é\n😀 \/</p>"}])", statuses));
+    ASSERT_EQ(statuses.size(), 1u);
+    EXPECT_EQ(statuses[0].content, "<p>\"quoted\" a\\b \xc3\xa9\n\xf0\x9f\x98\x80 /</p>");
+}
+
+TEST(StatusJson, missing_or_null_content_is_not_content) {
+    std::vector<StatusFields> statuses;
+    ASSERT_TRUE(parseTimelineJson(R"([
+        {"id": "1"},
+        {"id": "2", "content": null},
+        {"id": "3", "content": ""}
+    ])", statuses));
+    ASSERT_EQ(statuses.size(), 3u);
+    EXPECT_FALSE(statuses[0].hasContent);
+    EXPECT_FALSE(statuses[1].hasContent);
+    EXPECT_TRUE(statuses[2].hasContent);
+    EXPECT_EQ(statuses[2].content, "");
+}
+
+TEST(StatusJson, keeps_image_attachments_with_a_url) {
+    std::vector<StatusFields> statuses;
+    ASSERT_TRUE(parseTimelineJson(R"([{
+        "id": "1",
+        "media_attachments": [
+            {"id": "10", "type": "image", "url": "https://a/10.jpg",
+             "meta": {"original": {"width": 64, "url": "https://a/ignored"}}},
+            {"id": "11", "type": "video", "url": "https://a/11.mp4"},
+            {"id": "12", "type": "image", "url": null},
+            {"id": "13", "type": 5, "url": "https://a/13.jpg"},
+            {"type": "image", "url": "https://a/anonymous.jpg"}
+        ]
+    }])", statuses));
+    ASSERT_EQ(statuses.size(), 1u);
+    auto &images = statuses[0].images;
+    ASSERT_EQ(images.size(), 2u);
+    EXPECT_EQ(images[0].id, "10");
+    EXPECT_EQ(images[0].url, "https://a/10.jpg");
+    EXPECT_EQ(images[1].id, "");
+    EXPECT_EQ(images[1].url, "https://a/anonymous.jpg");
+}
+
+TEST(StatusJson, ignores_fields_of_nested_objects) {
+    std::vector<StatusFields> statuses;
+    ASSERT_TRUE(parseTimelineJson(R"([{
+        "account": {"id": "99", "url": "https://a/@x", "fields": [{"name": "id", "value": "x"}]},
+        "reblog": {"id": "98", "content": "<p>reblogged</p>",
+                   "media_attachments": [{"id": "97", "type": "image", "url": "https://a/97.jpg"}]},
+        "card": {"url": "https://a/card"},
+        "tags": [{"name": "tag", "url": "https://a/tags/tag"}],
+        "id": "1",
+        "content": "<p>own</p>"
+    }])", statuses));
+    ASSERT_EQ(statuses.size(), 1u);
+    EXPECT_EQ(statuses[0].id, "1");
+    EXPECT_EQ(statuses[0].content, "<p>own</p>");
+    EXPECT_TRUE(statuses[0].images.empty());
+}
+
+TEST(StatusJson, rejects_malformed_json) {
+    std::vector<StatusFields> statuses;
+    EXPECT_FALSE(parseTimelineJson(R"([{"id": "1", "content": "<p>cut)", statuses));
+    EXPECT_FALSE(parseTimelineJson("", statuses));
+    EXPECT_FALSE(parseTimelineJson(R"([{"id": "1",}])", statuses));
+}
+
+TEST(StatusJson, error_object_has_no_statuses) {
+    std::vector<StatusFields> statuses = {StatusFields()};
+    ASSERT_TRUE(parseTimelineJson(R"({"error": "Record not found"})", statuses));
+    EXPECT_TRUE(statuses.empty());
+}
+
+TEST(StatusJson, parses_a_single_status) {
+    StatusFields status;
+    ASSERT_TRUE(parseStatusJson(R"({"id": "5", "content": "<p>streamed</p>",
+        "media_attachments": [{"id": "50", "type": "image", "url": "https://a/50.jpg"}]})", status));
+    EXPECT_EQ(status.id, "5");
+    EXPECT_EQ(status.content, "<p>streamed</p>");
+    ASSERT_EQ(status.images.size(), 1u);
+    EXPECT_EQ(status.images[0].url, "https://a/50.jpg");
+
+    EXPECT_FALSE(parseStatusJson(R"([{"id": "5"}])", status));
+    EXPECT_FALSE(parseStatusJson("\"5\"", status));
+    EXPECT_FALSE(parseStatusJson("{", status));
+}
@@ -0,0 +1,109 @@
+//
+// Copyright 2023 Two Six Technologies
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <string>
+
+#include "TimelineState.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+const std::size_t seenIndexBytes = 1 << 16;
+
+}  // namespace
+
+TEST(TimelineState, own_posts_are_recognized_by_id) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+    state.beginOwnPost("#tag", "text", 0);
+    state.endOwnPost("#tag", "text", 0, "101");
+
+    EXPECT_TRUE(state.isOwnPost("#tag", "101"));
+    EXPECT_FALSE(state.isOwnPost("#tag", "102"));
+    EXPECT_FALSE(state.isOwnPost("#other", "101"));
+    // Once answered, a peer posting the same text is no longer mistaken for us
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "text", 0));
+}
+
+TEST(TimelineState, post_is_in_flight_until_the_server_answers) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+
+    // The stream can deliver the status between these two calls, before its ID is known
+    state.beginOwnPost("#tag", "text", 0);
+    EXPECT_TRUE(state.isOwnPostInFlight("#tag", "text", 0));
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "other text", 0));
+    EXPECT_FALSE(state.isOwnPostInFlight("#other", "text", 0));
+    EXPECT_FALSE(state.isOwnPost("#tag", "101"));
+
+    state.endOwnPost("#tag", "text", 0, "101");
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "text", 0));
+    EXPECT_TRUE(state.isOwnPost("#tag", "101"));
+}
+
+TEST(TimelineState, posts_of_the_same_text_are_each_in_flight) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+    state.beginOwnPost("#tag", "text", 0);
+    state.beginOwnPost("#tag", "text", 0);
+
+    state.endOwnPost("#tag", "text", 0, "101");
+    EXPECT_TRUE(state.isOwnPostInFlight("#tag", "text", 0));
+    // A failed post has no ID to record
+    state.endOwnPost("#tag", "text", 0, "");
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "text", 0));
+    EXPECT_TRUE(state.isOwnPost("#tag", "101"));
+}
+
+TEST(TimelineState, own_posts_are_kept_while_a_link_retains_them) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+    state.retainOwnPosts("#tag");
+    state.beginOwnPost("#tag", "text", 0);
+    state.endOwnPost("#tag", "text", 0, "101");
+
+    state.releaseOwnPosts("#tag");
+    EXPECT_TRUE(state.isOwnPost("#tag", "101"));
+    state.releaseOwnPosts("#tag");
+    EXPECT_FALSE(state.isOwnPost("#tag", "101"));
+}
+
+TEST(TimelineState, post_ending_after_the_last_release_is_not_recorded) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+    state.beginOwnPost("#tag", "text", 0);
+    state.releaseOwnPosts("#tag");
+
+    // The link was destroyed while its post was in flight
+    state.endOwnPost("#tag", "text", 0, "101");
+    EXPECT_FALSE(state.isOwnPost("#tag", "101"));
+    state.beginOwnPost("#tag", "text", 0);
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "text", 0));
+}
+
+TEST(TimelineState, image_only_posts_match_statuses_with_as_many_images) {
+    TimelineState state(nullptr, seenIndexBytes);
+    state.retainOwnPosts("#tag");
+    state.beginOwnPost("#tag", "", 2);
+
+    EXPECT_TRUE(state.isOwnPostInFlight("#tag", "", 2));
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "", 1));
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "", 0));
+
+    state.endOwnPost("#tag", "", 2, "101");
+    EXPECT_FALSE(state.isOwnPostInFlight("#tag", "", 2));
+}